@@ -1,4 +1,9 @@
 {
+  "variables": {
+    # The addon compiles the tree-sitter runtime that the tree-sitter peer
+    # dependency vendors, so no tree-sitter library is linked.
+    "runtime": "<!(node -p \"require('path').join(require('path').dirname(require.resolve('tree-sitter/package.json')), 'vendor', 'tree-sitter', 'lib')\")",
+  },
   "targets": [
     {
       "target_name": "tree_sitter_talon_binding",
@@ -7,17 +12,30 @@
       ],
       "include_dirs": [
         "src",
+        "bindings/c",
+        "<(runtime)/include",
+        "<(runtime)/src",
       ],
       "sources": [
         "bindings/node/binding.cc",
+        "bindings/c/talon.c",
+        "bindings/c/json.c",
+        "bindings/c/buffer.c",
         "src/parser.c",
-        "src/scanner.c"
+        "src/scanner.c",
+        "<(runtime)/src/lib.c",
       ],
       "conditions": [
         ["OS!='win'", {
           "cflags_c": [
             "-std=c11",
           ],
+          # The runtime needs POSIX functions, such as fdopen, which -std=c11
+          # hides.
+          "defines": [
+            "_POSIX_C_SOURCE=200112L",
+            "_DEFAULT_SOURCE",
+          ],
         }, { # OS == "win"
           "cflags_c": [
             "/std:c11",
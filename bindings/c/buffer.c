@@ -0,0 +1,59 @@
+#include "buffer.h"
+
+#include <errno.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define write _write
+#else
+#include <unistd.h>
+#endif
+
+#include "tree_sitter/alloc.h"
+
+// Buffers that stream to a file descriptor are flushed at this size.
+#define STREAM_BUFFER_SIZE (64 * 1024)
+
+void talon_buffer_init(TalonBuffer *buffer, int fd) {
+    memset(buffer, 0, sizeof(*buffer));
+    buffer->fd = fd;
+}
+
+bool talon_buffer_flush(TalonBuffer *buffer) {
+    if (buffer->fd < 0) {
+        return !buffer->failed;
+    }
+    size_t written = 0;
+    while (!buffer->failed && written < buffer->size) {
+        size_t chunk = buffer->size - written;
+        long result = write(buffer->fd, buffer->data + written, chunk > 1 << 30 ? 1 << 30 : (unsigned)chunk);
+        if (result < 0 && errno != EINTR) {
+            buffer->failed = true;
+        } else if (result > 0) {
+            written += (size_t)result;
+        }
+    }
+    buffer->size = 0;
+    return !buffer->failed;
+}
+
+void talon_buffer_grow(TalonBuffer *buffer, size_t size) {
+    if (buffer->fd >= 0 && buffer->size > 0) {
+        talon_buffer_flush(buffer);
+        if (size <= buffer->capacity) {
+            return;
+        }
+    }
+    size_t capacity = buffer->capacity ? buffer->capacity : (buffer->fd >= 0 ? STREAM_BUFFER_SIZE : 4096);
+    while (capacity < buffer->size + size) {
+        capacity *= 2;
+    }
+    buffer->data = ts_realloc(buffer->data, capacity);
+    buffer->capacity = capacity;
+}
+
+void talon_buffer_delete(TalonBuffer *buffer) {
+    ts_free(buffer->data);
+    buffer->data = NULL;
+    buffer->size = buffer->capacity = 0;
+}
@@ -0,0 +1,40 @@
+#ifndef TREE_SITTER_TALON_BUFFER_H_
+#define TREE_SITTER_TALON_BUFFER_H_
+
+#include <string.h>
+
+#include "talon.h"
+
+// Make room for at least size more bytes.
+void talon_buffer_grow(TalonBuffer *buffer, size_t size);
+
+static inline char *buffer_reserve(TalonBuffer *buffer, size_t size) {
+    if (buffer->size + size > buffer->capacity) {
+        talon_buffer_grow(buffer, size);
+    }
+    return buffer->data + buffer->size;
+}
+
+static inline void buffer_write(TalonBuffer *buffer, const char *data, size_t size) {
+    memcpy(buffer_reserve(buffer, size), data, size);
+    buffer->size += size;
+}
+
+#define buffer_write_literal(buffer, literal) buffer_write(buffer, literal, sizeof(literal) - 1)
+
+static inline void buffer_putc(TalonBuffer *buffer, char c) {
+    *buffer_reserve(buffer, 1) = c;
+    buffer->size++;
+}
+
+static inline void buffer_write_uint(TalonBuffer *buffer, uint32_t value) {
+    char digits[10];
+    size_t length = 0;
+    do {
+        digits[sizeof(digits) - ++length] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    buffer_write(buffer, digits + sizeof(digits) - length, length);
+}
+
+#endif // TREE_SITTER_TALON_BUFFER_H_
@@ -0,0 +1,439 @@
+#include "talon.h"
+
+#include <string.h>
+
+#include "tree_sitter/array.h"
+
+#define NO_CLAUSE UINT32_MAX
+#define NO_KEY UINT32_MAX
+
+typedef Array(uint32_t) Indices;
+typedef Array(char) Bytes;
+
+// A line of a header, as a test of a condition in a clause.
+typedef struct {
+    uint32_t clause;
+    uint32_t condition;
+    bool negative;
+} Literal;
+
+struct TalonContexts {
+    // Conditions by "key:value", with the id of their key, and keys by
+    // name, each with the conditions that are patterns on it.
+    TalonWords *conditions;
+    TalonWords *keys;
+    Indices condition_keys;
+    Array(bool) condition_patterns;
+    Indices key_pattern_offsets;
+    Indices key_patterns;
+
+    // The clauses of each condition, as clause << 1 | negative, from
+    // posting_offsets[condition].
+    Indices posting_offsets;
+    Indices postings;
+
+    // Each clause holds if its positive_counts[i] positive literals hold
+    // and none of its negative ones do, and each group of alternative
+    // clauses holds if one of its clauses does. A file is active if all
+    // file_group_counts[i] of its groups hold.
+    Indices positive_counts;
+    Indices clause_groups;
+    Indices group_files;
+    Indices group_keys;
+    Indices file_group_counts;
+    // The clauses without positive literals, which hold unless a negative
+    // one does, and the files without a header.
+    Indices free_clauses;
+    Indices free_files;
+
+    Array(Literal) literals;
+    Bytes buffer;
+    bool built;
+};
+
+TalonContexts *talon_contexts_new(void) {
+    TalonContexts *contexts = ts_calloc(1, sizeof(TalonContexts));
+    contexts->conditions = talon_words_new();
+    contexts->keys = talon_words_new();
+    return contexts;
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Intern "key:value" in a table of conditions, building it in buffer.
+static uint32_t find_condition(const TalonWords *conditions, Bytes *buffer, const char *key,
+                               uint32_t key_length, const char *value, uint32_t value_length) {
+    array_clear(buffer);
+    array_extend(buffer, key_length, key);
+    array_push(buffer, ':');
+    array_extend(buffer, value_length, value);
+    return talon_words_find(conditions, buffer->contents, buffer->size);
+}
+
+uint32_t talon_contexts_add_file(TalonContexts *contexts, const TalonFile *file) {
+    uint32_t first_group = contexts->group_files.size, file_index = contexts->file_group_counts.size;
+    uint32_t clause = NO_CLAUSE;
+    for (uint32_t i = 0; i < file->match_count; i++) {
+        const TalonMatch *match = &file->matches[i];
+        const char *key = file->source + match->left_start, *value = file->source + match->right_start;
+        uint32_t key_length = match->left_end - match->left_start, value_length = match->right_end - match->right_start;
+        while (value_length > 0 && is_space(*value)) {
+            value++;
+            value_length--;
+        }
+        while (value_length > 0 && is_space(value[value_length - 1])) {
+            value_length--;
+        }
+        uint32_t key_id = talon_words_intern(contexts->keys, key, key_length);
+        bool negative = (match->modifiers & TALON_MATCH_NOT) != 0;
+
+        // Start a clause, in the group of the key of its first line, or a
+        // group of its own if that line is negated.
+        if (clause == NO_CLAUSE || !(match->modifiers & TALON_MATCH_AND)) {
+            uint32_t group = first_group;
+            while (group < contexts->group_files.size && (negative || contexts->group_keys.contents[group] != key_id)) {
+                group++;
+            }
+            if (group == contexts->group_files.size) {
+                array_push(&contexts->group_files, file_index);
+                array_push(&contexts->group_keys, negative ? NO_KEY : key_id);
+            }
+            clause = contexts->clause_groups.size;
+            array_push(&contexts->clause_groups, group);
+            array_push(&contexts->positive_counts, 0);
+        }
+
+        uint32_t condition = find_condition(contexts->conditions, &contexts->buffer, key, key_length, value,
+                                            value_length);
+        if (condition == TALON_NO_WORD) {
+            condition = talon_words_intern(contexts->conditions, contexts->buffer.contents, contexts->buffer.size);
+            array_push(&contexts->condition_keys, key_id);
+            array_push(&contexts->condition_patterns, value_length > 1 && value[0] == '/');
+        }
+        bool repeated = false;
+        for (uint32_t j = contexts->literals.size; j-- > 0 && contexts->literals.contents[j].clause == clause;) {
+            const Literal *literal = &contexts->literals.contents[j];
+            repeated |= literal->condition == condition && literal->negative == negative;
+        }
+        if (!repeated) {
+            Literal literal = {clause, condition, negative};
+            array_push(&contexts->literals, literal);
+            contexts->positive_counts.contents[clause] += !negative;
+        }
+    }
+    array_push(&contexts->file_group_counts, contexts->group_files.size - first_group);
+    return file_index;
+}
+
+// Group ids by a key with a counting sort, into offsets with one entry per
+// key and one past the last.
+static void group_by(Indices *offsets, Indices *values, uint32_t key_count, const uint32_t *keys,
+                     const uint32_t *ids, uint32_t count) {
+    array_grow_by(offsets, key_count + 1);
+    for (uint32_t i = 0; i < count; i++) {
+        offsets->contents[keys[i] + 1]++;
+    }
+    for (uint32_t key = 0; key < key_count; key++) {
+        offsets->contents[key + 1] += offsets->contents[key];
+    }
+    uint32_t *next = ts_malloc((key_count + 1) * sizeof(uint32_t));
+    memcpy(next, offsets->contents, (key_count + 1) * sizeof(uint32_t));
+    array_grow_by(values, count);
+    for (uint32_t i = 0; i < count; i++) {
+        values->contents[next[keys[i]]++] = ids[i];
+    }
+    ts_free(next);
+}
+
+void talon_contexts_build(TalonContexts *contexts) {
+    if (contexts->built) {
+        return;
+    }
+    contexts->built = true;
+    uint32_t condition_count = talon_words_count(contexts->conditions);
+    uint32_t literal_count = contexts->literals.size;
+    uint32_t *keys = ts_malloc((literal_count + condition_count + 1) * sizeof(uint32_t));
+    uint32_t *ids = ts_malloc((literal_count + condition_count + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < literal_count; i++) {
+        const Literal *literal = &contexts->literals.contents[i];
+        keys[i] = literal->condition;
+        ids[i] = literal->clause << 1 | literal->negative;
+    }
+    group_by(&contexts->posting_offsets, &contexts->postings, condition_count, keys, ids, literal_count);
+
+    uint32_t pattern_count = 0;
+    for (uint32_t condition = 0; condition < condition_count; condition++) {
+        if (contexts->condition_patterns.contents[condition]) {
+            keys[pattern_count] = contexts->condition_keys.contents[condition];
+            ids[pattern_count++] = condition;
+        }
+    }
+    group_by(&contexts->key_pattern_offsets, &contexts->key_patterns, talon_words_count(contexts->keys), keys, ids,
+             pattern_count);
+    ts_free(keys);
+    ts_free(ids);
+
+    for (uint32_t clause = 0; clause < contexts->positive_counts.size; clause++) {
+        if (contexts->positive_counts.contents[clause] == 0) {
+            array_push(&contexts->free_clauses, clause);
+        }
+    }
+    for (uint32_t file = 0; file < contexts->file_group_counts.size; file++) {
+        if (contexts->file_group_counts.contents[file] == 0) {
+            array_push(&contexts->free_files, file);
+        }
+    }
+    array_delete(&contexts->literals);
+}
+
+uint32_t talon_contexts_condition_count(const TalonContexts *contexts) {
+    return talon_words_count(contexts->conditions);
+}
+
+uint32_t talon_contexts_clause_count(const TalonContexts *contexts) {
+    return contexts->positive_counts.size;
+}
+
+void talon_contexts_delete(TalonContexts *contexts) {
+    talon_words_delete(contexts->conditions);
+    talon_words_delete(contexts->keys);
+    array_delete(&contexts->condition_keys);
+    array_delete(&contexts->condition_patterns);
+    array_delete(&contexts->key_pattern_offsets);
+    array_delete(&contexts->key_patterns);
+    array_delete(&contexts->posting_offsets);
+    array_delete(&contexts->postings);
+    array_delete(&contexts->positive_counts);
+    array_delete(&contexts->clause_groups);
+    array_delete(&contexts->group_files);
+    array_delete(&contexts->group_keys);
+    array_delete(&contexts->file_group_counts);
+    array_delete(&contexts->free_clauses);
+    array_delete(&contexts->free_files);
+    array_delete(&contexts->literals);
+    array_delete(&contexts->buffer);
+    ts_free(contexts);
+}
+
+// Scopes
+
+struct TalonScope {
+    const TalonContexts *contexts;
+    TalonPatternCallback match;
+    void *payload;
+    // The conditions that hold, and the condition of the value of each key.
+    uint64_t *conditions;
+    uint32_t *values;
+    Bytes buffer;
+
+    // The clauses, groups and files reached by the last evaluation are
+    // those whose stamp is the evaluation's epoch, so that nothing needs
+    // clearing between evaluations.
+    uint32_t epoch;
+    uint32_t *clause_stamps;
+    uint32_t *clause_hits;
+    bool *clause_violated;
+    uint32_t *group_stamps;
+    uint32_t *file_stamps;
+    uint32_t *file_hits;
+    Indices clauses;
+    Indices files;
+    uint64_t *active;
+    Indices result;
+};
+
+TalonScope *talon_scope_new(const TalonContexts *contexts, TalonPatternCallback match, void *payload) {
+    uint32_t condition_count = talon_words_count(contexts->conditions);
+    uint32_t clause_count = contexts->positive_counts.size, group_count = contexts->group_files.size;
+    uint32_t file_count = contexts->file_group_counts.size, key_count = talon_words_count(contexts->keys);
+    TalonScope *scope = ts_calloc(1, sizeof(TalonScope));
+    scope->contexts = contexts;
+    scope->match = match;
+    scope->payload = payload;
+    scope->conditions = ts_calloc(condition_count / 64 + 1, sizeof(uint64_t));
+    scope->values = ts_malloc((key_count + 1) * sizeof(uint32_t));
+    for (uint32_t key = 0; key < key_count; key++) {
+        scope->values[key] = TALON_NO_WORD;
+    }
+    scope->clause_stamps = ts_calloc(clause_count + 1, sizeof(uint32_t));
+    scope->clause_hits = ts_calloc(clause_count + 1, sizeof(uint32_t));
+    scope->clause_violated = ts_calloc(clause_count + 1, sizeof(bool));
+    scope->group_stamps = ts_calloc(group_count + 1, sizeof(uint32_t));
+    scope->file_stamps = ts_calloc(file_count + 1, sizeof(uint32_t));
+    scope->file_hits = ts_calloc(file_count + 1, sizeof(uint32_t));
+    scope->active = ts_calloc(file_count / 64 + 1, sizeof(uint64_t));
+    return scope;
+}
+
+static void set_condition(TalonScope *scope, uint32_t condition, bool holds) {
+    uint64_t bit = 1ull << (condition % 64);
+    if (holds) {
+        scope->conditions[condition / 64] |= bit;
+    } else {
+        scope->conditions[condition / 64] &= ~bit;
+    }
+}
+
+void talon_scope_set(TalonScope *scope, const char *key, const char *value) {
+    const TalonContexts *contexts = scope->contexts;
+    uint32_t key_id = talon_words_find(contexts->keys, key, (uint32_t)strlen(key));
+    if (key_id == TALON_NO_WORD) {
+        return;
+    }
+    if (scope->values[key_id] != TALON_NO_WORD) {
+        set_condition(scope, scope->values[key_id], false);
+    }
+    scope->values[key_id] = TALON_NO_WORD;
+    uint32_t key_length = (uint32_t)strlen(key), value_length = value != NULL ? (uint32_t)strlen(value) : 0;
+    if (value != NULL) {
+        uint32_t condition = find_condition(contexts->conditions, &scope->buffer, key, key_length, value, value_length);
+        if (condition != TALON_NO_WORD && !contexts->condition_patterns.contents[condition]) {
+            scope->values[key_id] = condition;
+            set_condition(scope, condition, true);
+        }
+    }
+    for (uint32_t i = contexts->key_pattern_offsets.contents[key_id];
+         i < contexts->key_pattern_offsets.contents[key_id + 1]; i++) {
+        uint32_t condition = contexts->key_patterns.contents[i], length;
+        const char *pattern = talon_words_string(contexts->conditions, condition, &length);
+        pattern += key_length + 1;
+        length -= key_length + 1;
+        set_condition(scope, condition,
+                      value != NULL && scope->match != NULL &&
+                          scope->match(scope->payload, pattern, length, value, value_length));
+    }
+}
+
+void talon_scope_enable(TalonScope *scope, const char *key, const char *name, bool enabled) {
+    uint32_t condition = find_condition(scope->contexts->conditions, &scope->buffer, key, (uint32_t)strlen(key), name,
+                                        (uint32_t)strlen(name));
+    if (condition != TALON_NO_WORD) {
+        set_condition(scope, condition, enabled);
+    }
+}
+
+static inline uint32_t lowest_bit(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t)__builtin_ctzll(bits);
+#else
+    uint32_t index = 0;
+    for (; (bits & 1) == 0; bits >>= 1) {
+        index++;
+    }
+    return index;
+#endif
+}
+
+// Count a clause that holds towards its group, and the group towards its
+// file.
+static void hold_clause(TalonScope *scope, uint32_t clause) {
+    const TalonContexts *contexts = scope->contexts;
+    uint32_t group = contexts->clause_groups.contents[clause];
+    if (scope->group_stamps[group] == scope->epoch) {
+        return;
+    }
+    scope->group_stamps[group] = scope->epoch;
+    uint32_t file = contexts->group_files.contents[group];
+    if (scope->file_stamps[file] != scope->epoch) {
+        scope->file_stamps[file] = scope->epoch;
+        scope->file_hits[file] = 0;
+        array_push(&scope->files, file);
+    }
+    scope->file_hits[file]++;
+}
+
+uint32_t talon_scope_active_files(TalonScope *scope, const uint32_t **files) {
+    const TalonContexts *contexts = scope->contexts;
+    uint32_t condition_count = talon_words_count(contexts->conditions);
+    uint32_t clause_count = contexts->positive_counts.size, group_count = contexts->group_files.size;
+    uint32_t file_count = contexts->file_group_counts.size;
+    if (++scope->epoch == 0) {
+        memset(scope->clause_stamps, 0, clause_count * sizeof(uint32_t));
+        memset(scope->group_stamps, 0, group_count * sizeof(uint32_t));
+        memset(scope->file_stamps, 0, file_count * sizeof(uint32_t));
+        scope->epoch = 1;
+    }
+    array_clear(&scope->clauses);
+    array_clear(&scope->files);
+
+    // Count the literals of each clause that the conditions holding make
+    // true or false.
+    for (uint32_t block = 0; block <= condition_count / 64; block++) {
+        for (uint64_t bits = scope->conditions[block]; bits != 0; bits &= bits - 1) {
+            uint32_t condition = block * 64 + lowest_bit(bits);
+            for (uint32_t i = contexts->posting_offsets.contents[condition];
+                 i < contexts->posting_offsets.contents[condition + 1]; i++) {
+                uint32_t clause = contexts->postings.contents[i] >> 1;
+                if (scope->clause_stamps[clause] != scope->epoch) {
+                    scope->clause_stamps[clause] = scope->epoch;
+                    scope->clause_hits[clause] = 0;
+                    scope->clause_violated[clause] = false;
+                    array_push(&scope->clauses, clause);
+                }
+                if (contexts->postings.contents[i] & 1) {
+                    scope->clause_violated[clause] = true;
+                } else {
+                    scope->clause_hits[clause]++;
+                }
+            }
+        }
+    }
+    for (uint32_t i = 0; i < scope->clauses.size; i++) {
+        uint32_t clause = scope->clauses.contents[i], positive_count = contexts->positive_counts.contents[clause];
+        if (positive_count > 0 && scope->clause_hits[clause] == positive_count && !scope->clause_violated[clause]) {
+            hold_clause(scope, clause);
+        }
+    }
+    for (uint32_t i = 0; i < contexts->free_clauses.size; i++) {
+        uint32_t clause = contexts->free_clauses.contents[i];
+        if (scope->clause_stamps[clause] != scope->epoch || !scope->clause_violated[clause]) {
+            hold_clause(scope, clause);
+        }
+    }
+
+    // Mark the active files in a bitset, to list them in order.
+    for (uint32_t i = 0; i < scope->files.size; i++) {
+        uint32_t file = scope->files.contents[i];
+        if (scope->file_hits[file] == contexts->file_group_counts.contents[file]) {
+            scope->active[file / 64] |= 1ull << (file % 64);
+        }
+    }
+    for (uint32_t i = 0; i < contexts->free_files.size; i++) {
+        uint32_t file = contexts->free_files.contents[i];
+        scope->active[file / 64] |= 1ull << (file % 64);
+    }
+    array_clear(&scope->result);
+    for (uint32_t block = 0; block <= file_count / 64; block++) {
+        for (uint64_t bits = scope->active[block]; bits != 0; bits &= bits - 1) {
+            array_push(&scope->result, block * 64 + lowest_bit(bits));
+        }
+        scope->active[block] = 0;
+    }
+    *files = scope->result.contents;
+    return scope->result.size;
+}
+
+// Set the epoch of the last evaluation, so that tests can reach the wrap
+// around in a few evaluations. Not part of talon.h: talon-unit declares it.
+void talon_scope_set_epoch(TalonScope *scope, uint32_t epoch) {
+    scope->epoch = epoch;
+}
+
+void talon_scope_delete(TalonScope *scope) {
+    ts_free(scope->conditions);
+    ts_free(scope->values);
+    array_delete(&scope->buffer);
+    ts_free(scope->clause_stamps);
+    ts_free(scope->clause_hits);
+    ts_free(scope->clause_violated);
+    ts_free(scope->group_stamps);
+    ts_free(scope->file_stamps);
+    ts_free(scope->file_hits);
+    array_delete(&scope->clauses);
+    array_delete(&scope->files);
+    ts_free(scope->active);
+    array_delete(&scope->result);
+    ts_free(scope);
+}
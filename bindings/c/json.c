@@ -0,0 +1,131 @@
+#include "buffer.h"
+
+#include "tree_sitter/array.h"
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+// Whether each byte must be escaped in a JSON string.
+static const bool ESCAPED[256] = {
+    [0x00] = 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    [0x10] = 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    ['"'] = 1,
+    ['\\'] = 1,
+};
+
+// Write a quoted JSON string, copying runs of bytes that need no escaping
+// in bulk. Bytes above 0x7f are copied as they are.
+static void write_string(TalonBuffer *buffer, const char *string, size_t length) {
+    buffer_putc(buffer, '"');
+    size_t run = 0;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)string[i];
+        if (!ESCAPED[c]) {
+            continue;
+        }
+        buffer_write(buffer, string + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"': buffer_write_literal(buffer, "\\\""); break;
+            case '\\': buffer_write_literal(buffer, "\\\\"); break;
+            case '\n': buffer_write_literal(buffer, "\\n"); break;
+            case '\r': buffer_write_literal(buffer, "\\r"); break;
+            case '\t': buffer_write_literal(buffer, "\\t"); break;
+            default: {
+                char escape[] = {'\\', 'u', '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0xf]};
+                buffer_write(buffer, escape, sizeof(escape));
+            }
+        }
+    }
+    buffer_write(buffer, string + run, length - run);
+    buffer_putc(buffer, '"');
+}
+
+static void write_cstring(TalonBuffer *buffer, const char *string) {
+    write_string(buffer, string, strlen(string));
+}
+
+static bool is_included(TSNode node, uint32_t flags) {
+    return !(flags & TALON_JSON_NAMED) || ts_node_is_named(node);
+}
+
+// Write the keys of a node, leaving its object open for its children.
+static void open_node(TalonBuffer *buffer, const TSTreeCursor *cursor, TSNode node, const char *source,
+                      uint32_t flags) {
+    buffer_write_literal(buffer, "{\"type\":");
+    write_cstring(buffer, ts_node_type(node));
+    if (ts_node_is_named(node)) {
+        buffer_write_literal(buffer, ",\"named\":true");
+    } else {
+        buffer_write_literal(buffer, ",\"named\":false");
+    }
+    const char *field = ts_tree_cursor_current_field_name(cursor);
+    if (field != NULL) {
+        buffer_write_literal(buffer, ",\"field\":");
+        write_cstring(buffer, field);
+    }
+    if (ts_node_is_missing(node)) {
+        buffer_write_literal(buffer, ",\"missing\":true");
+    }
+    uint32_t start = ts_node_start_byte(node), end = ts_node_end_byte(node);
+    buffer_write_literal(buffer, ",\"start\":");
+    buffer_write_uint(buffer, start);
+    buffer_write_literal(buffer, ",\"end\":");
+    buffer_write_uint(buffer, end);
+
+    uint32_t child_count = flags & TALON_JSON_NAMED ? ts_node_named_child_count(node) : ts_node_child_count(node);
+    if (flags & TALON_JSON_TEXT && child_count == 0) {
+        buffer_write_literal(buffer, ",\"text\":");
+        write_string(buffer, source + start, end - start);
+    }
+}
+
+bool talon_write_json(TalonBuffer *buffer, const TSTree *tree, const char *source, uint32_t flags) {
+    // For each open node, whether its children array has been opened.
+    Array(bool) open = array_new();
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+    open_node(buffer, &cursor, ts_tree_cursor_current_node(&cursor), source, flags);
+    array_push(&open, false);
+
+    // The current node is open unless it was skipped, in which case its
+    // subtree is skipped too.
+    bool current_open = true;
+    for (;;) {
+        if (!current_open || !ts_tree_cursor_goto_first_child(&cursor)) {
+            if (current_open) {
+                if (array_pop(&open)) {
+                    buffer_putc(buffer, ']');
+                }
+                buffer_putc(buffer, '}');
+            }
+            while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+                if (!ts_tree_cursor_goto_parent(&cursor)) {
+                    goto done;
+                }
+                if (array_pop(&open)) {
+                    buffer_putc(buffer, ']');
+                }
+                buffer_putc(buffer, '}');
+            }
+        }
+
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+        current_open = is_included(node, flags);
+        if (current_open) {
+            bool *siblings = array_back(&open);
+            if (*siblings) {
+                buffer_putc(buffer, ',');
+            } else {
+                buffer_write_literal(buffer, ",\"children\":[");
+                *siblings = true;
+            }
+            open_node(buffer, &cursor, node, source, flags);
+            array_push(&open, false);
+        }
+    }
+
+done:
+    ts_tree_cursor_delete(&cursor);
+    array_delete(&open);
+    buffer_putc(buffer, '\n');
+    return talon_buffer_flush(buffer);
+}
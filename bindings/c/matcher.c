@@ -0,0 +1,935 @@
+#include "talon.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree_sitter/array.h"
+
+// The kind of the edges of the automaton for undefined lists and captures,
+// which match any word.
+#define EDGE_ANY 3
+
+// The word of a transition on any word.
+#define ANY_WORD UINT32_MAX
+
+#define NO_STATE UINT32_MAX
+#define NO_BINDING UINT32_MAX
+#define NO_DEFINITION UINT32_MAX
+
+// How deeply captures are expanded inside captures, beyond which they
+// match any words.
+#define CAPTURE_DEPTH 8
+
+// An automaton as in TalonAutomaton, owned by the matcher.
+typedef struct {
+    uint32_t state_count;
+    uint32_t *edge_offsets;
+    TalonEdge *edges;
+    bool *accepting;
+} Definition;
+
+typedef struct {
+    uint32_t list;
+    uint32_t offset;
+    uint32_t length;
+} ListItem;
+
+// A transition of the expanded automaton of a command, on a word or any
+// word. Transitions that consume the words of a list or capture of the
+// command's rule have its binding.
+typedef struct {
+    uint32_t from;
+    uint32_t to;
+    uint32_t word;
+    uint32_t binding;
+    // Whether the transition starts a new binding, rather than continuing
+    // one, which tells repeats of a list or capture apart.
+    bool begins;
+} Transition;
+
+typedef struct {
+    uint32_t kind;
+    uint32_t name;
+} BindingName;
+
+// The states of a word's shift transitions in a block: state i is set if
+// the word leads from state i - 1 to state i.
+typedef struct {
+    uint32_t block;
+    uint64_t mask;
+} Shift;
+
+// A transition that is not a shift.
+typedef struct {
+    uint32_t from;
+    uint32_t to;
+} Jump;
+
+typedef Array(Definition) Definitions;
+typedef Array(Transition) Transitions;
+typedef Array(uint32_t) Indices;
+
+struct TalonMatcher {
+    TalonWords *words;
+    Definitions commands;
+    Definitions captures;
+    Indices capture_names;
+    Indices item_words;
+    Array(ListItem) items;
+    bool built;
+
+    // The expanded states of all commands, with the states of command i
+    // from command_states[i] up to command_states[i + 1], numbered so that
+    // as many transitions as possible go from a state to the next, and the
+    // names of the bindings of command i from command_bindings[i].
+    uint32_t state_count;
+    uint32_t block_count;
+    Indices command_states;
+    Indices command_bindings;
+    Array(BindingName) bindings;
+    Indices transition_offsets;
+    Transitions transitions;
+    uint64_t *start;
+    uint64_t *accepting;
+
+    // The shifts and jumps of each word, by word id, from shift_offsets[id]
+    // and jump_offsets[id].
+    uint32_t label_count;
+    Indices shift_offsets;
+    Array(Shift) shifts;
+    Indices jump_offsets;
+    Array(Jump) jumps;
+
+    // The transitions on any word, by the block of their source state:
+    // shifts and loops as masks of source states, and other jumps from
+    // any_jump_offsets[block].
+    uint64_t *any_shifts;
+    uint64_t *any_loops;
+    Indices any_jump_offsets;
+    Array(Jump) any_jumps;
+    // The blocks whose start states have transitions on any word.
+    Indices start_any_blocks;
+};
+
+static void Definition_copy(Definition *definition, const TalonAutomaton *automaton) {
+    uint32_t state_count = automaton->state_count, edge_count = automaton->edge_offsets[state_count];
+    definition->state_count = state_count;
+    definition->edge_offsets = ts_malloc((state_count + 1) * sizeof(uint32_t));
+    definition->edges = ts_malloc((edge_count + 1) * sizeof(TalonEdge));
+    definition->accepting = ts_malloc(state_count * sizeof(bool));
+    memcpy(definition->edge_offsets, automaton->edge_offsets, (state_count + 1) * sizeof(uint32_t));
+    memcpy(definition->edges, automaton->edges, edge_count * sizeof(TalonEdge));
+    memcpy(definition->accepting, automaton->accepting, state_count * sizeof(bool));
+}
+
+static void Definition_delete(Definition *definition) {
+    ts_free(definition->edge_offsets);
+    ts_free(definition->edges);
+    ts_free(definition->accepting);
+}
+
+TalonMatcher *talon_matcher_new(TalonWords *words) {
+    TalonMatcher *matcher = ts_calloc(1, sizeof(TalonMatcher));
+    matcher->words = words;
+    return matcher;
+}
+
+void talon_matcher_add_list_item(TalonMatcher *matcher, const char *list, const char *item) {
+    ListItem entry = {talon_words_intern(matcher->words, list, (uint32_t)strlen(list)), matcher->item_words.size, 0};
+    for (const char *word = item;;) {
+        word += strspn(word, " ");
+        if (*word == '\0') {
+            break;
+        }
+        uint32_t length = (uint32_t)strcspn(word, " ");
+        array_push(&matcher->item_words, talon_words_intern(matcher->words, word, length));
+        entry.length++;
+        word += length;
+    }
+    if (entry.length > 0) {
+        array_push(&matcher->items, entry);
+    }
+}
+
+void talon_matcher_add_capture(TalonMatcher *matcher, const char *capture, const TalonAutomaton *rule) {
+    Definition definition;
+    Definition_copy(&definition, rule);
+    array_push(&matcher->captures, definition);
+    array_push(&matcher->capture_names, talon_words_intern(matcher->words, capture, (uint32_t)strlen(capture)));
+}
+
+uint32_t talon_matcher_add_command(TalonMatcher *matcher, const TalonAutomaton *rule) {
+    Definition definition;
+    Definition_copy(&definition, rule);
+    array_push(&matcher->commands, definition);
+    return matcher->commands.size - 1;
+}
+
+// Expansion of list and capture edges
+
+typedef struct {
+    const TalonMatcher *matcher;
+    // The index of the definition of each list in list_definitions, and
+    // of each capture in the matcher's captures, by name id.
+    uint32_t *lists;
+    uint32_t *captures;
+    Definitions list_definitions;
+    Definition any;
+} Resolver;
+
+// An item of a list, pointing at its words, for sorting.
+typedef struct {
+    uint32_t list;
+    const uint32_t *words;
+    uint32_t length;
+} SortedItem;
+
+static int compare_items(const void *a, const void *b) {
+    const SortedItem *x = a, *y = b;
+    if (x->list != y->list) {
+        return x->list < y->list ? -1 : 1;
+    }
+    for (uint32_t i = 0; i < x->length && i < y->length; i++) {
+        if (x->words[i] != y->words[i]) {
+            return x->words[i] < y->words[i] ? -1 : 1;
+        }
+    }
+    return (x->length > y->length) - (x->length < y->length);
+}
+
+// Group edges by source state with a counting sort.
+static void group_edges(Definition *definition, const uint32_t *sources, const TalonEdge *edges,
+                        uint32_t edge_count) {
+    uint32_t state_count = definition->state_count;
+    definition->edge_offsets = ts_calloc(state_count + 1, sizeof(uint32_t));
+    definition->edges = ts_malloc((edge_count + 1) * sizeof(TalonEdge));
+    for (uint32_t i = 0; i < edge_count; i++) {
+        definition->edge_offsets[sources[i] + 1]++;
+    }
+    for (uint32_t state = 0; state < state_count; state++) {
+        definition->edge_offsets[state + 1] += definition->edge_offsets[state];
+    }
+    uint32_t *next = ts_malloc((state_count + 1) * sizeof(uint32_t));
+    memcpy(next, definition->edge_offsets, (state_count + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < edge_count; i++) {
+        definition->edges[next[sources[i]]++] = edges[i];
+    }
+    ts_free(next);
+}
+
+// Build a trie of the items of each list, as a definition. With the items
+// sorted, each item shares the path of the one before it up to their
+// common prefix.
+static void build_lists(Resolver *resolver, const TalonMatcher *matcher) {
+    uint32_t item_count = matcher->items.size;
+    SortedItem *items = ts_malloc((item_count + 1) * sizeof(SortedItem));
+    for (uint32_t i = 0; i < item_count; i++) {
+        const ListItem *item = &matcher->items.contents[i];
+        SortedItem sorted = {item->list, matcher->item_words.contents + item->offset, item->length};
+        items[i] = sorted;
+    }
+    qsort(items, item_count, sizeof(SortedItem), compare_items);
+
+    Array(TalonEdge) edges = array_new();
+    Indices sources = array_new();
+    Array(bool) accepting = array_new();
+    Indices path = array_new();
+    for (uint32_t i = 0; i < item_count;) {
+        uint32_t list = items[i].list;
+        array_clear(&edges);
+        array_clear(&sources);
+        array_clear(&accepting);
+        array_clear(&path);
+        array_push(&accepting, false);
+        array_push(&path, 0);
+        for (const SortedItem *previous = NULL; i < item_count && items[i].list == list; previous = &items[i++]) {
+            uint32_t shared = 0;
+            while (previous != NULL && shared < previous->length && shared < items[i].length &&
+                   previous->words[shared] == items[i].words[shared]) {
+                shared++;
+            }
+            path.size = shared + 1;
+            for (uint32_t j = shared; j < items[i].length; j++) {
+                TalonEdge edge = {TALON_EDGE_WORD, items[i].words[j], accepting.size};
+                array_push(&edges, edge);
+                array_push(&sources, *array_back(&path));
+                array_push(&path, accepting.size);
+                array_push(&accepting, false);
+            }
+            accepting.contents[*array_back(&path)] = true;
+        }
+
+        Definition definition = {accepting.size, NULL, NULL, ts_malloc(accepting.size)};
+        memcpy(definition.accepting, accepting.contents, accepting.size);
+        group_edges(&definition, sources.contents, edges.contents, edges.size);
+        resolver->lists[list] = resolver->list_definitions.size;
+        array_push(&resolver->list_definitions, definition);
+    }
+    ts_free(items);
+    array_delete(&edges);
+    array_delete(&sources);
+    array_delete(&accepting);
+    array_delete(&path);
+}
+
+// One or more of any word, for lists and captures without a definition.
+static uint32_t ANY_OFFSETS[] = {0, 1, 2};
+static TalonEdge ANY_EDGES[] = {{EDGE_ANY, 0, 1}, {EDGE_ANY, 0, 1}};
+static bool ANY_ACCEPTING[] = {false, true};
+
+static void Resolver_init(Resolver *resolver, const TalonMatcher *matcher) {
+    uint32_t name_count = talon_words_count(matcher->words);
+    resolver->matcher = matcher;
+    resolver->lists = ts_malloc((name_count + 1) * sizeof(uint32_t));
+    resolver->captures = ts_malloc((name_count + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < name_count; i++) {
+        resolver->lists[i] = resolver->captures[i] = NO_DEFINITION;
+    }
+    for (uint32_t i = 0; i < matcher->captures.size; i++) {
+        resolver->captures[matcher->capture_names.contents[i]] = i;
+    }
+    array_init(&resolver->list_definitions);
+    build_lists(resolver, matcher);
+    resolver->any = (Definition){2, ANY_OFFSETS, ANY_EDGES, ANY_ACCEPTING};
+}
+
+static void Resolver_delete(Resolver *resolver) {
+    for (uint32_t i = 0; i < resolver->list_definitions.size; i++) {
+        Definition_delete(&resolver->list_definitions.contents[i]);
+    }
+    array_delete(&resolver->list_definitions);
+    ts_free(resolver->lists);
+    ts_free(resolver->captures);
+}
+
+static const Definition *resolve(const Resolver *resolver, uint32_t kind, uint32_t name, uint32_t depth) {
+    if (kind == TALON_EDGE_LIST && resolver->lists[name] != NO_DEFINITION) {
+        return &resolver->list_definitions.contents[resolver->lists[name]];
+    }
+    if (kind == TALON_EDGE_CAPTURE && resolver->captures[name] != NO_DEFINITION && depth < CAPTURE_DEPTH) {
+        return &resolver->matcher->captures.contents[resolver->captures[name]];
+    }
+    return &resolver->any;
+}
+
+// The expanded automaton of one command, as it is built.
+typedef struct {
+    const Resolver *resolver;
+    uint32_t state_count;
+    Transitions transitions;
+    Array(bool) accepting;
+    Array(BindingName) bindings;
+} Expansion;
+
+static uint32_t add_state(Expansion *expansion, bool accepting) {
+    array_push(&expansion->accepting, accepting);
+    return expansion->state_count++;
+}
+
+static void expand(Expansion *expansion, const Definition *definition, uint32_t entry, uint32_t exit,
+                   uint32_t binding, bool begins, uint32_t depth);
+
+// Add the transitions of an edge from one state to another, expanding it
+// if it is a list or capture.
+static void emit(Expansion *expansion, const TalonEdge *edge, uint32_t from, uint32_t to, uint32_t binding,
+                 bool begins, uint32_t depth) {
+    if (edge->kind == TALON_EDGE_WORD || edge->kind == EDGE_ANY) {
+        Transition transition = {from, to, edge->kind == EDGE_ANY ? ANY_WORD : edge->id, binding, begins};
+        array_push(&expansion->transitions, transition);
+        return;
+    }
+    // Lists and captures of the command's own rule bind words; nested ones
+    // are part of the binding they are in.
+    if (binding == NO_BINDING) {
+        BindingName name = {edge->kind, edge->id};
+        binding = expansion->bindings.size;
+        array_push(&expansion->bindings, name);
+        begins = true;
+    }
+    expand(expansion, resolve(expansion->resolver, edge->kind, edge->id, depth), from, to, binding, begins,
+           depth + 1);
+}
+
+// Add the states and transitions of a definition between entry and exit.
+// Without an exit, this is the command's own rule, and its states keep
+// their accepting states. Otherwise, the definition's start state is
+// entry, and an edge to an accepting state also leads to exit, so that no
+// epsilon transitions are needed, and accepting states without edges are
+// left out.
+static void expand(Expansion *expansion, const Definition *definition, uint32_t entry, uint32_t exit,
+                   uint32_t binding, bool begins, uint32_t depth) {
+    uint32_t *states = ts_malloc((definition->state_count + 1) * sizeof(uint32_t));
+    bool start_has_incoming = false;
+    for (uint32_t i = 0; i < definition->edge_offsets[definition->state_count]; i++) {
+        start_has_incoming |= definition->edges[i].target == 0;
+    }
+    for (uint32_t state = 0; state < definition->state_count; state++) {
+        bool has_edges = definition->edge_offsets[state + 1] > definition->edge_offsets[state];
+        if (exit == NO_STATE) {
+            states[state] = state == 0 ? entry : add_state(expansion, definition->accepting[state]);
+        } else if (has_edges && (state > 0 || start_has_incoming)) {
+            // A start state that is returned to needs a state of its own,
+            // since entry has other edges.
+            states[state] = add_state(expansion, false);
+        } else {
+            states[state] = state == 0 ? entry : NO_STATE;
+        }
+    }
+
+    for (uint32_t state = 0; state < definition->state_count; state++) {
+        for (uint32_t i = definition->edge_offsets[state]; i < definition->edge_offsets[state + 1]; i++) {
+            const TalonEdge *edge = &definition->edges[i];
+            uint32_t targets[2], target_count = 0;
+            if (states[edge->target] != NO_STATE) {
+                targets[target_count++] = states[edge->target];
+            }
+            if (exit != NO_STATE && definition->accepting[edge->target]) {
+                targets[target_count++] = exit;
+            }
+            uint32_t sources[2], source_count = 0;
+            sources[source_count++] = states[state];
+            if (exit != NO_STATE && state == 0 && states[0] != entry) {
+                sources[source_count++] = entry;
+            }
+            for (uint32_t s = 0; s < source_count; s++) {
+                for (uint32_t t = 0; t < target_count; t++) {
+                    emit(expansion, edge, sources[s], targets[t], binding, begins && sources[s] == entry, depth);
+                }
+            }
+        }
+    }
+    ts_free(states);
+}
+
+// Building the matcher
+
+typedef struct {
+    uint32_t label;
+    uint32_t state;
+} LabelledState;
+
+typedef struct {
+    uint32_t label;
+    Jump jump;
+} LabelledJump;
+
+static int compare_labelled_states(const void *a, const void *b) {
+    const LabelledState *x = a, *y = b;
+    if (x->label != y->label) {
+        return x->label < y->label ? -1 : 1;
+    }
+    return (x->state > y->state) - (x->state < y->state);
+}
+
+static int compare_labelled_jumps(const void *a, const void *b) {
+    const LabelledJump *x = a, *y = b;
+    if (x->label != y->label) {
+        return x->label < y->label ? -1 : 1;
+    }
+    return (x->jump.from > y->jump.from) - (x->jump.from < y->jump.from);
+}
+
+static void set_bit(uint64_t *bits, uint32_t index) {
+    bits[index / 64] |= 1ull << (index % 64);
+}
+
+static bool get_bit(const uint64_t *bits, uint32_t index) {
+    return (bits[index / 64] >> (index % 64)) & 1;
+}
+
+// Number the states of an expansion in depth-first order, so that a
+// state's first successor usually comes right after it.
+static uint32_t *depth_first_order(const Expansion *expansion) {
+    uint32_t state_count = expansion->state_count, transition_count = expansion->transitions.size;
+    Definition graph = {state_count, NULL, NULL, NULL};
+    uint32_t *sources = ts_malloc((transition_count + 1) * sizeof(uint32_t));
+    TalonEdge *edges = ts_malloc((transition_count + 1) * sizeof(TalonEdge));
+    for (uint32_t i = 0; i < transition_count; i++) {
+        const Transition *transition = &expansion->transitions.contents[i];
+        sources[i] = transition->from;
+        edges[i] = (TalonEdge){TALON_EDGE_WORD, transition->word, transition->to};
+    }
+    group_edges(&graph, sources, edges, transition_count);
+
+    uint32_t *order = ts_malloc(state_count * sizeof(uint32_t));
+    for (uint32_t state = 0; state < state_count; state++) {
+        order[state] = NO_STATE;
+    }
+    Indices stack = array_new();
+    uint32_t next = 0;
+    array_push(&stack, 0);
+    while (stack.size > 0) {
+        uint32_t state = array_pop(&stack);
+        if (order[state] != NO_STATE) {
+            continue;
+        }
+        order[state] = next++;
+        // Push the first edge last, so it is visited next.
+        for (uint32_t i = graph.edge_offsets[state + 1]; i-- > graph.edge_offsets[state];) {
+            if (order[graph.edges[i].target] == NO_STATE) {
+                array_push(&stack, graph.edges[i].target);
+            }
+        }
+    }
+    for (uint32_t state = 0; state < state_count; state++) {
+        if (order[state] == NO_STATE) {
+            order[state] = next++;
+        }
+    }
+    array_delete(&stack);
+    ts_free(graph.edge_offsets);
+    ts_free(graph.edges);
+    ts_free(sources);
+    ts_free(edges);
+    return order;
+}
+
+static void Expansion_clear(Expansion *expansion) {
+    expansion->state_count = 0;
+    array_clear(&expansion->transitions);
+    array_clear(&expansion->accepting);
+    array_clear(&expansion->bindings);
+}
+
+void talon_matcher_build(TalonMatcher *matcher) {
+    if (matcher->built) {
+        return;
+    }
+    matcher->built = true;
+    Resolver resolver;
+    Resolver_init(&resolver, matcher);
+    Expansion expansion = {.resolver = &resolver};
+    array_init(&expansion.transitions);
+    array_init(&expansion.accepting);
+    array_init(&expansion.bindings);
+
+    // Expand each command, number its states after those of the commands
+    // before it, and sort its transitions into shifts and jumps.
+    Transitions transitions = array_new();
+    Array(LabelledState) word_shifts = array_new();
+    Array(LabelledJump) word_jumps = array_new();
+    Indices accepting = array_new(), any_shifts = array_new(), any_loops = array_new();
+    Array(LabelledJump) any_jumps = array_new();
+    for (uint32_t i = 0; i < matcher->commands.size; i++) {
+        const Definition *command = &matcher->commands.contents[i];
+        Expansion_clear(&expansion);
+        uint32_t start = add_state(&expansion, command->accepting[0]);
+        expand(&expansion, command, start, NO_STATE, NO_BINDING, false, 0);
+        uint32_t *order = depth_first_order(&expansion);
+        uint32_t base = matcher->state_count;
+        array_push(&matcher->command_states, base);
+        array_push(&matcher->command_bindings, matcher->bindings.size);
+        array_extend(&matcher->bindings, expansion.bindings.size, expansion.bindings.contents);
+        for (uint32_t state = 0; state < expansion.state_count; state++) {
+            if (expansion.accepting.contents[state]) {
+                array_push(&accepting, base + order[state]);
+            }
+        }
+        for (uint32_t j = 0; j < expansion.transitions.size; j++) {
+            Transition transition = expansion.transitions.contents[j];
+            transition.from = base + order[transition.from];
+            transition.to = base + order[transition.to];
+            array_push(&transitions, transition);
+            if (transition.word == ANY_WORD) {
+                if (transition.to == transition.from + 1) {
+                    array_push(&any_shifts, transition.from);
+                } else if (transition.to == transition.from) {
+                    array_push(&any_loops, transition.from);
+                } else {
+                    LabelledJump jump = {transition.from / 64, {transition.from, transition.to}};
+                    array_push(&any_jumps, jump);
+                }
+            } else if (transition.to == transition.from + 1) {
+                LabelledState shift = {transition.word, transition.to};
+                array_push(&word_shifts, shift);
+            } else {
+                LabelledJump jump = {transition.word, {transition.from, transition.to}};
+                array_push(&word_jumps, jump);
+            }
+        }
+        matcher->state_count += expansion.state_count;
+        ts_free(order);
+    }
+    array_push(&matcher->command_states, matcher->state_count);
+    array_push(&matcher->command_bindings, matcher->bindings.size);
+
+    uint32_t block_count = matcher->block_count = matcher->state_count / 64 + 1;
+    matcher->start = ts_calloc(block_count, sizeof(uint64_t));
+    matcher->accepting = ts_calloc(block_count, sizeof(uint64_t));
+    matcher->any_shifts = ts_calloc(block_count, sizeof(uint64_t));
+    matcher->any_loops = ts_calloc(block_count, sizeof(uint64_t));
+    for (uint32_t i = 0; i < matcher->commands.size; i++) {
+        set_bit(matcher->start, matcher->command_states.contents[i]);
+    }
+    for (uint32_t i = 0; i < accepting.size; i++) {
+        set_bit(matcher->accepting, accepting.contents[i]);
+    }
+    for (uint32_t i = 0; i < any_shifts.size; i++) {
+        set_bit(matcher->any_shifts, any_shifts.contents[i]);
+    }
+    for (uint32_t i = 0; i < any_loops.size; i++) {
+        set_bit(matcher->any_loops, any_loops.contents[i]);
+    }
+
+    // Merge the shifts of each word into masks by block.
+    uint32_t label_count = matcher->label_count = talon_words_count(matcher->words);
+    qsort(word_shifts.contents, word_shifts.size, sizeof(LabelledState), compare_labelled_states);
+    for (uint32_t label = 0, i = 0; label < label_count; label++) {
+        array_push(&matcher->shift_offsets, matcher->shifts.size);
+        for (; i < word_shifts.size && word_shifts.contents[i].label == label; i++) {
+            uint32_t state = word_shifts.contents[i].state;
+            if (matcher->shifts.size == *array_back(&matcher->shift_offsets) ||
+                array_back(&matcher->shifts)->block != state / 64) {
+                Shift shift = {state / 64, 0};
+                array_push(&matcher->shifts, shift);
+            }
+            array_back(&matcher->shifts)->mask |= 1ull << (state % 64);
+        }
+    }
+    array_push(&matcher->shift_offsets, matcher->shifts.size);
+
+    // Group the jumps of each word, and the jumps on any word by block.
+    qsort(word_jumps.contents, word_jumps.size, sizeof(LabelledJump), compare_labelled_jumps);
+    qsort(any_jumps.contents, any_jumps.size, sizeof(LabelledJump), compare_labelled_jumps);
+    for (uint32_t label = 0, i = 0; label < label_count; label++) {
+        array_push(&matcher->jump_offsets, matcher->jumps.size);
+        for (; i < word_jumps.size && word_jumps.contents[i].label == label; i++) {
+            array_push(&matcher->jumps, word_jumps.contents[i].jump);
+        }
+    }
+    array_push(&matcher->jump_offsets, matcher->jumps.size);
+    for (uint32_t block = 0, i = 0; block < block_count; block++) {
+        array_push(&matcher->any_jump_offsets, matcher->any_jumps.size);
+        bool start_jumps = false;
+        for (; i < any_jumps.size && any_jumps.contents[i].label == block; i++) {
+            array_push(&matcher->any_jumps, any_jumps.contents[i].jump);
+            start_jumps |= get_bit(matcher->start, any_jumps.contents[i].jump.from);
+        }
+        if (start_jumps || (matcher->start[block] & (matcher->any_shifts[block] | matcher->any_loops[block])) != 0) {
+            array_push(&matcher->start_any_blocks, block);
+        }
+    }
+    array_push(&matcher->any_jump_offsets, matcher->any_jumps.size);
+
+    // Group the transitions by source state, for finding bindings.
+    uint32_t *next = ts_calloc(matcher->state_count + 1, sizeof(uint32_t));
+    for (uint32_t i = 0; i < transitions.size; i++) {
+        next[transitions.contents[i].from + 1]++;
+    }
+    for (uint32_t state = 0; state < matcher->state_count; state++) {
+        next[state + 1] += next[state];
+    }
+    array_extend(&matcher->transition_offsets, matcher->state_count + 1, next);
+    array_grow_by(&matcher->transitions, transitions.size);
+    for (uint32_t i = 0; i < transitions.size; i++) {
+        matcher->transitions.contents[next[transitions.contents[i].from]++] = transitions.contents[i];
+    }
+    ts_free(next);
+
+    // The rules are no longer needed once expanded.
+    for (uint32_t i = 0; i < matcher->commands.size; i++) {
+        Definition_delete(&matcher->commands.contents[i]);
+    }
+    for (uint32_t i = 0; i < matcher->captures.size; i++) {
+        Definition_delete(&matcher->captures.contents[i]);
+    }
+    array_clear(&matcher->captures);
+    Resolver_delete(&resolver);
+    array_delete(&expansion.transitions);
+    array_delete(&expansion.accepting);
+    array_delete(&expansion.bindings);
+    array_delete(&transitions);
+    array_delete(&word_shifts);
+    array_delete(&word_jumps);
+    array_delete(&accepting);
+    array_delete(&any_shifts);
+    array_delete(&any_loops);
+    array_delete(&any_jumps);
+}
+
+uint32_t talon_matcher_state_count(const TalonMatcher *matcher) {
+    return matcher->state_count;
+}
+
+void talon_matcher_delete(TalonMatcher *matcher) {
+    if (!matcher->built) {
+        for (uint32_t i = 0; i < matcher->commands.size; i++) {
+            Definition_delete(&matcher->commands.contents[i]);
+        }
+        for (uint32_t i = 0; i < matcher->captures.size; i++) {
+            Definition_delete(&matcher->captures.contents[i]);
+        }
+    }
+    array_delete(&matcher->commands);
+    array_delete(&matcher->captures);
+    array_delete(&matcher->capture_names);
+    array_delete(&matcher->item_words);
+    array_delete(&matcher->items);
+    array_delete(&matcher->command_states);
+    array_delete(&matcher->command_bindings);
+    array_delete(&matcher->bindings);
+    array_delete(&matcher->transition_offsets);
+    array_delete(&matcher->transitions);
+    ts_free(matcher->start);
+    ts_free(matcher->accepting);
+    array_delete(&matcher->shift_offsets);
+    array_delete(&matcher->shifts);
+    array_delete(&matcher->jump_offsets);
+    array_delete(&matcher->jumps);
+    ts_free(matcher->any_shifts);
+    ts_free(matcher->any_loops);
+    array_delete(&matcher->any_jump_offsets);
+    array_delete(&matcher->any_jumps);
+    array_delete(&matcher->start_any_blocks);
+    ts_free(matcher);
+}
+
+// Matching
+
+typedef struct {
+    // Two bitsets of active states, which are all zero between phrases,
+    // and the blocks of each that are not zero.
+    uint32_t block_count;
+    uint64_t *bits[2];
+    Indices blocks[2];
+    // Breadth-first search through one command's states, for bindings.
+    Indices layers;
+    Indices layer_offsets;
+    Indices predecessors;
+    Indices path;
+    Array(TalonPhraseMatch) matches;
+    Array(TalonBinding) bindings;
+} Scratch;
+
+void talon_phrase_matches_init(TalonPhraseMatches *matches) {
+    memset(matches, 0, sizeof(TalonPhraseMatches));
+}
+
+void talon_phrase_matches_delete(TalonPhraseMatches *matches) {
+    Scratch *scratch = matches->scratch;
+    if (scratch != NULL) {
+        for (int i = 0; i < 2; i++) {
+            ts_free(scratch->bits[i]);
+            array_delete(&scratch->blocks[i]);
+        }
+        array_delete(&scratch->layers);
+        array_delete(&scratch->layer_offsets);
+        array_delete(&scratch->predecessors);
+        array_delete(&scratch->path);
+        array_delete(&scratch->matches);
+        array_delete(&scratch->bindings);
+        ts_free(scratch);
+    }
+    memset(matches, 0, sizeof(TalonPhraseMatches));
+}
+
+static Scratch *get_scratch(TalonPhraseMatches *matches, const TalonMatcher *matcher) {
+    Scratch *scratch = matches->scratch;
+    if (scratch == NULL) {
+        scratch = matches->scratch = ts_calloc(1, sizeof(Scratch));
+    }
+    if (scratch->block_count < matcher->block_count) {
+        for (int i = 0; i < 2; i++) {
+            ts_free(scratch->bits[i]);
+            // One more block, for shifts out of the last one.
+            scratch->bits[i] = ts_calloc(matcher->block_count + 1, sizeof(uint64_t));
+        }
+        scratch->block_count = matcher->block_count;
+    }
+    return scratch;
+}
+
+static inline void activate(uint64_t *bits, Indices *blocks, uint32_t block, uint64_t mask) {
+    if (mask != 0) {
+        if (bits[block] == 0) {
+            array_push(blocks, block);
+        }
+        bits[block] |= mask;
+    }
+}
+
+static inline uint32_t lowest_bit(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t)__builtin_ctzll(bits);
+#else
+    uint32_t index = 0;
+    for (; (bits & 1) == 0; bits >>= 1) {
+        index++;
+    }
+    return index;
+#endif
+}
+
+static uint32_t command_of_state(const TalonMatcher *matcher, uint32_t state) {
+    uint32_t low = 0, high = matcher->command_states.size - 1;
+    while (high - low > 1) {
+        uint32_t middle = low + (high - low) / 2;
+        if (matcher->command_states.contents[middle] <= state) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// Find the bindings of a command that matched a phrase, by a breadth-first
+// search through the command's states that remembers the transition that
+// first reached each state after each word, then following them back from
+// an accepting state.
+static void find_bindings(const TalonMatcher *matcher, const uint32_t *phrase, uint32_t length,
+                          TalonPhraseMatch *match, Scratch *scratch) {
+    uint32_t base = matcher->command_states.contents[match->command];
+    uint32_t count = matcher->command_states.contents[match->command + 1] - base;
+    array_clear(&scratch->predecessors);
+    array_reserve(&scratch->predecessors, (length + 1) * count);
+    scratch->predecessors.size = (length + 1) * count;
+    uint32_t *predecessors = scratch->predecessors.contents;
+    for (uint32_t i = 0; i < scratch->predecessors.size; i++) {
+        predecessors[i] = NO_STATE;
+    }
+    array_clear(&scratch->layers);
+    array_clear(&scratch->layer_offsets);
+    array_push(&scratch->layers, 0);
+    for (uint32_t i = 0; i < length; i++) {
+        array_push(&scratch->layer_offsets, scratch->layers.size);
+        uint32_t layer_start = i > 0 ? scratch->layer_offsets.contents[i - 1] : 0;
+        uint32_t layer_end = scratch->layer_offsets.contents[i];
+        for (uint32_t j = layer_start; j < layer_end; j++) {
+            uint32_t state = base + scratch->layers.contents[j];
+            for (uint32_t k = matcher->transition_offsets.contents[state];
+                 k < matcher->transition_offsets.contents[state + 1]; k++) {
+                const Transition *transition = &matcher->transitions.contents[k];
+                uint32_t *predecessor = &predecessors[(i + 1) * count + transition->to - base];
+                if ((transition->word == phrase[i] || transition->word == ANY_WORD) && *predecessor == NO_STATE) {
+                    *predecessor = k;
+                    array_push(&scratch->layers, transition->to - base);
+                }
+            }
+        }
+    }
+    uint32_t state = NO_STATE;
+    for (uint32_t j = scratch->layer_offsets.contents[length - 1]; j < scratch->layers.size; j++) {
+        if (get_bit(matcher->accepting, base + scratch->layers.contents[j])) {
+            state = scratch->layers.contents[j];
+            break;
+        }
+    }
+    match->binding_offset = scratch->bindings.size;
+    match->binding_count = 0;
+    if (state == NO_STATE) {
+        return;
+    }
+
+    array_clear(&scratch->path);
+    array_grow_by(&scratch->path, length);
+    for (uint32_t i = length; i > 0; i--) {
+        uint32_t k = predecessors[i * count + state];
+        scratch->path.contents[i - 1] = k;
+        state = matcher->transitions.contents[k].from - base;
+    }
+    const BindingName *names = matcher->bindings.contents + matcher->command_bindings.contents[match->command];
+    uint32_t previous = NO_BINDING;
+    for (uint32_t i = 0; i < length; i++) {
+        const Transition *transition = &matcher->transitions.contents[scratch->path.contents[i]];
+        if (transition->binding != NO_BINDING) {
+            if (transition->begins || transition->binding != previous) {
+                const BindingName *name = &names[transition->binding];
+                TalonBinding binding = {name->kind, name->name, i, i + 1};
+                array_push(&scratch->bindings, binding);
+                match->binding_count++;
+            } else {
+                array_back(&scratch->bindings)->end = i + 1;
+            }
+        }
+        previous = transition->binding;
+    }
+}
+
+static int compare_blocks(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+uint32_t talon_matcher_match(const TalonMatcher *matcher, const uint32_t *phrase, uint32_t length,
+                             TalonPhraseMatches *matches) {
+    Scratch *scratch = get_scratch(matches, matcher);
+    array_clear(&scratch->matches);
+    array_clear(&scratch->bindings);
+
+    // Start with the start states of every command, and run each word
+    // through the shifts and jumps on that word and on any word.
+    const uint64_t *current = matcher->start;
+    Indices *current_blocks = NULL;
+    const Indices *any_blocks = &matcher->start_any_blocks;
+    bool alive = length > 0 && matcher->state_count > 0;
+    for (uint32_t i = 0, buffer = 0; i < length && alive; i++, buffer ^= 1) {
+        uint64_t *next = scratch->bits[buffer];
+        Indices *next_blocks = &scratch->blocks[buffer];
+        array_clear(next_blocks);
+        uint32_t word = phrase[i];
+        if (word < matcher->label_count) {
+            for (uint32_t j = matcher->shift_offsets.contents[word]; j < matcher->shift_offsets.contents[word + 1];
+                 j++) {
+                const Shift *shift = &matcher->shifts.contents[j];
+                uint64_t from = current[shift->block] << 1 | (shift->block > 0 ? current[shift->block - 1] >> 63 : 0);
+                activate(next, next_blocks, shift->block, from & shift->mask);
+            }
+            for (uint32_t j = matcher->jump_offsets.contents[word]; j < matcher->jump_offsets.contents[word + 1]; j++) {
+                const Jump *jump = &matcher->jumps.contents[j];
+                if (get_bit(current, jump->from)) {
+                    activate(next, next_blocks, jump->to / 64, 1ull << (jump->to % 64));
+                }
+            }
+        }
+        for (uint32_t j = 0; j < any_blocks->size; j++) {
+            uint32_t block = any_blocks->contents[j];
+            uint64_t shifted = current[block] & matcher->any_shifts[block];
+            activate(next, next_blocks, block, shifted << 1);
+            activate(next, next_blocks, block + 1, shifted >> 63);
+            activate(next, next_blocks, block, current[block] & matcher->any_loops[block]);
+            for (uint32_t k = matcher->any_jump_offsets.contents[block];
+                 k < matcher->any_jump_offsets.contents[block + 1]; k++) {
+                const Jump *jump = &matcher->any_jumps.contents[k];
+                if (get_bit(current, jump->from)) {
+                    activate(next, next_blocks, jump->to / 64, 1ull << (jump->to % 64));
+                }
+            }
+        }
+        if (current_blocks != NULL) {
+            for (uint32_t j = 0; j < current_blocks->size; j++) {
+                scratch->bits[buffer ^ 1][current_blocks->contents[j]] = 0;
+            }
+        }
+        current = next;
+        current_blocks = next_blocks;
+        any_blocks = next_blocks;
+        alive = next_blocks->size > 0;
+    }
+
+    // Collect the commands with accepting states active, in order, and
+    // clear the bitset for the next phrase.
+    if (current_blocks != NULL) {
+        qsort(current_blocks->contents, current_blocks->size, sizeof(uint32_t), compare_blocks);
+        for (uint32_t j = 0; j < current_blocks->size; j++) {
+            uint32_t block = current_blocks->contents[j];
+            for (uint64_t bits = alive ? current[block] & matcher->accepting[block] : 0; bits != 0; bits &= bits - 1) {
+                uint32_t command = command_of_state(matcher, block * 64 + lowest_bit(bits));
+                if (scratch->matches.size == 0 || array_back(&scratch->matches)->command != command) {
+                    TalonPhraseMatch match = {command, 0, 0};
+                    array_push(&scratch->matches, match);
+                }
+            }
+            ((uint64_t *)current)[block] = 0;
+        }
+    }
+    for (uint32_t i = 0; i < scratch->matches.size; i++) {
+        find_bindings(matcher, phrase, length, &scratch->matches.contents[i], scratch);
+    }
+
+    matches->matches = scratch->matches.contents;
+    matches->match_count = scratch->matches.size;
+    matches->bindings = scratch->bindings.contents;
+    matches->binding_count = scratch->bindings.size;
+    return scratch->matches.size;
+}
@@ -0,0 +1,677 @@
+#include "talon.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree_sitter/array.h"
+
+// The most states subset construction may create before a rule is kept
+// nondeterministic instead.
+#define DETERMINIZE_LIMIT 4096
+
+// The kind of the epsilon edges of an NFA, after the public edge kinds.
+#define EDGE_EPSILON 3
+
+#define NO_STATE UINT32_MAX
+
+static uint32_t hash_bytes(const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// An open addressing hash table of ids, where slots hold id + 1 and 0 is
+// empty. Keys are compared by the caller.
+typedef struct {
+    uint32_t *slots;
+    uint32_t capacity;
+} Slots;
+
+static void slots_init(Slots *slots) {
+    slots->capacity = 64;
+    slots->slots = ts_calloc(slots->capacity, sizeof(uint32_t));
+}
+
+// Double the table once it is half full, given the hash of each id.
+static void slots_grow(Slots *slots, uint32_t count, uint32_t (*hash)(const void *, uint32_t), const void *keys) {
+    if (count * 2 <= slots->capacity) {
+        return;
+    }
+    ts_free(slots->slots);
+    slots->capacity *= 2;
+    slots->slots = ts_calloc(slots->capacity, sizeof(uint32_t));
+    uint32_t mask = slots->capacity - 1;
+    for (uint32_t id = 0; id < count; id++) {
+        uint32_t i = hash(keys, id) & mask;
+        while (slots->slots[i] != 0) {
+            i = (i + 1) & mask;
+        }
+        slots->slots[i] = id + 1;
+    }
+}
+
+// Words
+
+struct TalonWords {
+    Array(char) bytes;
+    // One offset per word into bytes, and one past the last.
+    Array(uint32_t) offsets;
+    Slots slots;
+};
+
+static uint32_t word_hash(const void *keys, uint32_t id) {
+    const TalonWords *words = keys;
+    uint32_t start = words->offsets.contents[id];
+    return hash_bytes(words->bytes.contents + start, words->offsets.contents[id + 1] - start);
+}
+
+static uint32_t *word_slot(const TalonWords *words, const char *string, uint32_t length) {
+    uint32_t mask = words->slots.capacity - 1;
+    for (uint32_t i = hash_bytes(string, length) & mask;; i = (i + 1) & mask) {
+        uint32_t *slot = &words->slots.slots[i];
+        if (*slot == 0) {
+            return slot;
+        }
+        uint32_t start = words->offsets.contents[*slot - 1], end = words->offsets.contents[*slot];
+        if (end - start == length && (length == 0 || memcmp(words->bytes.contents + start, string, length) == 0)) {
+            return slot;
+        }
+    }
+}
+
+TalonWords *talon_words_new(void) {
+    TalonWords *words = ts_calloc(1, sizeof(TalonWords));
+    array_push(&words->offsets, 0);
+    slots_init(&words->slots);
+    return words;
+}
+
+uint32_t talon_words_intern(TalonWords *words, const char *string, uint32_t length) {
+    uint32_t *slot = word_slot(words, string, length);
+    if (*slot != 0) {
+        return *slot - 1;
+    }
+    uint32_t id = words->offsets.size - 1;
+    array_extend(&words->bytes, length, string);
+    array_push(&words->offsets, words->bytes.size);
+    *slot = id + 1;
+    slots_grow(&words->slots, id + 1, word_hash, words);
+    return id;
+}
+
+uint32_t talon_words_find(const TalonWords *words, const char *string, uint32_t length) {
+    uint32_t id = *word_slot(words, string, length);
+    return id == 0 ? TALON_NO_WORD : id - 1;
+}
+
+const char *talon_words_string(const TalonWords *words, uint32_t id, uint32_t *length) {
+    uint32_t start = words->offsets.contents[id];
+    *length = words->offsets.contents[id + 1] - start;
+    return words->bytes.contents + start;
+}
+
+uint32_t talon_words_count(const TalonWords *words) {
+    return words->offsets.size - 1;
+}
+
+void talon_words_delete(TalonWords *words) {
+    array_delete(&words->bytes);
+    array_delete(&words->offsets);
+    ts_free(words->slots.slots);
+    ts_free(words);
+}
+
+// Sets of spans of integers, each with an id in the order they were added,
+// such as the NFA states of a DFA state, or the signature of a state
+// during minimization.
+
+typedef struct {
+    Array(uint32_t) items;
+    // One offset per span into items, and one past the last.
+    Array(uint32_t) offsets;
+    Slots slots;
+} Spans;
+
+static void spans_init(Spans *spans) {
+    array_init(&spans->items);
+    array_init(&spans->offsets);
+    array_push(&spans->offsets, 0);
+    slots_init(&spans->slots);
+}
+
+static void spans_delete(Spans *spans) {
+    array_delete(&spans->items);
+    array_delete(&spans->offsets);
+    ts_free(spans->slots.slots);
+}
+
+static uint32_t spans_count(const Spans *spans) {
+    return spans->offsets.size - 1;
+}
+
+static uint32_t span_hash(const void *keys, uint32_t id) {
+    const Spans *spans = keys;
+    uint32_t start = spans->offsets.contents[id];
+    return hash_bytes(spans->items.contents + start, (spans->offsets.contents[id + 1] - start) * sizeof(uint32_t));
+}
+
+// Return the id of a span, adding it if it is new.
+static uint32_t spans_add(Spans *spans, const uint32_t *items, uint32_t count) {
+    uint32_t mask = spans->slots.capacity - 1;
+    uint32_t *slot;
+    for (uint32_t i = hash_bytes(items, count * sizeof(uint32_t)) & mask;; i = (i + 1) & mask) {
+        slot = &spans->slots.slots[i];
+        if (*slot == 0) {
+            break;
+        }
+        uint32_t start = spans->offsets.contents[*slot - 1], end = spans->offsets.contents[*slot];
+        if (end - start == count &&
+            (count == 0 || memcmp(spans->items.contents + start, items, count * sizeof(uint32_t)) == 0)) {
+            return *slot - 1;
+        }
+    }
+    uint32_t id = spans_count(spans);
+    array_extend(&spans->items, count, items);
+    array_push(&spans->offsets, spans->items.size);
+    *slot = id + 1;
+    slots_grow(&spans->slots, id + 1, span_hash, spans);
+    return id;
+}
+
+// Compiling rules to an NFA, by Thompson's construction
+
+typedef struct {
+    TSSymbol rule;
+    TSSymbol choice;
+    TSSymbol seq;
+    TSSymbol word;
+    TSSymbol list;
+    TSSymbol capture;
+    TSSymbol optional;
+    TSSymbol repeat;
+    TSSymbol repeat1;
+    TSSymbol parenthesized_rule;
+    TSSymbol start_anchor;
+    TSSymbol end_anchor;
+    TSSymbol bar;
+    TSFieldId list_name;
+    TSFieldId capture_name;
+} Ids;
+
+static TSSymbol symbol(const TSLanguage *language, const char *name, bool named) {
+    return ts_language_symbol_for_name(language, name, (uint32_t)strlen(name), named);
+}
+
+static TSFieldId field(const TSLanguage *language, const char *name) {
+    return ts_language_field_id_for_name(language, name, (uint32_t)strlen(name));
+}
+
+static void Ids_init(Ids *ids, const TSLanguage *language) {
+    ids->rule = symbol(language, "rule", true);
+    ids->choice = symbol(language, "choice", true);
+    ids->seq = symbol(language, "seq", true);
+    ids->word = symbol(language, "word", true);
+    ids->list = symbol(language, "list", true);
+    ids->capture = symbol(language, "capture", true);
+    ids->optional = symbol(language, "optional", true);
+    ids->repeat = symbol(language, "repeat", true);
+    ids->repeat1 = symbol(language, "repeat1", true);
+    ids->parenthesized_rule = symbol(language, "parenthesized_rule", true);
+    ids->start_anchor = symbol(language, "start_anchor", true);
+    ids->end_anchor = symbol(language, "end_anchor", true);
+    ids->bar = symbol(language, "|", false);
+    ids->list_name = field(language, "list_name");
+    ids->capture_name = field(language, "capture_name");
+}
+
+typedef struct {
+    uint32_t from;
+    uint32_t kind;
+    uint32_t id;
+    uint32_t to;
+} NfaEdge;
+
+// A piece of the NFA with one entry and one exit state. Empty fragments,
+// from anchors, have NO_STATE for both.
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+} Fragment;
+
+static const Fragment EMPTY = {NO_STATE, NO_STATE};
+
+typedef struct {
+    Ids ids;
+    TalonWords *words;
+    const char *source;
+    uint32_t state_count;
+    Array(NfaEdge) edges;
+    bool start_anchor;
+    bool end_anchor;
+    bool failed;
+} Compiler;
+
+static uint32_t add_state(Compiler *self) {
+    return self->state_count++;
+}
+
+static void add_edge(Compiler *self, uint32_t from, uint32_t kind, uint32_t id, uint32_t to) {
+    NfaEdge edge = {from, kind, id, to};
+    array_push(&self->edges, edge);
+}
+
+static Fragment add_fragment(Compiler *self) {
+    Fragment fragment = {add_state(self), add_state(self)};
+    return fragment;
+}
+
+// Give an empty fragment a state, so that it can be connected.
+static Fragment materialize(Compiler *self, Fragment fragment) {
+    if (fragment.start == NO_STATE) {
+        fragment.start = fragment.end = add_state(self);
+    }
+    return fragment;
+}
+
+static Fragment concatenate(Compiler *self, Fragment first, Fragment second) {
+    if (first.start == NO_STATE) {
+        return second;
+    }
+    if (second.start == NO_STATE) {
+        return first;
+    }
+    add_edge(self, first.end, EDGE_EPSILON, 0, second.start);
+    first.end = second.end;
+    return first;
+}
+
+// Add an alternative to a choice, creating the choice if it is empty.
+static Fragment alternate(Compiler *self, Fragment choice, Fragment alternative) {
+    if (choice.start == NO_STATE) {
+        choice = add_fragment(self);
+    }
+    alternative = materialize(self, alternative);
+    add_edge(self, choice.start, EDGE_EPSILON, 0, alternative.start);
+    add_edge(self, alternative.end, EDGE_EPSILON, 0, choice.end);
+    return choice;
+}
+
+static Fragment compile_node(Compiler *self, TSTreeCursor *cursor);
+
+// Compile the named children of the cursor's node in sequence, or as
+// alternatives where they are separated by "|".
+static Fragment compile_children(Compiler *self, TSTreeCursor *cursor) {
+    Fragment sequence = EMPTY, choice = EMPTY;
+    if (ts_tree_cursor_goto_first_child(cursor)) {
+        do {
+            TSNode node = ts_tree_cursor_current_node(cursor);
+            if (ts_node_is_named(node)) {
+                sequence = concatenate(self, sequence, compile_node(self, cursor));
+            } else if (ts_node_symbol(node) == self->ids.bar) {
+                choice = alternate(self, choice, sequence);
+                sequence = EMPTY;
+            }
+        } while (ts_tree_cursor_goto_next_sibling(cursor));
+        ts_tree_cursor_goto_parent(cursor);
+    }
+    return choice.start != NO_STATE ? alternate(self, choice, sequence) : sequence;
+}
+
+static Fragment compile_label(Compiler *self, uint32_t kind, TSNode node) {
+    if (ts_node_is_null(node)) {
+        self->failed = true;
+        return EMPTY;
+    }
+    uint32_t start = ts_node_start_byte(node);
+    uint32_t id = talon_words_intern(self->words, self->source + start, ts_node_end_byte(node) - start);
+    Fragment fragment = add_fragment(self);
+    add_edge(self, fragment.start, kind, id, fragment.end);
+    return fragment;
+}
+
+static Fragment compile_node(Compiler *self, TSTreeCursor *cursor) {
+    TSNode node = ts_tree_cursor_current_node(cursor);
+    TSSymbol symbol = ts_node_symbol(node);
+    const Ids *ids = &self->ids;
+    if (symbol == ids->word) {
+        return compile_label(self, TALON_EDGE_WORD, node);
+    }
+    if (symbol == ids->list) {
+        return compile_label(self, TALON_EDGE_LIST, ts_node_child_by_field_id(node, ids->list_name));
+    }
+    if (symbol == ids->capture) {
+        return compile_label(self, TALON_EDGE_CAPTURE, ts_node_child_by_field_id(node, ids->capture_name));
+    }
+    if (symbol == ids->rule || symbol == ids->choice || symbol == ids->seq || symbol == ids->parenthesized_rule) {
+        return compile_children(self, cursor);
+    }
+    if (symbol == ids->start_anchor) {
+        self->start_anchor = true;
+        return EMPTY;
+    }
+    if (symbol == ids->end_anchor) {
+        self->end_anchor = true;
+        return EMPTY;
+    }
+    if (symbol == ids->optional || symbol == ids->repeat || symbol == ids->repeat1) {
+        Fragment inner = materialize(self, compile_children(self, cursor));
+        Fragment outer = add_fragment(self);
+        add_edge(self, outer.start, EDGE_EPSILON, 0, inner.start);
+        add_edge(self, inner.end, EDGE_EPSILON, 0, outer.end);
+        if (symbol != ids->repeat1) {
+            add_edge(self, outer.start, EDGE_EPSILON, 0, outer.end);
+        }
+        if (symbol != ids->optional) {
+            add_edge(self, inner.end, EDGE_EPSILON, 0, inner.start);
+        }
+        return outer;
+    }
+    if (ts_node_is_extra(node)) {
+        return EMPTY;
+    }
+    self->failed = true;
+    return EMPTY;
+}
+
+// Converting the NFA to an automaton without epsilon edges
+
+typedef Array(uint32_t) States;
+
+// The NFA with its edges grouped by source state, and scratch space for
+// epsilon closures.
+typedef struct {
+    uint32_t state_count;
+    uint32_t final;
+    uint32_t *offsets;
+    NfaEdge *edges;
+    uint32_t *marks;
+    uint32_t generation;
+    States stack;
+} Nfa;
+
+static int compare_edges(const void *a, const void *b) {
+    const NfaEdge *x = a, *y = b;
+    if (x->kind != y->kind) {
+        return x->kind < y->kind ? -1 : 1;
+    }
+    if (x->id != y->id) {
+        return x->id < y->id ? -1 : 1;
+    }
+    return (x->to > y->to) - (x->to < y->to);
+}
+
+static int compare_uint32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void Nfa_init(Nfa *nfa, Compiler *compiler, uint32_t final) {
+    nfa->state_count = compiler->state_count;
+    nfa->final = final;
+    nfa->offsets = ts_calloc(nfa->state_count + 1, sizeof(uint32_t));
+    nfa->edges = ts_malloc((compiler->edges.size + 1) * sizeof(NfaEdge));
+    nfa->marks = ts_calloc(nfa->state_count, sizeof(uint32_t));
+    nfa->generation = 0;
+    array_init(&nfa->stack);
+
+    // A counting sort of the edges by source state.
+    for (uint32_t i = 0; i < compiler->edges.size; i++) {
+        nfa->offsets[compiler->edges.contents[i].from + 1]++;
+    }
+    for (uint32_t i = 0; i < nfa->state_count; i++) {
+        nfa->offsets[i + 1] += nfa->offsets[i];
+    }
+    uint32_t *next = ts_malloc((nfa->state_count + 1) * sizeof(uint32_t));
+    memcpy(next, nfa->offsets, (nfa->state_count + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < compiler->edges.size; i++) {
+        nfa->edges[next[compiler->edges.contents[i].from]++] = compiler->edges.contents[i];
+    }
+    ts_free(next);
+}
+
+static void Nfa_delete(Nfa *nfa) {
+    ts_free(nfa->offsets);
+    ts_free(nfa->edges);
+    ts_free(nfa->marks);
+    array_delete(&nfa->stack);
+}
+
+// Replace states with the sorted set of states reachable from them by
+// epsilon edges.
+static void Nfa_close(Nfa *nfa, States *states) {
+    uint32_t generation = ++nfa->generation;
+    array_clear(&nfa->stack);
+    for (uint32_t i = 0; i < states->size; i++) {
+        if (nfa->marks[states->contents[i]] != generation) {
+            nfa->marks[states->contents[i]] = generation;
+            array_push(&nfa->stack, states->contents[i]);
+        }
+    }
+    array_clear(states);
+    while (nfa->stack.size > 0) {
+        uint32_t state = array_pop(&nfa->stack);
+        array_push(states, state);
+        for (uint32_t i = nfa->offsets[state]; i < nfa->offsets[state + 1]; i++) {
+            const NfaEdge *edge = &nfa->edges[i];
+            if (edge->kind == EDGE_EPSILON && nfa->marks[edge->to] != generation) {
+                nfa->marks[edge->to] = generation;
+                array_push(&nfa->stack, edge->to);
+            }
+        }
+    }
+    qsort(states->contents, states->size, sizeof(uint32_t), compare_uint32);
+}
+
+// An automaton as it is built, before it is copied into a TalonAutomaton.
+typedef struct {
+    Array(uint32_t) edge_offsets;
+    Array(TalonEdge) edges;
+    Array(bool) accepting;
+} Builder;
+
+static void Builder_init(Builder *builder) {
+    array_init(&builder->edge_offsets);
+    array_init(&builder->edges);
+    array_init(&builder->accepting);
+}
+
+static void Builder_delete(Builder *builder) {
+    array_delete(&builder->edge_offsets);
+    array_delete(&builder->edges);
+    array_delete(&builder->accepting);
+}
+
+// Build an automaton whose states are epsilon closures of NFA states. With
+// merge, this is subset construction: the edges of a state with the same
+// label lead to the closure of all their targets, and the result is a DFA.
+// Without merge, each edge leads to the closure of its own target, which
+// removes epsilon edges but keeps the NFA's choices. Returns false if there
+// would be more than limit states.
+static bool build_closures(Nfa *nfa, uint32_t start, bool merge, uint32_t limit, Builder *builder) {
+    Spans sets;
+    spans_init(&sets);
+    States set = array_new();
+    Array(NfaEdge) moves = array_new();
+    array_push(&set, start);
+    Nfa_close(nfa, &set);
+    spans_add(&sets, set.contents, set.size);
+
+    bool within_limit = true;
+    for (uint32_t state = 0; state < spans_count(&sets) && within_limit; state++) {
+        // Collect the labelled edges out of the state's closure.
+        array_clear(&moves);
+        bool accepting = false;
+        for (uint32_t i = sets.offsets.contents[state]; i < sets.offsets.contents[state + 1]; i++) {
+            uint32_t member = sets.items.contents[i];
+            accepting |= member == nfa->final;
+            for (uint32_t j = nfa->offsets[member]; j < nfa->offsets[member + 1]; j++) {
+                if (nfa->edges[j].kind != EDGE_EPSILON) {
+                    array_push(&moves, nfa->edges[j]);
+                }
+            }
+        }
+        qsort(moves.contents, moves.size, sizeof(NfaEdge), compare_edges);
+        array_push(&builder->edge_offsets, builder->edges.size);
+        array_push(&builder->accepting, accepting);
+
+        for (uint32_t i = 0; i < moves.size;) {
+            const NfaEdge *move = &moves.contents[i];
+            array_clear(&set);
+            uint32_t j = i;
+            do {
+                array_push(&set, moves.contents[j].to);
+                j++;
+            } while (merge && j < moves.size && moves.contents[j].kind == move->kind &&
+                     moves.contents[j].id == move->id);
+            Nfa_close(nfa, &set);
+            // Without merging, edges may repeat, which minimization removes.
+            TalonEdge edge = {move->kind, move->id, spans_add(&sets, set.contents, set.size)};
+            array_push(&builder->edges, edge);
+            i = j;
+        }
+        within_limit = spans_count(&sets) <= limit;
+    }
+    array_push(&builder->edge_offsets, builder->edges.size);
+
+    spans_delete(&sets);
+    array_delete(&set);
+    array_delete(&moves);
+    return within_limit;
+}
+
+// Minimization
+
+static int compare_talon_edges(const void *a, const void *b) {
+    const TalonEdge *x = a, *y = b;
+    if (x->kind != y->kind) {
+        return x->kind < y->kind ? -1 : 1;
+    }
+    if (x->id != y->id) {
+        return x->id < y->id ? -1 : 1;
+    }
+    return (x->target > y->target) - (x->target < y->target);
+}
+
+// Merge states with the same behaviour by Moore's partition refinement:
+// states start in classes by whether they accept, and classes are split
+// by the labels and target classes of their edges until no class splits.
+// For a DFA, this gives the minimal DFA. For an NFA, it merges bisimilar
+// states, which keeps the language but may not give the fewest states.
+static void minimize(const Builder *input, Builder *output) {
+    uint32_t state_count = input->accepting.size;
+    uint32_t *classes = ts_malloc((state_count + 1) * sizeof(uint32_t));
+    uint32_t class_count = 0;
+    for (uint32_t state = 0; state < state_count; state++) {
+        classes[state] = input->accepting.contents[state];
+    }
+
+    // A signature is the state's class followed by its edges as sorted
+    // (kind, id, target class) triples.
+    Array(TalonEdge) edges = array_new();
+    Spans signatures;
+    for (;;) {
+        spans_init(&signatures);
+        uint32_t *next = ts_malloc((state_count + 1) * sizeof(uint32_t));
+        for (uint32_t state = 0; state < state_count; state++) {
+            array_clear(&edges);
+            TalonEdge head = {classes[state], 0, 0};
+            array_push(&edges, head);
+            for (uint32_t i = input->edge_offsets.contents[state]; i < input->edge_offsets.contents[state + 1]; i++) {
+                TalonEdge edge = input->edges.contents[i];
+                edge.target = classes[edge.target];
+                array_push(&edges, edge);
+            }
+            qsort(edges.contents + 1, edges.size - 1, sizeof(TalonEdge), compare_talon_edges);
+            uint32_t size = edges.size > 1 ? 2 : 1;
+            for (uint32_t i = 2; i < edges.size; i++) {
+                if (compare_talon_edges(&edges.contents[i], &edges.contents[size - 1]) != 0) {
+                    edges.contents[size++] = edges.contents[i];
+                }
+            }
+            edges.size = size;
+            next[state] = spans_add(&signatures, (const uint32_t *)edges.contents,
+                                    edges.size * (uint32_t)(sizeof(TalonEdge) / sizeof(uint32_t)));
+        }
+        ts_free(classes);
+        classes = next;
+        if (spans_count(&signatures) == class_count) {
+            break;
+        }
+        class_count = spans_count(&signatures);
+        spans_delete(&signatures);
+    }
+
+    // Classes are numbered in order of their first state, so the start
+    // state stays 0. Each class takes the edges of its signature.
+    for (uint32_t class = 0; class < class_count; class++) {
+        uint32_t start = signatures.offsets.contents[class], end = signatures.offsets.contents[class + 1];
+        const TalonEdge *signature = (const TalonEdge *)(signatures.items.contents + start);
+        uint32_t edge_count = (end - start) / (uint32_t)(sizeof(TalonEdge) / sizeof(uint32_t));
+        array_push(&output->edge_offsets, output->edges.size);
+        array_extend(&output->edges, edge_count - 1, signature + 1);
+    }
+    array_push(&output->edge_offsets, output->edges.size);
+    array_grow_by(&output->accepting, class_count);
+    for (uint32_t state = 0; state < state_count; state++) {
+        output->accepting.contents[classes[state]] = input->accepting.contents[state];
+    }
+
+    spans_delete(&signatures);
+    array_delete(&edges);
+    ts_free(classes);
+}
+
+TalonAutomaton *talon_automaton_compile(TalonWords *words, TSNode rule, const char *source) {
+    if (ts_node_has_error(rule)) {
+        return NULL;
+    }
+    Compiler compiler = {.words = words, .source = source};
+    array_init(&compiler.edges);
+    Ids_init(&compiler.ids, ts_tree_language(rule.tree));
+
+    TSTreeCursor cursor = ts_tree_cursor_new(rule);
+    Fragment fragment = materialize(&compiler, compile_node(&compiler, &cursor));
+    ts_tree_cursor_delete(&cursor);
+    if (compiler.failed) {
+        array_delete(&compiler.edges);
+        return NULL;
+    }
+
+    Nfa nfa;
+    Nfa_init(&nfa, &compiler, fragment.end);
+    Builder closures, minimal;
+    Builder_init(&closures);
+    Builder_init(&minimal);
+    bool deterministic = build_closures(&nfa, fragment.start, true, DETERMINIZE_LIMIT, &closures);
+    if (!deterministic) {
+        Builder_delete(&closures);
+        Builder_init(&closures);
+        build_closures(&nfa, fragment.start, false, UINT32_MAX, &closures);
+    }
+    minimize(&closures, &minimal);
+
+    TalonAutomaton *automaton = ts_calloc(1, sizeof(TalonAutomaton));
+    automaton->state_count = minimal.accepting.size;
+    automaton->edge_offsets = minimal.edge_offsets.contents;
+    automaton->edges = minimal.edges.contents;
+    automaton->accepting = minimal.accepting.contents;
+    automaton->start_anchor = compiler.start_anchor;
+    automaton->end_anchor = compiler.end_anchor;
+    automaton->deterministic = deterministic;
+    automaton->nfa_state_count = compiler.state_count;
+
+    Nfa_delete(&nfa);
+    Builder_delete(&closures);
+    array_delete(&compiler.edges);
+    return automaton;
+}
+
+void talon_automaton_delete(TalonAutomaton *automaton) {
+    ts_free(automaton->edge_offsets);
+    ts_free(automaton->edges);
+    ts_free(automaton->accepting);
+    ts_free(automaton);
+}
@@ -0,0 +1,381 @@
+#include "buffer.h"
+
+#include "tree_sitter/array.h"
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+// Where canonical S-expression text goes: into a buffer, or into a rolling
+// FNV-1a hash of the text that would have been written.
+typedef struct {
+    TalonBuffer *buffer;
+    uint64_t hash;
+    // Whether the next token needs a separating space.
+    bool separate;
+} Sink;
+
+static void sink_write(Sink *sink, const char *data, size_t size) {
+    if (sink->buffer != NULL) {
+        buffer_write(sink->buffer, data, size);
+        return;
+    }
+    uint64_t hash = sink->hash;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * FNV_PRIME;
+    }
+    sink->hash = hash;
+}
+
+// Tokens are written as they are by ts_node_string, with a single space
+// between them except after an opening parenthesis.
+static void sink_open(Sink *sink) {
+    if (sink->separate) {
+        sink_write(sink, " ", 1);
+    }
+    sink_write(sink, "(", 1);
+    sink->separate = false;
+}
+
+static void sink_close(Sink *sink) {
+    sink_write(sink, ")", 1);
+    sink->separate = true;
+}
+
+static void sink_atom(Sink *sink, const char *atom, size_t length) {
+    if (sink->separate) {
+        sink_write(sink, " ", 1);
+    }
+    sink_write(sink, atom, length);
+    sink->separate = true;
+}
+
+static void sink_field(Sink *sink, const char *field, size_t length) {
+    sink_atom(sink, field, length);
+    sink_write(sink, ":", 1);
+}
+
+// Write the character an ERROR leaf starts with as ts_node_string does.
+static void sink_unexpected(Sink *sink, const char *text, uint32_t length) {
+    int32_t c = -1;
+    const unsigned char *s = (const unsigned char *)text;
+    if (length > 0 && s[0] < 0x80) {
+        c = s[0];
+    } else if (length > 1 && (s[0] & 0xe0) == 0xc0) {
+        c = (s[0] & 0x1f) << 6 | (s[1] & 0x3f);
+    } else if (length > 2 && (s[0] & 0xf0) == 0xe0) {
+        c = (s[0] & 0x0f) << 12 | (s[1] & 0x3f) << 6 | (s[2] & 0x3f);
+    } else if (length > 3 && (s[0] & 0xf8) == 0xf0) {
+        c = (s[0] & 0x07) << 18 | (s[1] & 0x3f) << 12 | (s[2] & 0x3f) << 6 | (s[3] & 0x3f);
+    }
+
+    char atom[16];
+    int atom_length;
+    switch (c) {
+        case -1: atom_length = snprintf(atom, sizeof(atom), "INVALID"); break;
+        case '\0': atom_length = snprintf(atom, sizeof(atom), "'\\0'"); break;
+        case '\n': atom_length = snprintf(atom, sizeof(atom), "'\\n'"); break;
+        case '\t': atom_length = snprintf(atom, sizeof(atom), "'\\t'"); break;
+        case '\r': atom_length = snprintf(atom, sizeof(atom), "'\\r'"); break;
+        default:
+            if (c > 0x20 && c < 0x7f) {
+                atom_length = snprintf(atom, sizeof(atom), "'%c'", (char)c);
+            } else {
+                atom_length = snprintf(atom, sizeof(atom), "%d", (int)c);
+            }
+    }
+    sink_atom(sink, "UNEXPECTED", 10);
+    sink_atom(sink, atom, (size_t)atom_length);
+}
+
+// Write the opening of a visible node, and return whether to visit its
+// children.
+static bool sink_node(Sink *sink, const TSTreeCursor *cursor, TSNode node, const char *source, uint32_t flags) {
+    bool named = ts_node_is_named(node);
+    bool missing = ts_node_is_missing(node);
+    if (!named && !missing) {
+        return false;
+    }
+    if (flags & TALON_SEXP_FIELDS) {
+        const char *field = ts_tree_cursor_current_field_name(cursor);
+        if (field != NULL) {
+            sink_field(sink, field, strlen(field));
+        }
+    }
+
+    const char *type = ts_node_type(node);
+    sink_open(sink);
+    if (missing) {
+        sink_atom(sink, "MISSING", 7);
+        if (named) {
+            sink_atom(sink, type, strlen(type));
+        } else {
+            sink_atom(sink, "\"", 1);
+            sink->separate = false;
+            sink_write(sink, type, strlen(type));
+            sink_write(sink, "\"", 1);
+        }
+        return false;
+    }
+    uint32_t start = ts_node_start_byte(node), end = ts_node_end_byte(node);
+    if (ts_node_is_error(node) && ts_node_child_count(node) == 0 && end > start && source != NULL) {
+        sink_unexpected(sink, source + start, end - start);
+        return false;
+    }
+    sink_atom(sink, type, strlen(type));
+    return true;
+}
+
+static void sink_tree(Sink *sink, TSNode root, const char *source, uint32_t flags) {
+    TSTreeCursor cursor = ts_tree_cursor_new(root);
+    bool open = sink_node(sink, &cursor, root, source, flags);
+    for (;;) {
+        if (!open || !ts_tree_cursor_goto_first_child(&cursor)) {
+            if (ts_node_is_named(ts_tree_cursor_current_node(&cursor)) ||
+                ts_node_is_missing(ts_tree_cursor_current_node(&cursor))) {
+                sink_close(sink);
+            }
+            while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+                if (!ts_tree_cursor_goto_parent(&cursor)) {
+                    goto done;
+                }
+                sink_close(sink);
+            }
+        }
+        open = sink_node(sink, &cursor, ts_tree_cursor_current_node(&cursor), source, flags);
+    }
+done:
+    ts_tree_cursor_delete(&cursor);
+}
+
+void talon_write_sexp(TalonBuffer *buffer, TSNode node, const char *source, uint32_t flags) {
+    Sink sink = {buffer, 0, false};
+    sink_tree(&sink, node, source, flags);
+}
+
+uint64_t talon_sexp_hash(TSNode node, const char *source, uint32_t flags) {
+    Sink sink = {NULL, FNV_OFFSET_BASIS, false};
+    sink_tree(&sink, node, source, flags);
+    return sink.hash;
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+// Re-emit expected S-expression text as canonical tokens, ignoring layout.
+// Quoted atoms, such as the "(" in (MISSING "("), may contain parentheses.
+static bool sink_text(Sink *sink, const char *text, size_t length) {
+    bool has_fields = false;
+    size_t i = 0;
+    while (i < length) {
+        char c = text[i];
+        if (is_space(c)) {
+            i++;
+        } else if (c == '(') {
+            sink_open(sink);
+            i++;
+        } else if (c == ')') {
+            sink_close(sink);
+            i++;
+        } else {
+            size_t start = i;
+            if (c == '"' || c == '\'') {
+                for (i++; i < length; i++) {
+                    if (text[i] == '\\') {
+                        i++;
+                    } else if (text[i] == c && (i + 1 == length || is_space(text[i + 1]) || text[i + 1] == ')')) {
+                        i++;
+                        break;
+                    }
+                }
+            } else {
+                while (i < length && !is_space(text[i]) && text[i] != '(' && text[i] != ')') {
+                    i++;
+                }
+            }
+            if (i > length) {
+                i = length;
+            }
+            if (text[i - 1] == ':' && i - start > 1 && c != '"' && c != '\'') {
+                sink_field(sink, text + start, i - start - 1);
+                has_fields = true;
+            } else {
+                sink_atom(sink, text + start, i - start);
+            }
+        }
+    }
+    return has_fields;
+}
+
+uint64_t talon_sexp_hash_text(const char *text, size_t length, bool *has_fields) {
+    Sink sink = {NULL, FNV_OFFSET_BASIS, false};
+    bool fields = sink_text(&sink, text, length);
+    if (has_fields != NULL) {
+        *has_fields = fields;
+    }
+    return sink.hash;
+}
+
+void talon_sexp_normalize(TalonBuffer *buffer, const char *text, size_t length) {
+    Sink sink = {buffer, 0, false};
+    sink_text(&sink, text, length);
+}
+
+// Whether a field name, such as "left:", starts at text.
+static bool is_field(const char *text, size_t length) {
+    size_t i = 0;
+    while (i < length && !is_space(text[i]) && text[i] != '(' && text[i] != ')') {
+        i++;
+    }
+    return i > 1 && text[i - 1] == ':';
+}
+
+// Lay out canonical S-expression text with one node per line, indented by
+// depth as in the test corpus. Fields stay on the line of their node.
+static void layout(TalonBuffer *buffer, const char *text, size_t length) {
+    uint32_t depth = 0;
+    for (size_t i = 0; i < length; i++) {
+        char c = text[i];
+        bool breaks = c == ' ' && i + 1 < length && text[i - 1] != ':' &&
+                      (text[i + 1] == '(' || is_field(text + i + 1, length - i - 1));
+        if (breaks) {
+            buffer_putc(buffer, '\n');
+            for (uint32_t j = 0; j < depth; j++) {
+                buffer_write_literal(buffer, "  ");
+            }
+            continue;
+        }
+        if (c == '(') {
+            depth++;
+        } else if (c == ')') {
+            depth--;
+        } else if ((c == '"' || c == '\'') && text[i - 1] == ' ') {
+            // Copy quoted atoms whole, since they may contain parentheses.
+            size_t end = i + 1;
+            while (end < length && !(text[end] == c && (end + 1 == length || text[end + 1] == ')'))) {
+                end++;
+            }
+            buffer_write(buffer, text + i, end - i);
+            i = end - 1;
+            continue;
+        }
+        buffer_putc(buffer, c);
+    }
+    buffer_putc(buffer, '\n');
+}
+
+void talon_sexp_format(TalonBuffer *buffer, const char *text, size_t length) {
+    TalonBuffer canonical;
+    talon_buffer_init(&canonical, -1);
+    talon_sexp_normalize(&canonical, text, length);
+    layout(buffer, canonical.data, canonical.size);
+    talon_buffer_delete(&canonical);
+}
+
+typedef struct {
+    const char *start;
+    uint32_t length;
+} Line;
+
+typedef Array(Line) Lines;
+
+static void split_lines(Lines *lines, const char *text, size_t length) {
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] == '\n') {
+            Line line = {text + start, (uint32_t)(i - start)};
+            array_push(lines, line);
+            start = i + 1;
+        }
+    }
+}
+
+static bool lines_equal(Line a, Line b) {
+    return a.length == b.length && memcmp(a.start, b.start, a.length) == 0;
+}
+
+static void write_line(TalonBuffer *out, char prefix, Line line) {
+    buffer_putc(out, prefix);
+    buffer_putc(out, ' ');
+    buffer_write(out, line.start, line.length);
+    buffer_putc(out, '\n');
+}
+
+// Inputs with more lines than this are not aligned, since the table of
+// common subsequence lengths grows with the product of their lengths.
+#define MAX_DIFF_LINES 4096
+
+void talon_sexp_diff(TalonBuffer *out, const char *expected, size_t expected_length, const char *actual,
+                     size_t actual_length) {
+    TalonBuffer canonical, a_text, b_text;
+    talon_buffer_init(&canonical, -1);
+    talon_buffer_init(&a_text, -1);
+    talon_buffer_init(&b_text, -1);
+    talon_sexp_normalize(&canonical, expected, expected_length);
+    layout(&a_text, canonical.data, canonical.size);
+    canonical.size = 0;
+    talon_sexp_normalize(&canonical, actual, actual_length);
+    layout(&b_text, canonical.data, canonical.size);
+
+    Lines a = array_new(), b = array_new();
+    split_lines(&a, a_text.data, a_text.size);
+    split_lines(&b, b_text.data, b_text.size);
+
+    // Trim the common prefix and suffix, then align the rest by their
+    // longest common subsequence.
+    uint32_t prefix = 0, suffix = 0;
+    while (prefix < a.size && prefix < b.size && lines_equal(a.contents[prefix], b.contents[prefix])) {
+        prefix++;
+    }
+    while (suffix < a.size - prefix && suffix < b.size - prefix &&
+           lines_equal(a.contents[a.size - 1 - suffix], b.contents[b.size - 1 - suffix])) {
+        suffix++;
+    }
+    for (uint32_t i = 0; i < prefix; i++) {
+        write_line(out, ' ', a.contents[i]);
+    }
+    uint32_t n = a.size - prefix - suffix, m = b.size - prefix - suffix;
+    const Line *x = a.contents + prefix, *y = b.contents + prefix;
+    if (n > MAX_DIFF_LINES || m > MAX_DIFF_LINES) {
+        for (uint32_t i = 0; i < n; i++) {
+            write_line(out, '-', x[i]);
+        }
+        for (uint32_t j = 0; j < m; j++) {
+            write_line(out, '+', y[j]);
+        }
+    } else {
+        // lengths[i * (m + 1) + j] is the length of the longest common
+        // subsequence of x[i..] and y[j..].
+        uint32_t *lengths = ts_calloc((size_t)(n + 1) * (m + 1), sizeof(uint32_t));
+        for (uint32_t i = n; i-- > 0;) {
+            for (uint32_t j = m; j-- > 0;) {
+                lengths[i * (m + 1) + j] = lines_equal(x[i], y[j])
+                    ? lengths[(i + 1) * (m + 1) + j + 1] + 1
+                    : (lengths[(i + 1) * (m + 1) + j] > lengths[i * (m + 1) + j + 1]
+                           ? lengths[(i + 1) * (m + 1) + j]
+                           : lengths[i * (m + 1) + j + 1]);
+            }
+        }
+        uint32_t i = 0, j = 0;
+        while (i < n || j < m) {
+            if (i < n && j < m && lines_equal(x[i], y[j])) {
+                write_line(out, ' ', x[i++]);
+                j++;
+            } else if (j == m || (i < n && lengths[(i + 1) * (m + 1) + j] >= lengths[i * (m + 1) + j + 1])) {
+                write_line(out, '-', x[i++]);
+            } else {
+                write_line(out, '+', y[j++]);
+            }
+        }
+        ts_free(lengths);
+    }
+    for (uint32_t i = a.size - suffix; i < a.size; i++) {
+        write_line(out, ' ', a.contents[i]);
+    }
+
+    array_delete(&a);
+    array_delete(&b);
+    talon_buffer_delete(&canonical);
+    talon_buffer_delete(&a_text);
+    talon_buffer_delete(&b_text);
+}
@@ -0,0 +1,182 @@
+#include "talon.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tree_sitter/array.h"
+
+typedef Array(char) Bytes;
+typedef Array(uint32_t) Offsets;
+
+struct TalonTable {
+    const TSLanguage *language;
+    // The id of ERROR nodes in the table, one past the symbols of the
+    // language, since the runtime gives them the id 65535.
+    TSSymbol error_symbol;
+    Array(uint32_t) file;
+    Array(TSSymbol) symbol;
+    Array(uint32_t) parent;
+    Array(uint32_t) start;
+    Array(uint32_t) end;
+    Array(TSFieldId) field;
+    Array(uint32_t) depth;
+    Offsets file_name_offsets;
+    Bytes file_names;
+};
+
+static void string_table_push(Offsets *offsets, Bytes *bytes, const char *string) {
+    if (offsets->size == 0) {
+        array_push(offsets, 0);
+    }
+    if (string != NULL) {
+        array_extend(bytes, (uint32_t)strlen(string), string);
+    }
+    array_push(offsets, bytes->size);
+}
+
+TalonTable *talon_table_new(const TSLanguage *language) {
+    TalonTable *table = ts_calloc(1, sizeof(TalonTable));
+    table->language = language;
+    table->error_symbol = (TSSymbol)ts_language_symbol_count(language);
+    array_push(&table->file_name_offsets, 0);
+    return table;
+}
+
+uint32_t talon_table_add(TalonTable *table, const char *name, const TSTree *tree) {
+    uint32_t file = table->file_name_offsets.size - 1;
+    string_table_push(&table->file_name_offsets, &table->file_names, name);
+
+    // Walk the tree in pre-order, keeping the rows of the ancestors of the
+    // current node on a stack.
+    Array(uint32_t) ancestors = array_new();
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+    for (;;) {
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+        uint32_t row = table->file.size;
+        array_push(&table->file, file);
+        array_push(&table->symbol, ts_node_is_error(node) ? table->error_symbol : ts_node_symbol(node));
+        array_push(&table->parent, ancestors.size ? *array_back(&ancestors) : UINT32_MAX);
+        array_push(&table->start, ts_node_start_byte(node));
+        array_push(&table->end, ts_node_end_byte(node));
+        array_push(&table->field, ts_tree_cursor_current_field_id(&cursor));
+        array_push(&table->depth, ancestors.size);
+
+        if (ts_tree_cursor_goto_first_child(&cursor)) {
+            array_push(&ancestors, row);
+            continue;
+        }
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                goto done;
+            }
+            ancestors.size--;
+        }
+    }
+done:
+    ts_tree_cursor_delete(&cursor);
+    array_delete(&ancestors);
+    return file;
+}
+
+uint32_t talon_table_row_count(const TalonTable *table) {
+    return table->file.size;
+}
+
+static uint64_t align(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+static bool write_bytes(FILE *stream, const void *data, size_t size) {
+    return size == 0 || fwrite(data, 1, size, stream) == size;
+}
+
+// Write zeros up to the next 8-byte boundary after a section of size bytes.
+static bool write_padding(FILE *stream, size_t size) {
+    static const char padding[8] = {0};
+    return write_bytes(stream, padding, align(size) - size);
+}
+
+bool talon_table_write(const TalonTable *table, const char *path) {
+    // Build the symbol and field name dictionaries from the language.
+    Offsets offsets[TALON_TABLE_SECTION_COUNT] = {0};
+    Bytes names[TALON_TABLE_SECTION_COUNT] = {0};
+    uint32_t symbol_count = ts_language_symbol_count(table->language);
+    for (uint32_t symbol = 0; symbol < symbol_count; symbol++) {
+        string_table_push(&offsets[TALON_TABLE_SYMBOL_NAMES], &names[TALON_TABLE_SYMBOL_NAMES],
+                          ts_language_symbol_name(table->language, (TSSymbol)symbol));
+    }
+    string_table_push(&offsets[TALON_TABLE_SYMBOL_NAMES], &names[TALON_TABLE_SYMBOL_NAMES], "ERROR");
+    uint32_t field_count = ts_language_field_count(table->language) + 1;
+    for (uint32_t field = 0; field < field_count; field++) {
+        string_table_push(&offsets[TALON_TABLE_FIELD_NAMES], &names[TALON_TABLE_FIELD_NAMES],
+                          field ? ts_language_field_name_for_id(table->language, (TSFieldId)field) : NULL);
+    }
+    offsets[TALON_TABLE_FILE_NAMES] = table->file_name_offsets;
+    names[TALON_TABLE_FILE_NAMES] = table->file_names;
+
+    uint32_t rows = table->file.size;
+    const void *columns[TALON_TABLE_SECTION_COUNT] = {
+        table->file.contents, table->symbol.contents, table->parent.contents, table->start.contents,
+        table->end.contents, table->field.contents, table->depth.contents,
+    };
+    size_t sizes[TALON_TABLE_SECTION_COUNT] = {
+        rows * sizeof(uint32_t), rows * sizeof(TSSymbol), rows * sizeof(uint32_t),
+        rows * sizeof(uint32_t), rows * sizeof(uint32_t), rows * sizeof(TSFieldId),
+        rows * sizeof(uint32_t),
+    };
+    for (int section = TALON_TABLE_FILE_NAMES; section < TALON_TABLE_SECTION_COUNT; section++) {
+        sizes[section] = offsets[section].size * sizeof(uint32_t) + names[section].size;
+    }
+
+    TalonTableHeader header = {
+        .version = TALON_TABLE_VERSION,
+        .row_count = rows,
+        .file_count = table->file_name_offsets.size - 1,
+        .symbol_count = symbol_count + 1,
+        .field_count = field_count,
+    };
+    memcpy(header.magic, TALON_TABLE_MAGIC, sizeof(header.magic));
+    uint64_t offset = align(sizeof(header));
+    for (int section = 0; section < TALON_TABLE_SECTION_COUNT; section++) {
+        header.offsets[section] = offset;
+        offset += align(sizes[section]);
+    }
+
+    bool ok = false;
+    FILE *stream = fopen(path, "wb");
+    if (stream != NULL) {
+        ok = write_bytes(stream, &header, sizeof(header)) && write_padding(stream, sizeof(header));
+        for (int section = 0; ok && section < TALON_TABLE_SECTION_COUNT; section++) {
+            if (section < TALON_TABLE_FILE_NAMES) {
+                ok = write_bytes(stream, columns[section], sizes[section]);
+            } else {
+                ok = write_bytes(stream, offsets[section].contents, offsets[section].size * sizeof(uint32_t)) &&
+                     write_bytes(stream, names[section].contents, names[section].size);
+            }
+            ok = ok && write_padding(stream, sizes[section]);
+        }
+        ok = fclose(stream) == 0 && ok;
+    }
+
+    for (int section = TALON_TABLE_SYMBOL_NAMES; section < TALON_TABLE_SECTION_COUNT; section++) {
+        array_delete(&offsets[section]);
+        array_delete(&names[section]);
+    }
+    return ok;
+}
+
+void talon_table_delete(TalonTable *table) {
+    if (table == NULL) {
+        return;
+    }
+    array_delete(&table->file);
+    array_delete(&table->symbol);
+    array_delete(&table->parent);
+    array_delete(&table->start);
+    array_delete(&table->end);
+    array_delete(&table->field);
+    array_delete(&table->depth);
+    array_delete(&table->file_name_offsets);
+    array_delete(&table->file_names);
+    ts_free(table);
+}
@@ -0,0 +1,347 @@
+#include "talon.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "tree_sitter/array.h"
+
+const TSLanguage *tree_sitter_talon(void);
+
+// Symbol and field ids used by the extractor.
+typedef struct {
+    TSSymbol matches;
+    TSSymbol declarations;
+    TSSymbol match;
+    TSSymbol command_declaration;
+    TSSymbol settings_declaration;
+    TSSymbol tag_import_declaration;
+    TSSymbol assignment_statement;
+    TSFieldId left;
+    TSFieldId right;
+    TSFieldId modifiers;
+} Ids;
+
+typedef struct {
+    Ids ids;
+    const char *source;
+    Array(TalonCommand) commands;
+    Array(TalonMatch) matches;
+    Array(TalonSetting) settings;
+    Array(TalonTagImport) tag_imports;
+} Extractor;
+
+static TSSymbol symbol(const TSLanguage *language, const char *name) {
+    return ts_language_symbol_for_name(language, name, (uint32_t)strlen(name), true);
+}
+
+static TSFieldId field(const TSLanguage *language, const char *name) {
+    return ts_language_field_id_for_name(language, name, (uint32_t)strlen(name));
+}
+
+static void Ids_init(Ids *ids, const TSLanguage *language) {
+    ids->matches = symbol(language, "matches");
+    ids->declarations = symbol(language, "declarations");
+    ids->match = symbol(language, "match");
+    ids->command_declaration = symbol(language, "command_declaration");
+    ids->settings_declaration = symbol(language, "settings_declaration");
+    ids->tag_import_declaration = symbol(language, "tag_import_declaration");
+    ids->assignment_statement = symbol(language, "assignment_statement");
+    ids->left = field(language, "left");
+    ids->right = field(language, "right");
+    ids->modifiers = field(language, "modifiers");
+}
+
+// Find the children with the left and right fields, and the flags of any
+// match modifiers, leaving the cursor where it started.
+static void find_fields(const Extractor *self, TSTreeCursor *cursor, TSNode *left, TSNode *right,
+                        uint32_t *flags) {
+    if (!ts_tree_cursor_goto_first_child(cursor)) {
+        return;
+    }
+    do {
+        TSFieldId field_id = ts_tree_cursor_current_field_id(cursor);
+        if (field_id == self->ids.left) {
+            *left = ts_tree_cursor_current_node(cursor);
+        } else if (field_id == self->ids.right) {
+            *right = ts_tree_cursor_current_node(cursor);
+        } else if (field_id == self->ids.modifiers) {
+            TSNode modifier = ts_tree_cursor_current_node(cursor);
+            *flags |= self->source[ts_node_start_byte(modifier)] == 'n' ? TALON_MATCH_NOT : TALON_MATCH_AND;
+        }
+    } while (ts_tree_cursor_goto_next_sibling(cursor));
+    ts_tree_cursor_goto_parent(cursor);
+}
+
+static void extract_settings(Extractor *self, TSNode block) {
+    TSTreeCursor cursor = ts_tree_cursor_new(block);
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+        do {
+            if (ts_node_symbol(ts_tree_cursor_current_node(&cursor)) != self->ids.assignment_statement) {
+                continue;
+            }
+            TSNode name = {0}, value = {0};
+            uint32_t flags = 0;
+            find_fields(self, &cursor, &name, &value, &flags);
+            if (name.id != NULL && value.id != NULL) {
+                TalonSetting setting = {
+                    ts_node_start_byte(name), ts_node_end_byte(name),
+                    ts_node_start_byte(value), ts_node_end_byte(value),
+                };
+                array_push(&self->settings, setting);
+            }
+        } while (ts_tree_cursor_goto_next_sibling(&cursor));
+    }
+    ts_tree_cursor_delete(&cursor);
+}
+
+static void extract_declaration(Extractor *self, TSTreeCursor *cursor) {
+    TSSymbol symbol = ts_node_symbol(ts_tree_cursor_current_node(cursor));
+    TSNode left = {0}, right = {0};
+    uint32_t flags = 0;
+    find_fields(self, cursor, &left, &right, &flags);
+
+    // Declarations containing errors may lack either side.
+    if (right.id == NULL) {
+        return;
+    }
+    if (symbol == self->ids.match && left.id != NULL) {
+        TalonMatch match = {
+            flags,
+            ts_node_start_byte(left), ts_node_end_byte(left),
+            ts_node_start_byte(right), ts_node_end_byte(right),
+        };
+        array_push(&self->matches, match);
+    } else if (symbol == self->ids.command_declaration && left.id != NULL) {
+        TalonCommand command = {
+            ts_node_start_byte(left), ts_node_end_byte(left),
+            ts_node_start_byte(right), ts_node_end_byte(right),
+        };
+        array_push(&self->commands, command);
+    } else if (symbol == self->ids.tag_import_declaration) {
+        TalonTagImport tag_import = {ts_node_start_byte(right), ts_node_end_byte(right)};
+        array_push(&self->tag_imports, tag_import);
+    } else if (symbol == self->ids.settings_declaration) {
+        extract_settings(self, right);
+    }
+}
+
+// Visit the top-level matches and declarations of a source file, in order.
+static void extract(Extractor *self, TSNode root) {
+    TSTreeCursor cursor = ts_tree_cursor_new(root);
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+        do {
+            TSSymbol section = ts_node_symbol(ts_tree_cursor_current_node(&cursor));
+            if (section != self->ids.matches && section != self->ids.declarations) {
+                continue;
+            }
+            if (ts_tree_cursor_goto_first_child(&cursor)) {
+                do {
+                    extract_declaration(self, &cursor);
+                } while (ts_tree_cursor_goto_next_sibling(&cursor));
+                ts_tree_cursor_goto_parent(&cursor);
+            }
+        } while (ts_tree_cursor_goto_next_sibling(&cursor));
+    }
+    ts_tree_cursor_delete(&cursor);
+}
+
+TSParser *talon_parser_new(void) {
+    TSParser *parser = ts_parser_new();
+    if (!ts_parser_set_language(parser, tree_sitter_talon())) {
+        ts_parser_delete(parser);
+        return NULL;
+    }
+    return parser;
+}
+
+// Parse source into a new file, which takes ownership of the source if owned.
+static TalonFile *parse(TSParser *parser, const char *source, uint32_t length, bool owned) {
+    TSParser *own_parser = NULL;
+    if (parser == NULL && (parser = own_parser = talon_parser_new()) == NULL) {
+        return NULL;
+    }
+    TalonFile *file = ts_calloc(1, sizeof(TalonFile));
+    TSTree *tree = ts_parser_parse_string(parser, NULL, source, length);
+    if (own_parser != NULL) {
+        ts_parser_delete(own_parser);
+    }
+    if (tree == NULL) {
+        ts_free(file);
+        return NULL;
+    }
+
+    Extractor extractor = {.source = source};
+    array_init(&extractor.commands);
+    array_init(&extractor.matches);
+    array_init(&extractor.settings);
+    array_init(&extractor.tag_imports);
+    Ids_init(&extractor.ids, ts_tree_language(tree));
+    TSNode root = ts_tree_root_node(tree);
+    extract(&extractor, root);
+
+    file->source = source;
+    file->length = length;
+    file->tree = tree;
+    file->has_error = ts_node_has_error(root);
+    file->commands = extractor.commands.contents;
+    file->command_count = extractor.commands.size;
+    file->matches = extractor.matches.contents;
+    file->match_count = extractor.matches.size;
+    file->settings = extractor.settings.contents;
+    file->setting_count = extractor.settings.size;
+    file->tag_imports = extractor.tag_imports.contents;
+    file->tag_import_count = extractor.tag_imports.size;
+    file->owns_source = owned;
+    return file;
+}
+
+TalonFile *talon_parse_string(TSParser *parser, const char *source, uint32_t length) {
+    return parse(parser, source, length, false);
+}
+
+#ifndef _WIN32
+
+TalonFile *talon_parse_file(TSParser *parser, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size > UINT32_MAX) {
+        close(fd);
+        errno = EFBIG;
+        return NULL;
+    }
+
+    // Empty files cannot be mapped.
+    uint32_t length = (uint32_t)st.st_size;
+    const char *source = "";
+    if (length > 0) {
+        void *mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            return NULL;
+        }
+        source = mapping;
+    }
+    close(fd);
+
+    TalonFile *file = parse(parser, source, length, length > 0);
+    if (file == NULL && length > 0) {
+        munmap((void *)source, length);
+    }
+    return file;
+}
+
+static void free_source(TalonFile *file) {
+    munmap((void *)file->source, file->length);
+}
+
+#else
+
+// Windows has no mmap, so files are read into memory instead.
+TalonFile *talon_parse_file(TSParser *parser, const char *path) {
+    FILE *stream = fopen(path, "rb");
+    if (stream == NULL) {
+        return NULL;
+    }
+    char *source = NULL;
+    size_t length = 0, capacity = 0, count;
+    do {
+        if (length == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            if (capacity > UINT32_MAX) {
+                ts_free(source);
+                fclose(stream);
+                errno = EFBIG;
+                return NULL;
+            }
+            source = ts_realloc(source, capacity);
+        }
+        count = fread(source + length, 1, capacity - length, stream);
+        length += count;
+    } while (count > 0);
+    bool failed = ferror(stream);
+    fclose(stream);
+    if (failed) {
+        ts_free(source);
+        return NULL;
+    }
+
+    TalonFile *file = parse(parser, source, (uint32_t)length, true);
+    if (file == NULL) {
+        ts_free(source);
+    }
+    return file;
+}
+
+static void free_source(TalonFile *file) {
+    ts_free((void *)file->source);
+}
+
+#endif
+
+size_t talon_parse_many(TSParser *parser, const char *const *paths, size_t count,
+                        TalonFile **files) {
+    TSParser *own_parser = NULL;
+    if (parser == NULL && (parser = own_parser = talon_parser_new()) == NULL) {
+        return 0;
+    }
+    size_t i = 0;
+    for (; i < count; i++) {
+        if ((files[i] = talon_parse_file(parser, paths[i])) == NULL) {
+            break;
+        }
+    }
+    if (own_parser != NULL) {
+        ts_parser_delete(own_parser);
+    }
+    return i;
+}
+
+void talon_file_delete(TalonFile *file) {
+    if (file == NULL) {
+        return;
+    }
+    if (file->owns_source) {
+        free_source(file);
+    }
+    ts_tree_delete(file->tree);
+    ts_free(file->commands);
+    ts_free(file->matches);
+    ts_free(file->settings);
+    ts_free(file->tag_imports);
+    ts_free(file);
+}
+
+const TalonCommand *talon_file_commands(const TalonFile *file, uint32_t *count) {
+    *count = file->command_count;
+    return file->commands;
+}
+
+const TalonMatch *talon_file_matches(const TalonFile *file, uint32_t *count) {
+    *count = file->match_count;
+    return file->matches;
+}
+
+const TalonSetting *talon_file_settings(const TalonFile *file, uint32_t *count) {
+    *count = file->setting_count;
+    return file->settings;
+}
+
+const TalonTagImport *talon_file_tag_imports(const TalonFile *file, uint32_t *count) {
+    *count = file->tag_import_count;
+    return file->tag_imports;
+}
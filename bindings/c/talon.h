@@ -0,0 +1,432 @@
+#ifndef TREE_SITTER_TALON_API_H_
+#define TREE_SITTER_TALON_API_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <tree_sitter/api.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A command declaration, such as "go <user.letter>: key(enter)".
+typedef struct {
+    uint32_t rule_start;
+    uint32_t rule_end;
+    uint32_t body_start;
+    uint32_t body_end;
+} TalonCommand;
+
+#define TALON_MATCH_AND (1 << 0)
+#define TALON_MATCH_NOT (1 << 1)
+
+// A line of the context header, such as "not app: firefox".
+typedef struct {
+    uint32_t modifiers;
+    uint32_t left_start;
+    uint32_t left_end;
+    uint32_t right_start;
+    uint32_t right_end;
+} TalonMatch;
+
+// An assignment in a settings() block.
+typedef struct {
+    uint32_t name_start;
+    uint32_t name_end;
+    uint32_t value_start;
+    uint32_t value_end;
+} TalonSetting;
+
+// The name of a tag enabled by a tag() declaration.
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+} TalonTagImport;
+
+// A parsed talon file and the records extracted from it. All offsets are
+// bytes into source. The fields are read-only.
+typedef struct {
+    const char *source;
+    uint32_t length;
+    TSTree *tree;
+    bool has_error;
+    TalonCommand *commands;
+    uint32_t command_count;
+    TalonMatch *matches;
+    uint32_t match_count;
+    TalonSetting *settings;
+    uint32_t setting_count;
+    TalonTagImport *tag_imports;
+    uint32_t tag_import_count;
+    // Whether source was mapped or read by talon_parse_file, and is
+    // released by talon_file_delete.
+    bool owns_source;
+} TalonFile;
+
+// Create a parser for the talon language.
+TSParser *talon_parser_new(void);
+
+// Memory-map the file at path (or read it, on Windows), parse it and extract its records. If parser
+// is NULL, a temporary parser is used. Returns NULL and sets errno on error.
+TalonFile *talon_parse_file(TSParser *parser, const char *path);
+
+// Parse a string and extract its records. The string is borrowed, and
+// must outlive the returned file. Returns NULL on error.
+TalonFile *talon_parse_string(TSParser *parser, const char *source, uint32_t length);
+
+// Parse count files in order with one parser, storing the results in files.
+// Callers parse in parallel by calling this from several threads, each with
+// its own parser. Returns the number of files parsed before an error, with
+// errno set, or count.
+size_t talon_parse_many(TSParser *parser, const char *const *paths, size_t count,
+                        TalonFile **files);
+
+void talon_file_delete(TalonFile *file);
+
+const TalonCommand *talon_file_commands(const TalonFile *file, uint32_t *count);
+const TalonMatch *talon_file_matches(const TalonFile *file, uint32_t *count);
+const TalonSetting *talon_file_settings(const TalonFile *file, uint32_t *count);
+const TalonTagImport *talon_file_tag_imports(const TalonFile *file, uint32_t *count);
+
+// A columnar table of the nodes of many trees, for analytics over large
+// sets of files. Each node is a row, and each attribute is stored as a
+// separate column, so a reader can map the written file and load only the
+// columns it needs.
+typedef struct TalonTable TalonTable;
+
+// The sections of a written table, in file order. Columns hold one value
+// per row:
+// file:   uint32 index of the file the node is from
+// symbol: uint16 symbol id, an index into symbol names
+// parent: uint32 row of the parent node, or UINT32_MAX for roots
+// start:  uint32 start byte
+// end:    uint32 end byte
+// field:  uint16 field id, an index into field names, or 0 for none
+// depth:  uint32 depth, where roots have depth 0
+// The names sections are string tables: count + 1 uint32 offsets into
+// the UTF-8 bytes that follow them, so that string i spans offsets i to
+// i + 1. Symbol names are the dictionary of symbol ids, as given by
+// ts_language_symbol_name, followed by "ERROR", the symbol of error nodes.
+// The first field name is empty.
+enum {
+    TALON_TABLE_FILE,
+    TALON_TABLE_SYMBOL,
+    TALON_TABLE_PARENT,
+    TALON_TABLE_START,
+    TALON_TABLE_END,
+    TALON_TABLE_FIELD,
+    TALON_TABLE_DEPTH,
+    TALON_TABLE_FILE_NAMES,
+    TALON_TABLE_SYMBOL_NAMES,
+    TALON_TABLE_FIELD_NAMES,
+    TALON_TABLE_SECTION_COUNT,
+};
+
+#define TALON_TABLE_MAGIC "TALONTBL"
+#define TALON_TABLE_VERSION 2
+
+// The header at the start of a written table. Integers are in host byte
+// order, and every section starts on an 8-byte boundary.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t row_count;
+    uint32_t file_count;
+    uint32_t symbol_count;
+    uint32_t field_count;
+    uint32_t reserved;
+    uint64_t offsets[TALON_TABLE_SECTION_COUNT];
+} TalonTableHeader;
+
+TalonTable *talon_table_new(const TSLanguage *language);
+
+// Append the nodes of tree as rows, and return the index of the file.
+uint32_t talon_table_add(TalonTable *table, const char *name, const TSTree *tree);
+
+uint32_t talon_table_row_count(const TalonTable *table);
+
+// Write the table to path. Returns false and sets errno on error.
+bool talon_table_write(const TalonTable *table, const char *path);
+
+void talon_table_delete(TalonTable *table);
+
+// A growable output buffer. If fd is non-negative, the buffer is written
+// to it whenever it fills up, so output of any size streams through a
+// fixed amount of memory; otherwise the output accumulates in data.
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+    int fd;
+    // Set, along with errno, if writing to fd fails.
+    bool failed;
+} TalonBuffer;
+
+void talon_buffer_init(TalonBuffer *buffer, int fd);
+
+// Write any buffered output to fd. Returns false if a write has failed.
+bool talon_buffer_flush(TalonBuffer *buffer);
+
+void talon_buffer_delete(TalonBuffer *buffer);
+
+// Options for talon_write_json.
+#define TALON_JSON_NAMED (1 << 0) // Omit anonymous nodes.
+#define TALON_JSON_TEXT (1 << 1)  // Include the source text of leaf nodes.
+
+// Append tree to buffer as JSON, walking it with a cursor rather than
+// building any intermediate objects. Each node is an object such as
+//   {"type":"match","named":true,"start":0,"end":9,"children":[...]}
+// with a "field" key for nodes that are the value of a field, a "missing"
+// key for missing nodes, and a "text" key for leaves if TALON_JSON_TEXT
+// is set, in which case source must be the text the tree was parsed from.
+// Returns false if writing to the buffer's fd failed.
+bool talon_write_json(TalonBuffer *buffer, const TSTree *tree, const char *source, uint32_t flags);
+
+// Options for talon_write_sexp and talon_sexp_hash.
+#define TALON_SEXP_FIELDS (1 << 0) // Prefix nodes with their field names.
+
+// Append node to buffer as an S-expression of its named nodes, formatted
+// as by ts_node_string. Source is used to print the unexpected character
+// of ERROR leaves, and may be NULL if the tree has no errors. Reusing one
+// buffer across calls avoids allocating a string per tree.
+void talon_write_sexp(TalonBuffer *buffer, TSNode node, const char *source, uint32_t flags);
+
+// Hash the S-expression that talon_write_sexp would write, without
+// writing it, using a rolling 64-bit FNV-1a hash of its text.
+uint64_t talon_sexp_hash(TSNode node, const char *source, uint32_t flags);
+
+// Hash S-expression text, such as an expected tree from the test corpus,
+// ignoring whitespace and line breaks, such that it hashes the same as a
+// tree with an equal S-expression. Sets has_fields, if not NULL, to
+// whether the text contains field names, which tells whether to hash the
+// tree with TALON_SEXP_FIELDS.
+uint64_t talon_sexp_hash_text(const char *text, size_t length, bool *has_fields);
+
+// Append S-expression text to buffer with whitespace normalised as by
+// talon_write_sexp.
+void talon_sexp_normalize(TalonBuffer *buffer, const char *text, size_t length);
+
+// Append S-expression text to buffer laid out as in the test corpus, with
+// one node per line, indented by two spaces per level.
+void talon_sexp_format(TalonBuffer *buffer, const char *text, size_t length);
+
+// Append a line diff of two S-expressions to out, each laid out with one
+// node per line, as in the test corpus. Lines only in expected are
+// prefixed with "-", and lines only in actual with "+". Meant for when
+// hashes differ, to show where.
+void talon_sexp_diff(TalonBuffer *out, const char *expected, size_t expected_length, const char *actual,
+                     size_t actual_length);
+
+// A table of interned strings, such as the words, list names and capture
+// names of rules, so that automata compare labels as integers. Automata
+// compiled with one table share its ids. Not safe to use from several
+// threads while strings are being added.
+typedef struct TalonWords TalonWords;
+
+#define TALON_NO_WORD UINT32_MAX
+
+TalonWords *talon_words_new(void);
+
+// Return the id of a string, adding it if it is new. Ids count up from 0.
+uint32_t talon_words_intern(TalonWords *words, const char *string, uint32_t length);
+
+// Return the id of a string, or TALON_NO_WORD if it was never added.
+uint32_t talon_words_find(const TalonWords *words, const char *string, uint32_t length);
+
+// Return the string with an id, which is not null-terminated.
+const char *talon_words_string(const TalonWords *words, uint32_t id, uint32_t *length);
+
+uint32_t talon_words_count(const TalonWords *words);
+
+void talon_words_delete(TalonWords *words);
+
+// The kinds of edge in an automaton. List and capture edges stand for a
+// phrase matching an item of the list or the capture, which the automaton
+// leaves to whoever runs it.
+enum {
+    TALON_EDGE_WORD,    // A word, such as "go".
+    TALON_EDGE_LIST,    // An item of a list, such as {user.letter}.
+    TALON_EDGE_CAPTURE, // A capture, such as <user.text>.
+};
+
+typedef struct {
+    uint32_t kind;
+    // The id of the word, list name or capture name.
+    uint32_t id;
+    uint32_t target;
+} TalonEdge;
+
+// An automaton over the words of a phrase, compiled from a rule. State 0
+// is the start, and the edges of state i are edges[edge_offsets[i]] up to
+// edges[edge_offsets[i + 1]], sorted by kind, id and target. The fields are
+// read-only.
+typedef struct {
+    uint32_t state_count;
+    uint32_t *edge_offsets;
+    TalonEdge *edges;
+    bool *accepting;
+    // Whether the rule has a ^ or a $, which Talon applies to the whole
+    // rule: the phrase must start or end with it.
+    bool start_anchor;
+    bool end_anchor;
+    // Whether no state has two edges with the same label. Rules whose
+    // determinization would exceed an internal limit on states are kept
+    // nondeterministic, though still minimized by merging states with the
+    // same behaviour.
+    bool deterministic;
+    // The states of the automaton before determinization and minimization.
+    uint32_t nfa_state_count;
+} TalonAutomaton;
+
+// Compile a rule, or any node of one, such as the left side of a command
+// declaration, into an automaton that accepts the same phrases, with the
+// fewest states. Words, list names and capture names are added to words.
+// Returns NULL if the rule contains errors.
+TalonAutomaton *talon_automaton_compile(TalonWords *words, TSNode rule, const char *source);
+
+void talon_automaton_delete(TalonAutomaton *automaton);
+
+// A matcher of phrases against many command rules at once. The automata
+// of all commands are laid out in one set of states, and a phrase is run
+// through all of them together, keeping the active states as a bitset and
+// updating 64 states per operation, so the work per word depends on the
+// states that word can reach, not on the number of commands.
+//
+// List and capture edges are expanded into the states of the commands
+// that use them: lists into a trie of their items, and captures into the
+// automaton of their rule. Lists and captures without a definition, and
+// captures nested too deeply, match one or more words of any kind, as
+// <phrase> does. Captures that match an empty phrase are not supported.
+typedef struct TalonMatcher TalonMatcher;
+
+// Create a matcher whose words, and the names of its lists and captures,
+// are ids in words, which must outlive it.
+TalonMatcher *talon_matcher_new(TalonWords *words);
+
+// Add an item to a list, given as words separated by spaces.
+void talon_matcher_add_list_item(TalonMatcher *matcher, const char *list, const char *item);
+
+// Define a capture by the automaton of its rule, which is copied.
+void talon_matcher_add_capture(TalonMatcher *matcher, const char *capture, const TalonAutomaton *rule);
+
+// Add a command by the automaton of its rule, which is copied. Returns the
+// index of the command, counting up from 0.
+uint32_t talon_matcher_add_command(TalonMatcher *matcher, const TalonAutomaton *rule);
+
+// Expand and lay out the commands, after which nothing more can be added.
+void talon_matcher_build(TalonMatcher *matcher);
+
+// The number of states of the built matcher, after expansion.
+uint32_t talon_matcher_state_count(const TalonMatcher *matcher);
+
+void talon_matcher_delete(TalonMatcher *matcher);
+
+// The words of a phrase that matched a list or capture of a command.
+typedef struct {
+    uint32_t kind; // TALON_EDGE_LIST or TALON_EDGE_CAPTURE
+    uint32_t name; // The id of the list or capture name.
+    uint32_t start;
+    uint32_t end;
+} TalonBinding;
+
+// A command that matched a phrase, and its bindings, which are
+// bindings[binding_offset] up to bindings[binding_offset + binding_count]
+// in order of position. If a phrase matches a rule in more than one way,
+// one of them is given.
+typedef struct {
+    uint32_t command;
+    uint32_t binding_offset;
+    uint32_t binding_count;
+} TalonPhraseMatch;
+
+// The matches of a phrase, and scratch space for matching. Reusing one
+// across phrases avoids allocating per phrase, and each thread matching
+// at once needs its own. The fields are read-only, and valid until the
+// next match.
+typedef struct {
+    TalonPhraseMatch *matches;
+    uint32_t match_count;
+    TalonBinding *bindings;
+    uint32_t binding_count;
+    void *scratch;
+} TalonPhraseMatches;
+
+void talon_phrase_matches_init(TalonPhraseMatches *matches);
+
+void talon_phrase_matches_delete(TalonPhraseMatches *matches);
+
+// Find the commands whose rules match the whole of a phrase of length
+// words, given as ids in the matcher's word table, or TALON_NO_WORD for
+// words not in it, in order of command index. The matcher must be built.
+// Returns the number of matches.
+uint32_t talon_matcher_match(const TalonMatcher *matcher, const uint32_t *phrase, uint32_t length,
+                             TalonPhraseMatches *matches);
+
+// The context headers of many files, compiled for finding which files are
+// active as the scope changes. Each distinct test of the match lines, such
+// as "app.name: Firefox" or "tag: user.tabs", is a condition numbered once
+// however many files use it, and each header becomes clauses of conditions.
+// A scope keeps the conditions that hold as a bitset, updated one key at a
+// time, and finding the active files only visits the clauses that use a
+// condition that holds, rather than comparing strings for every file.
+//
+// Lines combine as in Talon. A line starting with "and" joins the clause of
+// the line before it. Clauses whose first lines have the same key, such as
+// two "app.name" lines, are alternatives, and the clauses of different keys
+// must all match. A clause whose first line starts with "not" must match on
+// its own. Values are compared exactly, except those written as
+// /pattern/flags, which are tested by the scope's pattern callback.
+typedef struct TalonContexts TalonContexts;
+
+TalonContexts *talon_contexts_new(void);
+
+// Add the context header of a parsed file, which is not kept. Returns the
+// index of the file, counting up from 0.
+uint32_t talon_contexts_add_file(TalonContexts *contexts, const TalonFile *file);
+
+// Index the headers, after which no more files can be added.
+void talon_contexts_build(TalonContexts *contexts);
+
+// The number of distinct conditions and of clauses in all headers.
+uint32_t talon_contexts_condition_count(const TalonContexts *contexts);
+uint32_t talon_contexts_clause_count(const TalonContexts *contexts);
+
+void talon_contexts_delete(TalonContexts *contexts);
+
+// Whether a value matches a pattern, given as written with its slashes and
+// flags, such as "/firefox|chrome/i".
+typedef bool (*TalonPatternCallback)(void *payload, const char *pattern, uint32_t pattern_length, const char *value,
+                                     uint32_t value_length);
+
+// The values of the keys of a scope, and the tags and modes enabled, for
+// one set of built contexts, which must outlive it. Each thread evaluating
+// at once needs its own scope.
+typedef struct TalonScope TalonScope;
+
+// Create a scope where no key has a value and no tag or mode is enabled.
+// Patterns are tested by calling match with payload, or never match if
+// match is NULL.
+TalonScope *talon_scope_new(const TalonContexts *contexts, TalonPatternCallback match, void *payload);
+
+// Set the value of a key, such as "app.name" or "title", replacing the one
+// it had, or clear it if value is NULL. Patterns on the key are tested
+// here, once per change.
+void talon_scope_set(TalonScope *scope, const char *key, const char *value);
+
+// Enable or disable a tag or mode, as the value of the key "tag" or "mode",
+// of which any number can be enabled at once.
+void talon_scope_enable(TalonScope *scope, const char *key, const char *name, bool enabled);
+
+// Find the files whose headers match the scope, including those without a
+// header, in order of index. Stores their indices in files, valid until the
+// next call, and returns their number.
+uint32_t talon_scope_active_files(TalonScope *scope, const uint32_t **files);
+
+void talon_scope_delete(TalonScope *scope);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TREE_SITTER_TALON_API_H_
@@ -1,8 +1,8 @@
 package tree_sitter_talon
 
-// #cgo CFLAGS: -std=c11 -fPIC
+// #cgo CFLAGS: -I${SRCDIR}/../../src -std=c11 -fPIC
 // #include "../../src/parser.c"
-// // NOTE: if your language has an external scanner, add it here.
+// #include "../../src/scanner.c"
 import "C"
 
 import "unsafe"
@@ -1,6 +1,8 @@
 package tree_sitter_talon_test
 
 import (
+	"os"
+	"path/filepath"
 	"testing"
 
 	tree_sitter "github.com/smacker/go-tree-sitter"
@@ -13,3 +15,48 @@ func TestCanLoadGrammar(t *testing.T) {
 		t.Errorf("Error loading Talon grammar")
 	}
 }
+
+func TestParseDir(t *testing.T) {
+	root := t.TempDir()
+	if err := os.MkdirAll(filepath.Join(root, "apps"), 0o755); err != nil {
+		t.Fatal(err)
+	}
+	sources := map[string]string{
+		"a.talon":        "tag(): user.tabs\nsettings():\n    speech.timeout = 0.3\n",
+		"apps/b.talon":   "not app: firefox\n-\ngo <user.letter>: key(enter)\n",
+		"apps/notes.txt": "not talon",
+	}
+	for name, source := range sources {
+		if err := os.WriteFile(filepath.Join(root, name), []byte(source), 0o644); err != nil {
+			t.Fatal(err)
+		}
+	}
+
+	files, err := tree_sitter_talon.ParseDir(root, 2)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if len(files) != 2 {
+		t.Fatalf("expected 2 files, got %d", len(files))
+	}
+
+	a := files[0]
+	if len(a.TagImports) != 1 || a.Text(a.TagImports[0].Start, a.TagImports[0].End) != "user.tabs" {
+		t.Errorf("unexpected tag imports %v", a.TagImports)
+	}
+	if len(a.Settings) != 1 || a.Text(a.Settings[0].NameStart, a.Settings[0].NameEnd) != "speech.timeout" {
+		t.Errorf("unexpected settings %v", a.Settings)
+	}
+
+	b := files[1]
+	if b.HasError {
+		t.Errorf("unexpected parse error in %s", b.Path)
+	}
+	if len(b.Matches) != 1 || b.Matches[0].Modifiers != tree_sitter_talon.MatchNot ||
+		b.Text(b.Matches[0].RightStart, b.Matches[0].RightEnd) != "firefox" {
+		t.Errorf("unexpected matches %v", b.Matches)
+	}
+	if len(b.Commands) != 1 || b.Text(b.Commands[0].RuleStart, b.Commands[0].RuleEnd) != "go <user.letter>" {
+		t.Errorf("unexpected commands %v", b.Commands)
+	}
+}
@@ -0,0 +1,45 @@
+// Command startup measures the time to the first parsed tree with the Go
+// binding.
+//
+// Usage: startup FILE
+//
+// It prints the time each step took as JSON, like tools/talon-startup. The
+// grammar is linked statically, so there is no separate load step.
+package main
+
+import (
+	"context"
+	"fmt"
+	"os"
+	"time"
+
+	sitter "github.com/smacker/go-tree-sitter"
+	tree_sitter_talon "github.com/tree-sitter/tree-sitter-talon"
+)
+
+func main() {
+	if len(os.Args) != 2 {
+		fmt.Fprintln(os.Stderr, "usage: startup FILE")
+		os.Exit(2)
+	}
+	source, err := os.ReadFile(os.Args[1])
+	if err != nil {
+		fmt.Fprintln(os.Stderr, err)
+		os.Exit(1)
+	}
+
+	start := time.Now()
+	parser := sitter.NewParser()
+	parser.SetLanguage(sitter.NewLanguage(tree_sitter_talon.Language()))
+	constructed := time.Now()
+
+	if _, err := parser.ParseCtx(context.Background(), nil, source); err != nil {
+		fmt.Fprintln(os.Stderr, err)
+		os.Exit(1)
+	}
+	parsed := time.Now()
+
+	milliseconds := func(d time.Duration) float64 { return float64(d.Nanoseconds()) / 1e6 }
+	fmt.Printf("{\"load_ms\":0,\"language_ms\":%.6f,\"parse_ms\":%.6f}\n",
+		milliseconds(constructed.Sub(start)), milliseconds(parsed.Sub(constructed)))
+}
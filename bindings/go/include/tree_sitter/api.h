@@ -0,0 +1,63 @@
+#ifndef TREE_SITTER_API_H_
+#define TREE_SITTER_API_H_
+
+// The declarations of the tree-sitter runtime that bindings/c/talon.c
+// uses, as go-tree-sitter compiles it in. go-tree-sitter does not export
+// its headers to other packages, so they are copied here; the layouts of
+// TSNode and TSTreeCursor are those of the runtime it bundles (0.20.8).
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef uint16_t TSSymbol;
+typedef uint16_t TSFieldId;
+typedef struct TSLanguage TSLanguage;
+typedef struct TSParser TSParser;
+typedef struct TSTree TSTree;
+
+typedef struct {
+    uint32_t context[4];
+    const void *id;
+    const TSTree *tree;
+} TSNode;
+
+typedef struct {
+    const void *tree;
+    const void *id;
+    uint32_t context[2];
+} TSTreeCursor;
+
+TSParser *ts_parser_new(void);
+void ts_parser_delete(TSParser *parser);
+bool ts_parser_set_language(TSParser *self, const TSLanguage *language);
+TSTree *ts_parser_parse_string(TSParser *self, const TSTree *old_tree, const char *string, uint32_t length);
+
+void ts_tree_delete(TSTree *self);
+TSNode ts_tree_root_node(const TSTree *self);
+const TSLanguage *ts_tree_language(const TSTree *self);
+
+TSSymbol ts_node_symbol(TSNode self);
+uint32_t ts_node_start_byte(TSNode self);
+uint32_t ts_node_end_byte(TSNode self);
+bool ts_node_has_error(TSNode self);
+
+TSTreeCursor ts_tree_cursor_new(TSNode node);
+void ts_tree_cursor_delete(TSTreeCursor *self);
+TSNode ts_tree_cursor_current_node(const TSTreeCursor *self);
+TSFieldId ts_tree_cursor_current_field_id(const TSTreeCursor *self);
+bool ts_tree_cursor_goto_first_child(TSTreeCursor *self);
+bool ts_tree_cursor_goto_next_sibling(TSTreeCursor *self);
+bool ts_tree_cursor_goto_parent(TSTreeCursor *self);
+
+TSSymbol ts_language_symbol_for_name(const TSLanguage *self, const char *string, uint32_t length, bool is_named);
+TSFieldId ts_language_field_id_for_name(const TSLanguage *self, const char *name, uint32_t name_length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TREE_SITTER_API_H_
@@ -0,0 +1,190 @@
+package tree_sitter_talon
+
+// talon.c runs on the tree-sitter runtime that go-tree-sitter compiles in,
+// declared by include/tree_sitter/api.h, so no tree-sitter library is
+// linked.
+
+// #cgo CFLAGS: -I${SRCDIR}/include -I${SRCDIR}/../../src -I${SRCDIR}/../c -std=c11
+// #include <stdlib.h>
+// #include "../c/talon.c"
+//
+// static void delete_files(TalonFile **files, size_t count) {
+//     for (size_t i = 0; i < count; i++) {
+//         talon_file_delete(files[i]);
+//     }
+// }
+import "C"
+
+import (
+	"errors"
+	"fmt"
+	"io/fs"
+	"path/filepath"
+	"runtime"
+	"sync"
+	"sync/atomic"
+	"unsafe"
+
+	// The runtime's C symbols, which talon.c links against.
+	_ "github.com/smacker/go-tree-sitter"
+)
+
+// Modifier flags of a Match.
+const (
+	MatchAnd = C.TALON_MATCH_AND
+	MatchNot = C.TALON_MATCH_NOT
+)
+
+// A Command is a command declaration. Offsets are bytes into File.Source.
+type Command struct {
+	RuleStart, RuleEnd, BodyStart, BodyEnd uint32
+}
+
+// A Match is a line of the context header, such as "not app: firefox".
+type Match struct {
+	Modifiers            uint32
+	LeftStart, LeftEnd   uint32
+	RightStart, RightEnd uint32
+}
+
+// A Setting is an assignment in a settings() block.
+type Setting struct {
+	NameStart, NameEnd, ValueStart, ValueEnd uint32
+}
+
+// A TagImport is the name of a tag enabled by a tag() declaration.
+type TagImport struct {
+	Start, End uint32
+}
+
+// A File holds the records extracted from a parsed .talon file.
+type File struct {
+	Path       string
+	Source     []byte
+	HasError   bool
+	Commands   []Command
+	Matches    []Match
+	Settings   []Setting
+	TagImports []TagImport
+}
+
+// Text returns the source text between two byte offsets.
+func (f *File) Text(start, end uint32) string {
+	return string(f.Source[start:end])
+}
+
+// Files are parsed in batches of up to this many files or bytes, so that
+// each cgo call does enough work to amortise the cost of crossing over,
+// while large files are still spread across workers.
+const (
+	batchFiles = 64
+	batchBytes = 1 << 20
+)
+
+type parser struct {
+	ptr *C.TSParser
+}
+
+// Parsers are pooled across calls. sync.Pool may drop them at any GC, so
+// a finalizer frees the C parser.
+var parsers = sync.Pool{
+	New: func() any {
+		p := &parser{C.talon_parser_new()}
+		runtime.SetFinalizer(p, func(p *parser) { C.ts_parser_delete(p.ptr) })
+		return p
+	},
+}
+
+// ParseDir parses every .talon file under root, using up to workers
+// goroutines, and returns the extracted records ordered by path. If
+// workers is less than one, runtime.NumCPU() workers are used.
+func ParseDir(root string, workers int) ([]*File, error) {
+	var files []*File
+	var batches [][]*File
+	start, size := 0, int64(0)
+	err := filepath.WalkDir(root, func(path string, entry fs.DirEntry, err error) error {
+		if err != nil || entry.IsDir() || filepath.Ext(path) != ".talon" {
+			return err
+		}
+		info, err := entry.Info()
+		if err != nil {
+			return err
+		}
+		files = append(files, &File{Path: path})
+		if size += info.Size(); len(files)-start == batchFiles || size >= batchBytes {
+			batches = append(batches, files[start:])
+			start, size = len(files), 0
+		}
+		return nil
+	})
+	if err != nil {
+		return nil, err
+	}
+	if start < len(files) {
+		batches = append(batches, files[start:])
+	}
+
+	if workers < 1 {
+		workers = runtime.NumCPU()
+	}
+	var next atomic.Int64
+	var wg sync.WaitGroup
+	errs := make([]error, workers)
+	for w := range errs {
+		wg.Add(1)
+		go func(w int) {
+			defer wg.Done()
+			for errs[w] == nil {
+				i := int(next.Add(1)) - 1
+				if i >= len(batches) {
+					return
+				}
+				errs[w] = parseBatch(batches[i])
+			}
+		}(w)
+	}
+	wg.Wait()
+	if err := errors.Join(errs...); err != nil {
+		return nil, err
+	}
+	return files, nil
+}
+
+// parseBatch parses a batch of files in a single cgo call, which maps each
+// file and extracts its records, and copies the results into Go memory.
+func parseBatch(files []*File) error {
+	paths := make([]*C.char, len(files))
+	for i, file := range files {
+		paths[i] = C.CString(file.Path)
+		defer C.free(unsafe.Pointer(paths[i]))
+	}
+	results := make([]*C.TalonFile, len(files))
+
+	p := parsers.Get().(*parser)
+	defer parsers.Put(p)
+	n, err := C.talon_parse_many(p.ptr, &paths[0], C.size_t(len(files)), &results[0])
+	defer C.delete_files(&results[0], n)
+	if int(n) < len(files) {
+		return fmt.Errorf("tree_sitter_talon: parsing %s: %w", files[int(n)].Path, err)
+	}
+
+	for i, file := range files {
+		result := results[i]
+		file.Source = C.GoBytes(unsafe.Pointer(result.source), C.int(result.length))
+		file.HasError = bool(result.has_error)
+		file.Commands = records[Command](result.commands, result.command_count)
+		file.Matches = records[Match](result.matches, result.match_count)
+		file.Settings = records[Setting](result.settings, result.setting_count)
+		file.TagImports = records[TagImport](result.tag_imports, result.tag_import_count)
+	}
+	return nil
+}
+
+// records copies count C records into a slice of T, which must be a struct
+// with the same uint32 fields as the C record.
+func records[T, R any](data *R, count C.uint32_t) []T {
+	if count == 0 {
+		return nil
+	}
+	return append([]T(nil), unsafe.Slice((*T)(unsafe.Pointer(data)), count)...)
+}
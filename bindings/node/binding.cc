@@ -1,19 +1,74 @@
 #include <napi.h>
 
-typedef struct TSLanguage TSLanguage;
+#include "talon.h"
 
-extern "C" TSLanguage *tree_sitter_talon();
+extern "C" const TSLanguage *tree_sitter_talon();
 
 // "tree-sitter", "language" hashed with BLAKE2
 const napi_type_tag LANGUAGE_TYPE_TAG = {
   0x8AF2E5212AD58ABF, 0xD5006CAD83ABBA16
 };
 
+// Per-environment state, deleted when the environment is torn down.
+struct AddonData {
+    TSParser *parser = talon_parser_new();
+    ~AddonData() { ts_parser_delete(parser); }
+};
+
+// toJSON(source: string | Buffer, options?: { named?: boolean, text?: boolean }): string
+Napi::Value ToJSON(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    std::string string;
+    const char *source;
+    size_t length;
+    if (info[0].IsBuffer()) {
+        auto buffer = info[0].As<Napi::Buffer<char>>();
+        source = buffer.Data();
+        length = buffer.Length();
+    } else if (info[0].IsString()) {
+        string = info[0].As<Napi::String>().Utf8Value();
+        source = string.data();
+        length = string.size();
+    } else {
+        throw Napi::TypeError::New(env, "source must be a string or a Buffer");
+    }
+    if (length > UINT32_MAX) {
+        throw Napi::RangeError::New(env, "source is larger than 4 GiB");
+    }
+
+    uint32_t flags = 0;
+    if (info[1].IsObject()) {
+        auto options = info[1].As<Napi::Object>();
+        if (options.Get("named").ToBoolean()) {
+            flags |= TALON_JSON_NAMED;
+        }
+        if (options.Get("text").ToBoolean()) {
+            flags |= TALON_JSON_TEXT;
+        }
+    }
+
+    TSTree *tree = ts_parser_parse_string(env.GetInstanceData<AddonData>()->parser, nullptr, source,
+                                          static_cast<uint32_t>(length));
+    if (tree == nullptr) {
+        throw Napi::Error::New(env, "failed to parse source");
+    }
+    TalonBuffer buffer;
+    talon_buffer_init(&buffer, -1);
+    talon_write_json(&buffer, tree, source, flags);
+    ts_tree_delete(tree);
+    // Leave out the trailing newline.
+    auto result = Napi::String::New(env, buffer.data, buffer.size - 1);
+    talon_buffer_delete(&buffer);
+    return result;
+}
+
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
+    env.SetInstanceData(new AddonData());
     exports["name"] = Napi::String::New(env, "talon");
-    auto language = Napi::External<TSLanguage>::New(env, tree_sitter_talon());
+    auto language = Napi::External<TSLanguage>::New(env, const_cast<TSLanguage *>(tree_sitter_talon()));
     language.TypeTag(&LANGUAGE_TYPE_TAG);
     exports["language"] = language;
+    exports["toJSON"] = Napi::Function::New(env, ToJSON, "toJSON");
     return exports;
 }
 
@@ -0,0 +1,59 @@
+const assert = require("node:assert");
+const { test } = require("node:test");
+
+const talon = require("./index");
+
+const VALID = "app: firefox\n-\ngo <user.letter>: key(enter)\nsettings():\n    speech.timeout = 0.3\n";
+const BROKEN = "app firefox\n-\ngo <user.letter: key(enter\nsettings():\n    speech.timeout =\n";
+
+// Build the JSON of the cursor's node by recursing over a tree from the
+// tree-sitter package. The sources are ASCII, so its offsets are bytes.
+function referenceJSON(cursor, source, named, text) {
+  const node = cursor.currentNode;
+  const result = { type: cursor.nodeType, named: cursor.nodeIsNamed };
+  const field = cursor.currentFieldName;
+  if (field) {
+    result.field = field;
+  }
+  if (cursor.nodeIsMissing) {
+    result.missing = true;
+  }
+  result.start = cursor.startIndex;
+  result.end = cursor.endIndex;
+  if (text && (named ? node.namedChildCount : node.childCount) === 0) {
+    result.text = source.slice(cursor.startIndex, cursor.endIndex);
+  }
+  const children = [];
+  if (cursor.gotoFirstChild()) {
+    do {
+      if (!named || cursor.nodeIsNamed) {
+        children.push(referenceJSON(cursor, source, named, text));
+      }
+    } while (cursor.gotoNextSibling());
+    cursor.gotoParent();
+  }
+  if (children.length > 0) {
+    result.children = children;
+  }
+  return result;
+}
+
+function hasError(node) {
+  return node.type === "ERROR" || node.missing === true || (node.children ?? []).some(hasError);
+}
+
+test("toJSON matches a walk of the tree-sitter package's tree", () => {
+  const Parser = require("tree-sitter");
+  const parser = new Parser();
+  parser.setLanguage(talon);
+  for (const [source, error] of [[VALID, false], [BROKEN, true]]) {
+    for (const named of [false, true]) {
+      for (const text of [false, true]) {
+        const expected = referenceJSON(parser.parse(source).walk(), source, named, text);
+        assert.strictEqual(hasError(expected), error);
+        assert.deepStrictEqual(JSON.parse(talon.toJSON(source, { named, text })), expected);
+        assert.deepStrictEqual(JSON.parse(talon.toJSON(Buffer.from(source), { named, text })), expected);
+      }
+    }
+  }
+});
@@ -18,10 +18,19 @@ type NodeInfo =
       children: ChildNode[];
     });
 
+type JSONOptions = {
+  /** Leave out anonymous nodes. */
+  named?: boolean;
+  /** Give leaf nodes a "text" key holding their source text. */
+  text?: boolean;
+};
+
 type Language = {
   name: string;
   language: unknown;
   nodeTypeInfo: NodeInfo[];
+  /** Parse source natively and serialise its tree as a JSON string. */
+  toJSON(source: string | Buffer, options?: JSONOptions): string;
 };
 
 declare const language: Language;
@@ -0,0 +1,102 @@
+import json
+from importlib.util import find_spec
+from tempfile import TemporaryFile
+from unittest import TestCase, main, skipUnless
+
+import tree_sitter_talon
+
+HEADER_ONLY = b"not tag: user.terminal\n-\n"
+COMMANDS_ONLY = b"go: key(enter)\n"
+VALID = b"app: firefox\n-\ngo <user.letter>: key(enter)\nsettings():\n    speech.timeout = 0.3\n"
+BROKEN = b"app firefox\n-\ngo <user.letter: key(enter\nsettings():\n    speech.timeout =\n"
+
+
+def reference_json(node, field, source, named, text):
+    """Build the JSON of a node by recursing over a py-tree-sitter tree."""
+    result = {"type": node.type, "named": node.is_named}
+    if field is not None:
+        result["field"] = field
+    if node.is_missing:
+        result["missing"] = True
+    result["start"], result["end"] = node.start_byte, node.end_byte
+    if text and (node.named_child_count if named else node.child_count) == 0:
+        result["text"] = source[node.start_byte:node.end_byte].decode("utf-8")
+    children = [
+        reference_json(child, node.field_name_for_child(i), source, named, text)
+        for i, child in enumerate(node.children)
+        if child.is_named or not named
+    ]
+    if children:
+        result["children"] = children
+    return result
+
+
+class TestExtract(TestCase):
+    def test_header_only(self):
+        records = tree_sitter_talon.extract(HEADER_ONLY)
+        self.assertEqual(records.commands, [])
+        self.assertEqual(len(records.matches), 1)
+        modifiers, left, right, _, _ = records.matches[0]
+        self.assertEqual((modifiers, left, right.strip()), (("not",), "tag", "user.terminal"))
+
+    def test_commands_only(self):
+        records = tree_sitter_talon.extract(COMMANDS_ONLY)
+        self.assertEqual(records.matches, [])
+        self.assertEqual(records.settings, [])
+        self.assertEqual(records.tag_imports, [])
+        self.assertEqual(records.commands[0][:3], ("go", 0, 2))
+
+    def test_packed_header_only(self):
+        records = tree_sitter_talon.extract(HEADER_ONLY, packed=True)
+        self.assertEqual(records.commands.tolist(), [])
+        self.assertEqual(records.settings.tolist(), [])
+        self.assertEqual(records.tag_imports.tolist(), [])
+        self.assertEqual(len(records.matches), 5)
+        self.assertEqual(records.matches[0], tree_sitter_talon.MATCH_NOT)
+        self.assertEqual(records.matches[1:3].tolist(), [4, 7])
+
+    def test_packed_commands_only(self):
+        records = tree_sitter_talon.extract(COMMANDS_ONLY, packed=True)
+        self.assertEqual(records.matches.tolist(), [])
+        self.assertEqual(records.settings.tolist(), [])
+        self.assertEqual(records.tag_imports.tolist(), [])
+        self.assertEqual(records.commands[:2].tolist(), [0, 2])
+
+    def test_packed_matches_unpacked(self):
+        for source in (HEADER_ONLY, COMMANDS_ONLY, b""):
+            unpacked = tree_sitter_talon.extract(source)
+            packed = tree_sitter_talon.extract(source, packed=True)
+            self.assertEqual(len(packed.commands), 4 * len(unpacked.commands))
+            self.assertEqual(len(packed.matches), 5 * len(unpacked.matches))
+
+
+class TestToJSON(TestCase):
+    def test_bytes(self):
+        tree = json.loads(tree_sitter_talon.to_json(COMMANDS_ONLY, named=True, text=True))
+        self.assertEqual(tree["type"], "source_file")
+        self.assertEqual((tree["start"], tree["end"]), (0, len(COMMANDS_ONLY)))
+        self.assertTrue(all(child["named"] for child in tree["children"]))
+
+    def test_file(self):
+        with TemporaryFile() as file:
+            self.assertIsNone(tree_sitter_talon.to_json(HEADER_ONLY, file=file))
+            file.seek(0)
+            tree = json.loads(file.read())
+        self.assertEqual(tree["children"][0]["type"], "matches")
+
+    @skipUnless(find_spec("tree_sitter"), "needs the core extra")
+    def test_matches_reference(self):
+        for source, has_error in ((VALID, False), (BROKEN, True)):
+            root = tree_sitter_talon.parse(source).root_node
+            self.assertEqual(root.has_error, has_error)
+            for named in (False, True):
+                for text in (False, True):
+                    with self.subTest(source=source, named=named, text=text):
+                        self.assertEqual(
+                            json.loads(tree_sitter_talon.to_json(source, named=named, text=text)),
+                            reference_json(root, None, source, named, text),
+                        )
+
+
+if __name__ == "__main__":
+    main()
@@ -1,5 +1,117 @@
 "Talon grammar for tree-sitter"
 
+from collections import namedtuple
+from mmap import ACCESS_READ, mmap
+from threading import local
+
+from . import _binding
 from ._binding import language
 
-__all__ = ["language"]
+__all__ = [
+    "language",
+    "get_parser",
+    "parse",
+    "parse_file",
+    "extract",
+    "to_json",
+    "Records",
+    "MATCH_AND",
+    "MATCH_NOT",
+]
+
+# Flags for the match modifiers in packed match records.
+MATCH_AND = 1 << 0
+MATCH_NOT = 1 << 1
+
+Records = namedtuple("Records", ["commands", "matches", "settings", "tag_imports"])
+
+_thread_local = local()
+
+
+def get_parser():
+    """Get this thread's cached tree-sitter parser for Talon.
+
+    Each thread gets its own parser, created on first use, so threads can
+    parse concurrently without sharing or re-creating parsers.
+    """
+    parser = getattr(_thread_local, "parser", None)
+    if parser is None:
+        from tree_sitter import Language, Parser
+
+        parser = _thread_local.parser = Parser(Language(language()))
+    return parser
+
+
+def parse(source, old_tree=None):
+    """Parse UTF-8 encoded Talon source.
+
+    The source may be any object that supports the buffer protocol, such as
+    bytes, bytearray, memoryview or mmap.mmap. It is handed to the parser as
+    is, so node byte offsets index directly into the original buffer.
+    """
+    if isinstance(source, str):
+        source = source.encode("utf-8")
+    return get_parser().parse(source, old_tree)
+
+
+def parse_file(path):
+    """Memory-map the Talon file at path and parse it without copying.
+
+    Returns a (tree, source) pair, where source is the read-only mapping that
+    node byte offsets refer to. Keep it alive for as long as they are used.
+    """
+    with open(path, "rb") as file:
+        try:
+            source = mmap(file.fileno(), 0, access=ACCESS_READ)
+        except ValueError:
+            # Empty files cannot be mapped.
+            source = b""
+    return parse(source), source
+
+
+def extract(source, packed=False):
+    """Parse Talon source and extract its records in a single native pass.
+
+    The parse runs on a per-thread native parser without holding the GIL, on
+    the tree-sitter runtime bundled with the extension, so it needs neither
+    the tree-sitter package nor a system library. Returns Records of
+    commands, matches, settings and tag imports. Each record is a tuple:
+
+    - command: (rule, rule_start, rule_end, body_start, body_end)
+    - match: (modifiers, left, right, start, end)
+    - setting: (name, value, name_start, name_end, value_start, value_end)
+    - tag import: (name, start, end)
+
+    With packed=True, each field of Records is instead a flat memoryview of
+    uint32 byte offsets, which numpy can view without copying, with rows of:
+
+    - command: rule_start, rule_end, body_start, body_end
+    - match: modifier flags, left_start, left_end, right_start, right_end
+    - setting: name_start, name_end, value_start, value_end
+    - tag import: start, end
+    """
+    if isinstance(source, str):
+        source = source.encode("utf-8")
+    records = _binding.extract(source, packed)
+    if packed:
+        records = (memoryview(column).cast("I") for column in records)
+    return Records(*records)
+
+
+def to_json(source, named=False, text=False, file=None):
+    """Parse Talon source and serialise its tree as JSON in native code.
+
+    Each node is an object with "type", "named", "start" and "end" keys, a
+    "field" key if it is the value of a field, and a "children" array if it
+    has children. With named=True, anonymous nodes are left out, and with
+    text=True, leaves get a "text" key holding their source text.
+
+    Returns the JSON as UTF-8 encoded bytes, or if file is given, streams it
+    to the file's descriptor and returns None.
+    """
+    if isinstance(source, str):
+        source = source.encode("utf-8")
+    if file is None:
+        return _binding.to_json(source, named, text)
+    file.flush()
+    _binding.to_json(source, named, text, file.fileno())
@@ -1 +1,42 @@
+from mmap import mmap
+from os import PathLike
+from typing import IO, List, Literal, NamedTuple, Optional, Tuple, Union, overload
+
+from tree_sitter import Parser, Tree
+
+_Buffer = Union[bytes, bytearray, memoryview, mmap]
+
+MATCH_AND: int
+MATCH_NOT: int
+
+_Command = Tuple[str, int, int, int, int]
+_Match = Tuple[Tuple[str, ...], str, str, int, int]
+_Setting = Tuple[str, str, int, int, int, int]
+_TagImport = Tuple[str, int, int]
+
+class Records(NamedTuple):
+    commands: List[_Command]
+    matches: List[_Match]
+    settings: List[_Setting]
+    tag_imports: List[_TagImport]
+
+class PackedRecords(NamedTuple):
+    commands: memoryview
+    matches: memoryview
+    settings: memoryview
+    tag_imports: memoryview
+
 def language() -> int: ...
+def get_parser() -> Parser: ...
+def parse(source: Union[_Buffer, str], old_tree: Optional[Tree] = None) -> Tree: ...
+def parse_file(path: Union[str, PathLike]) -> Tuple[Tree, Union[mmap, bytes]]: ...
+@overload
+def extract(source: Union[_Buffer, str], packed: Literal[False] = False) -> Records: ...
+@overload
+def extract(source: Union[_Buffer, str], packed: Literal[True]) -> PackedRecords: ...
+@overload
+def to_json(
+    source: Union[_Buffer, str], named: bool = False, text: bool = False, file: None = None
+) -> bytes: ...
+@overload
+def to_json(source: Union[_Buffer, str], named: bool = False, text: bool = False, *, file: IO) -> None: ...
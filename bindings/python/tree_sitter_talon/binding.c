@@ -1,16 +1,223 @@
 #include <Python.h>
+#include <tree_sitter/api.h>
 
-typedef struct TSLanguage TSLanguage;
+#include "talon.h"
 
-TSLanguage *tree_sitter_talon(void);
+const TSLanguage *tree_sitter_talon(void);
 
-static PyObject* _binding_language(PyObject *self, PyObject *args) {
-    return PyLong_FromVoidPtr(tree_sitter_talon());
+// Each thread parses with its own parser, which lives in the thread state
+// dictionary so that it is deleted when the thread exits.
+static const char PARSER_KEY[] = "tree_sitter_talon._binding.parser";
+
+static PyObject *text(const TalonFile *file, uint32_t start, uint32_t end) {
+    return PyUnicode_DecodeUTF8(file->source + start, end - start, "replace");
+}
+
+static PyObject *modifier_names(uint32_t flags) {
+    if (flags == (TALON_MATCH_AND | TALON_MATCH_NOT)) {
+        return Py_BuildValue("(ss)", "and", "not");
+    }
+    if (flags == TALON_MATCH_AND) {
+        return Py_BuildValue("(s)", "and");
+    }
+    if (flags == TALON_MATCH_NOT) {
+        return Py_BuildValue("(s)", "not");
+    }
+    return PyTuple_New(0);
+}
+
+// Build a list by converting count records with convert.
+static PyObject *record_list(const TalonFile *file, const void *records, uint32_t count, size_t size,
+                             PyObject *(*convert)(const TalonFile *, const void *)) {
+    PyObject *list = PyList_New(count);
+    for (uint32_t i = 0; list != NULL && i < count; i++) {
+        PyObject *record = convert(file, (const char *)records + i * size);
+        if (record == NULL) {
+            Py_CLEAR(list);
+        } else {
+            PyList_SetItem(list, i, record);
+        }
+    }
+    return list;
+}
+
+static PyObject *command_tuple(const TalonFile *file, const void *record) {
+    const TalonCommand *command = record;
+    return Py_BuildValue("(NIIII)", text(file, command->rule_start, command->rule_end),
+                         command->rule_start, command->rule_end, command->body_start, command->body_end);
+}
+
+static PyObject *match_tuple(const TalonFile *file, const void *record) {
+    const TalonMatch *match = record;
+    return Py_BuildValue("(NNNII)", modifier_names(match->modifiers),
+                         text(file, match->left_start, match->left_end),
+                         text(file, match->right_start, match->right_end),
+                         match->left_start, match->right_end);
+}
+
+static PyObject *setting_tuple(const TalonFile *file, const void *record) {
+    const TalonSetting *setting = record;
+    return Py_BuildValue("(NNIIII)", text(file, setting->name_start, setting->name_end),
+                         text(file, setting->value_start, setting->value_end),
+                         setting->name_start, setting->name_end, setting->value_start, setting->value_end);
+}
+
+static PyObject *tag_import_tuple(const TalonFile *file, const void *record) {
+    const TalonTagImport *tag_import = record;
+    return Py_BuildValue("(NII)", text(file, tag_import->start, tag_import->end),
+                         tag_import->start, tag_import->end);
+}
+
+// Records are structs of uint32 fields, so packed columns are their bytes.
+// A file without records of a kind has a NULL column, which y# would turn
+// into None, so each column is built as bytes, empty if need be.
+static PyObject *packed_column(const void *records, uint32_t count, size_t size) {
+    return PyBytes_FromStringAndSize(count > 0 ? records : "", (Py_ssize_t)(count * size));
+}
+
+static PyObject *packed_records(const TalonFile *file) {
+    return Py_BuildValue("(NNNN)", packed_column(file->commands, file->command_count, sizeof(TalonCommand)),
+                         packed_column(file->matches, file->match_count, sizeof(TalonMatch)),
+                         packed_column(file->settings, file->setting_count, sizeof(TalonSetting)),
+                         packed_column(file->tag_imports, file->tag_import_count, sizeof(TalonTagImport)));
+}
+
+static PyObject *records(const TalonFile *file) {
+    return Py_BuildValue(
+        "(NNNN)",
+        record_list(file, file->commands, file->command_count, sizeof(TalonCommand), command_tuple),
+        record_list(file, file->matches, file->match_count, sizeof(TalonMatch), match_tuple),
+        record_list(file, file->settings, file->setting_count, sizeof(TalonSetting), setting_tuple),
+        record_list(file, file->tag_imports, file->tag_import_count, sizeof(TalonTagImport),
+                    tag_import_tuple));
+}
+
+static void parser_capsule_destructor(PyObject *capsule) {
+    ts_parser_delete(PyCapsule_GetPointer(capsule, PARSER_KEY));
+}
+
+static TSParser *thread_parser(void) {
+    PyObject *dict = PyThreadState_GetDict();
+    if (dict == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "no thread state dictionary");
+        return NULL;
+    }
+    PyObject *capsule = PyDict_GetItemString(dict, PARSER_KEY);
+    if (capsule != NULL) {
+        return PyCapsule_GetPointer(capsule, PARSER_KEY);
+    }
+
+    TSParser *parser = talon_parser_new();
+    if (parser == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "failed to load the talon language");
+        return NULL;
+    }
+    capsule = PyCapsule_New(parser, PARSER_KEY, parser_capsule_destructor);
+    if (capsule == NULL) {
+        ts_parser_delete(parser);
+        return NULL;
+    }
+    int result = PyDict_SetItemString(dict, PARSER_KEY, capsule);
+    Py_DECREF(capsule);
+    return result < 0 ? NULL : parser;
+}
+
+static PyObject *_binding_language(PyObject *self, PyObject *args) {
+    return PyLong_FromVoidPtr((void *)tree_sitter_talon());
+}
+
+static PyObject *_binding_extract(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"source", "packed", NULL};
+    Py_buffer source;
+    int packed = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "y*|p:extract", keywords, &source, &packed)) {
+        return NULL;
+    }
+    if (source.len > UINT32_MAX) {
+        PyBuffer_Release(&source);
+        PyErr_SetString(PyExc_ValueError, "source is larger than 4 GiB");
+        return NULL;
+    }
+
+    TSParser *parser = thread_parser();
+    if (parser == NULL) {
+        PyBuffer_Release(&source);
+        return NULL;
+    }
+
+    // The buffer stays exported until it is released, so it cannot be
+    // resized while other threads run.
+    TalonFile *file;
+    Py_BEGIN_ALLOW_THREADS
+    file = talon_parse_string(parser, source.buf, (uint32_t)source.len);
+    Py_END_ALLOW_THREADS
+    if (file == NULL) {
+        PyBuffer_Release(&source);
+        PyErr_SetString(PyExc_RuntimeError, "failed to parse source");
+        return NULL;
+    }
+
+    PyObject *result = packed ? packed_records(file) : records(file);
+    talon_file_delete(file);
+    PyBuffer_Release(&source);
+    return result;
+}
+
+static PyObject *_binding_to_json(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"source", "named", "text", "fd", NULL};
+    Py_buffer source;
+    int named = 0, text = 0, fd = -1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "y*|ppi:to_json", keywords, &source, &named, &text, &fd)) {
+        return NULL;
+    }
+    if (source.len > UINT32_MAX) {
+        PyBuffer_Release(&source);
+        PyErr_SetString(PyExc_ValueError, "source is larger than 4 GiB");
+        return NULL;
+    }
+
+    TSParser *parser = thread_parser();
+    if (parser == NULL) {
+        PyBuffer_Release(&source);
+        return NULL;
+    }
+
+    uint32_t flags = (named ? TALON_JSON_NAMED : 0) | (text ? TALON_JSON_TEXT : 0);
+    TalonBuffer buffer;
+    talon_buffer_init(&buffer, fd);
+    TSTree *tree;
+    bool ok = false;
+    Py_BEGIN_ALLOW_THREADS
+    tree = ts_parser_parse_string(parser, NULL, source.buf, (uint32_t)source.len);
+    if (tree != NULL) {
+        ok = talon_write_json(&buffer, tree, source.buf, flags);
+        ts_tree_delete(tree);
+    }
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&source);
+
+    PyObject *result = NULL;
+    if (tree == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "failed to parse source");
+    } else if (!ok) {
+        PyErr_SetFromErrno(PyExc_OSError);
+    } else if (fd < 0) {
+        result = PyBytes_FromStringAndSize(buffer.data, (Py_ssize_t)buffer.size);
+    } else {
+        result = Py_None;
+        Py_INCREF(result);
+    }
+    talon_buffer_delete(&buffer);
+    return result;
 }
 
 static PyMethodDef methods[] = {
     {"language", _binding_language, METH_NOARGS,
      "Get the tree-sitter language for this grammar."},
+    {"extract", (PyCFunction)(void (*)(void))_binding_extract, METH_VARARGS | METH_KEYWORDS,
+     "Parse a buffer and extract its commands, matches, settings and tag imports."},
+    {"to_json", (PyCFunction)(void (*)(void))_binding_to_json, METH_VARARGS | METH_KEYWORDS,
+     "Parse a buffer and write its tree as JSON, to a file descriptor or as bytes."},
     {NULL, NULL, 0, NULL}
 };
 
@@ -23,5 +230,13 @@ static struct PyModuleDef module = {
 };
 
 PyMODINIT_FUNC PyInit__binding(void) {
-    return PyModule_Create(&module);
+    PyObject *m = PyModule_Create(&module);
+#ifdef Py_GIL_DISABLED
+    // The module has no mutable state and parsers are per
+    // thread, so the module is safe to use without the GIL.
+    if (m != NULL) {
+        PyUnstable_Module_SetGIL(m, Py_MOD_GIL_NOT_USED);
+    }
+#endif
+    return m;
 }
@@ -1,5 +1,9 @@
+use std::collections::BTreeMap;
+use std::fmt::Write as _;
+use std::path::Path;
+
 fn main() {
-    let src_dir = std::path::Path::new("src");
+    let src_dir = Path::new("src");
 
     let mut c_config = cc::Build::new();
     c_config.include(&src_dir);
@@ -13,29 +17,399 @@ fn main() {
     let parser_path = src_dir.join("parser.c");
     c_config.file(&parser_path);
 
-    // If your language uses an external scanner written in C,
-    // then include this block of code:
-
-    /*
     let scanner_path = src_dir.join("scanner.c");
     c_config.file(&scanner_path);
     println!("cargo:rerun-if-changed={}", scanner_path.to_str().unwrap());
-    */
 
     c_config.compile("parser");
     println!("cargo:rerun-if-changed={}", parser_path.to_str().unwrap());
 
-    // If your language uses an external scanner written in C++,
-    // then include this block of code:
+    let node_types_path = src_dir.join("node-types.json");
+    let out_dir = std::env::var("OUT_DIR").unwrap();
+    let ast = generate_ast(&node_types_path, &parser_path);
+    std::fs::write(Path::new(&out_dir).join("ast.rs"), ast).unwrap();
+    println!(
+        "cargo:rerun-if-changed={}",
+        node_types_path.to_str().unwrap()
+    );
+}
 
-    let mut cpp_config = cc::Build::new();
-    cpp_config.cpp(true);
-    cpp_config.include(&src_dir);
-    cpp_config
-        .flag_if_supported("-Wno-unused-parameter")
-        .flag_if_supported("-Wno-unused-but-set-variable");
-    let scanner_path = src_dir.join("scanner.c");
-    cpp_config.file(&scanner_path);
-    cpp_config.compile("scanner");
-    println!("cargo:rerun-if-changed={}", scanner_path.to_str().unwrap());
+/// Generate typed wrappers for the named node types in `node-types.json`.
+///
+/// Symbol and field ids are read from the enums in `parser.c`, so that the
+/// wrappers can compare them as constants rather than looking up names.
+fn generate_ast(node_types_path: &Path, parser_path: &Path) -> String {
+    let node_types: Vec<serde_json::Value> =
+        serde_json::from_str(&std::fs::read_to_string(node_types_path).unwrap()).unwrap();
+    let parser = std::fs::read_to_string(parser_path).unwrap();
+    let symbols = parse_public_symbols(&parser);
+    let fields = parse_enum(&parser, "ts_field_identifiers");
+
+    let named: Vec<&serde_json::Value> = node_types
+        .iter()
+        .filter(|node_type| node_type["named"].as_bool().unwrap())
+        .collect();
+    let supertypes: Vec<&str> = named
+        .iter()
+        .filter(|node_type| node_type.get("subtypes").is_some())
+        .map(|node_type| node_type["type"].as_str().unwrap())
+        .collect();
+    let is_concrete = |name: &str| !supertypes.contains(&name);
+
+    let mut out = String::new();
+    out.push_str(
+        "// Generated by bindings/rust/build.rs from src/node-types.json. Do not edit.\n\n",
+    );
+    out.push_str("use tree_sitter::{Node, TreeCursor};\n\n");
+
+    // Kind and field id constants.
+    out.push_str("/// The kind ids of the named node types.\npub mod kind {\n");
+    for node_type in &named {
+        let name = node_type["type"].as_str().unwrap();
+        if is_concrete(name) {
+            let id = symbols
+                .get(name)
+                .unwrap_or_else(|| panic!("no symbol id for {}", name));
+            writeln!(out, "    pub const {}: u16 = {};", name.to_uppercase(), id).unwrap();
+        }
+    }
+    out.push_str("}\n\n");
+    out.push_str("/// The field ids of the grammar.\npub mod field {\n");
+    for (name, id) in &fields {
+        let name = name.trim_start_matches("field_");
+        writeln!(out, "    pub const {}: u16 = {};", name.to_uppercase(), id).unwrap();
+    }
+    out.push_str("}\n\n");
+
+    // Name/id pairs, for checking the constants against the language.
+    out.push_str("#[cfg(test)]\npub(crate) const KINDS: &[(&str, u16)] = &[\n");
+    for node_type in &named {
+        let name = node_type["type"].as_str().unwrap();
+        if is_concrete(name) {
+            writeln!(out, "    (\"{}\", kind::{}),", name, name.to_uppercase()).unwrap();
+        }
+    }
+    out.push_str("];\n\n#[cfg(test)]\npub(crate) const FIELDS: &[(&str, u16)] = &[\n");
+    for name in fields.keys() {
+        let name = name.trim_start_matches("field_");
+        writeln!(out, "    (\"{}\", field::{}),", name, name.to_uppercase()).unwrap();
+    }
+    out.push_str("];\n");
+
+    for node_type in &named {
+        let name = node_type["type"].as_str().unwrap();
+        if let Some(subtypes) = node_type.get("subtypes") {
+            generate_supertype(&mut out, name, subtypes, &is_concrete);
+        } else {
+            generate_node(&mut out, name, node_type.get("fields"));
+        }
+    }
+    out
+}
+
+fn generate_node(out: &mut String, name: &str, fields: Option<&serde_json::Value>) {
+    let type_name = wrapper_name(name);
+    write!(
+        out,
+        r#"
+/// A `{name}` node.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct {type_name}<'tree>(Node<'tree>);
+
+impl<'tree> {type_name}<'tree> {{
+    pub const KIND_ID: u16 = kind::{kind};
+
+    /// Wrap `node` if it is a `{name}` node.
+    pub fn cast(node: Node<'tree>) -> Option<Self> {{
+        if node.kind_id() == Self::KIND_ID {{
+            Some(Self(node))
+        }} else {{
+            None
+        }}
+    }}
+
+    /// Get the underlying node.
+    pub fn node(&self) -> Node<'tree> {{
+        self.0
+    }}
+
+    /// Borrow the text of this node from the source it was parsed from.
+    pub fn text<'source>(&self, source: &'source str) -> &'source str {{
+        &source[self.0.byte_range()]
+    }}
+"#,
+        name = name,
+        type_name = type_name,
+        kind = name.to_uppercase(),
+    )
+    .unwrap();
+
+    let fields = fields.and_then(|fields| fields.as_object());
+    for (field_name, field) in fields.into_iter().flatten() {
+        let named_types: Vec<&str> = field["types"]
+            .as_array()
+            .unwrap()
+            .iter()
+            .filter(|field_type| field_type["named"].as_bool().unwrap())
+            .map(|field_type| field_type["type"].as_str().unwrap())
+            .collect();
+        let all_named = named_types.len() == field["types"].as_array().unwrap().len();
+        // Fields of a single named type, including supertypes, are typed.
+        let (item, cast) = if all_named && named_types.len() == 1 {
+            let item = wrapper_name(named_types[0]);
+            let cast = format!("{}::cast", item);
+            (format!("{}<'tree>", item), cast)
+        } else {
+            ("Node<'tree>".to_string(), "Some".to_string())
+        };
+        let field_id = format!("field::{}", field_name.to_uppercase());
+        if field["multiple"].as_bool().unwrap() {
+            write!(
+                out,
+                r#"
+    /// Iterate over the children in the `{field_name}` field.
+    pub fn {field_name}<'cursor>(
+        &self,
+        cursor: &'cursor mut TreeCursor<'tree>,
+    ) -> impl Iterator<Item = {item}> + 'cursor {{
+        self.0.children_by_field_id({field_id}, cursor).filter_map({cast})
+    }}
+"#,
+                field_name = field_name,
+                item = item,
+                field_id = field_id,
+                cast = cast,
+            )
+            .unwrap();
+        } else {
+            write!(
+                out,
+                r#"
+    /// Get the child in the `{field_name}` field.
+    pub fn {field_name}(&self) -> Option<{item}> {{
+        self.0.child_by_field_id({field_id}).and_then({cast})
+    }}
+"#,
+                field_name = field_name,
+                item = item,
+                field_id = field_id,
+                cast = cast,
+            )
+            .unwrap();
+        }
+    }
+    out.push_str("}\n");
+}
+
+fn generate_supertype(
+    out: &mut String,
+    name: &str,
+    subtypes: &serde_json::Value,
+    is_concrete: &dyn Fn(&str) -> bool,
+) {
+    let type_name = wrapper_name(name);
+    let subtypes: Vec<&str> = subtypes
+        .as_array()
+        .unwrap()
+        .iter()
+        .filter(|subtype| subtype["named"].as_bool().unwrap())
+        .map(|subtype| subtype["type"].as_str().unwrap())
+        .collect();
+
+    write!(
+        out,
+        "\n/// A `{}` node, which is one of its subtypes.\n#[derive(Clone, Copy, Debug, PartialEq, Eq)]\npub enum {}<'tree> {{\n",
+        name, type_name
+    )
+    .unwrap();
+    for subtype in &subtypes {
+        writeln!(out, "    {0}({0}<'tree>),", wrapper_name(subtype)).unwrap();
+    }
+    write!(
+        out,
+        "}}\n\nimpl<'tree> {}<'tree> {{\n    /// Wrap `node` if it is one of the subtypes of `{}`.\n    pub fn cast(node: Node<'tree>) -> Option<Self> {{\n        match node.kind_id() {{\n",
+        type_name, name
+    )
+    .unwrap();
+    for subtype in subtypes.iter().filter(|subtype| is_concrete(subtype)) {
+        writeln!(
+            out,
+            "            kind::{} => Some({}::{}({}(node))),",
+            subtype.to_uppercase(),
+            type_name,
+            wrapper_name(subtype),
+            wrapper_name(subtype)
+        )
+        .unwrap();
+    }
+    let nested: Vec<&&str> = subtypes
+        .iter()
+        .filter(|subtype| !is_concrete(subtype))
+        .collect();
+    if nested.is_empty() {
+        out.push_str("            _ => None,\n");
+    } else {
+        out.push_str("            _ => None");
+        for subtype in nested {
+            write!(
+                out,
+                "\n                .or_else(|| {0}::cast(node).map({1}::{0}))",
+                wrapper_name(subtype),
+                type_name
+            )
+            .unwrap();
+        }
+        out.push_str(",\n");
+    }
+    out.push_str("        }\n    }\n\n    /// Get the underlying node.\n    pub fn node(&self) -> Node<'tree> {\n        match self {\n");
+    for subtype in &subtypes {
+        writeln!(
+            out,
+            "            {}::{}(node) => node.node(),",
+            type_name,
+            wrapper_name(subtype)
+        )
+        .unwrap();
+    }
+    out.push_str(
+        r#"        }
+    }
+
+    /// Borrow the text of this node from the source it was parsed from.
+    pub fn text<'source>(&self, source: &'source str) -> &'source str {
+        &source[self.node().byte_range()]
+    }
+}
+"#,
+    );
+}
+
+/// Find the public symbol id of each visible, named node type in `parser.c`,
+/// the same way as `ts_language_symbol_for_name` does at runtime.
+fn parse_public_symbols(parser: &str) -> BTreeMap<String, u16> {
+    let ids = parse_enum(parser, "ts_symbol_identifiers");
+    let symbol_map: BTreeMap<String, String> =
+        parse_entries(parser, "static const TSSymbol ts_symbol_map[] = {")
+            .into_iter()
+            .collect();
+
+    // Collect the symbols whose metadata marks them as both visible and named.
+    let mut named = Vec::new();
+    let mut current = None;
+    let mut visible = false;
+    for line in block_lines(
+        parser,
+        "static const TSSymbolMetadata ts_symbol_metadata[] = {",
+    ) {
+        let line = line.trim();
+        if let Some(symbol) = line
+            .strip_prefix('[')
+            .and_then(|line| line.split(']').next())
+        {
+            current = Some(symbol);
+        } else if line == ".visible = true," {
+            visible = true;
+        } else if line == ".named = true," && visible {
+            named.extend(current);
+        } else if line == "}," {
+            visible = false;
+        }
+    }
+
+    let mut symbols = BTreeMap::new();
+    for (symbol, name) in parse_entries(parser, "static const char * const ts_symbol_names[] = {") {
+        let name = name.trim_matches('"').to_string();
+        if !named.contains(&symbol.as_str()) || symbols.contains_key(&name) {
+            continue;
+        }
+        if let Some(&id) = symbol_map.get(&symbol).and_then(|public| ids.get(public)) {
+            symbols.insert(name, id);
+        }
+    }
+    symbols
+}
+
+/// Parse the `[symbol] = value,` entries of an array in `parser.c`.
+fn parse_entries(parser: &str, header: &str) -> Vec<(String, String)> {
+    block_lines(parser, header)
+        .filter_map(|line| {
+            let (symbol, value) = line.trim().trim_end_matches(',').split_once(" = ")?;
+            let symbol = symbol.strip_prefix('[')?.strip_suffix(']')?;
+            Some((symbol.to_string(), value.to_string()))
+        })
+        .collect()
+}
+
+/// Iterate over the lines of the top-level block in `parser.c` that starts with `header`.
+fn block_lines<'a>(parser: &'a str, header: &str) -> impl Iterator<Item = &'a str> {
+    let start = parser
+        .find(header)
+        .unwrap_or_else(|| panic!("no `{}` in parser.c", header));
+    parser[start..]
+        .lines()
+        .skip(1)
+        .take_while(|line| !line.starts_with('}'))
+}
+
+/// Parse the `name = id` entries of an enum in `parser.c`.
+fn parse_enum(parser: &str, enum_name: &str) -> BTreeMap<String, u16> {
+    block_lines(parser, &format!("enum {} {{", enum_name))
+        .filter_map(|line| {
+            let (name, id) = line.trim().trim_end_matches(',').split_once(" = ")?;
+            Some((name.to_string(), id.parse().ok()?))
+        })
+        .collect()
+}
+
+/// Names that the generated module uses or that the prelude brings into scope, which a
+/// wrapper type must not shadow.
+const RESERVED_TYPE_NAMES: &[&str] = &[
+    "Box",
+    "Clone",
+    "Copy",
+    "Default",
+    "Drop",
+    "Eq",
+    "Err",
+    "Fn",
+    "From",
+    "Into",
+    "Iterator",
+    "Node",
+    "None",
+    "Ok",
+    "Option",
+    "Ord",
+    "Result",
+    "Send",
+    "Sized",
+    "Some",
+    "String",
+    "Sync",
+    "ToString",
+    "TreeCursor",
+    "Vec",
+];
+
+/// Get the name of the wrapper type of a node type, in camel case, with a `Node` suffix if it
+/// would shadow a reserved name, so that `string` becomes `StringNode`.
+fn wrapper_name(name: &str) -> String {
+    let type_name = camel_case(name);
+    if RESERVED_TYPE_NAMES.contains(&type_name.as_str()) {
+        type_name + "Node"
+    } else {
+        type_name
+    }
+}
+
+fn camel_case(name: &str) -> String {
+    name.split('_')
+        .map(|part| {
+            let mut chars = part.chars();
+            match chars.next() {
+                Some(first) => first.to_uppercase().chain(chars).collect(),
+                None => String::new(),
+            }
+        })
+        .collect()
 }
@@ -0,0 +1,29 @@
+//! Measure the time to the first parsed tree with the Rust crate.
+//!
+//! Usage: cargo run --release --example startup -- FILE
+//!
+//! Prints the time each step took as JSON, like `tools/talon-startup`. The
+//! grammar is linked statically, so there is no separate load step.
+
+use std::time::Instant;
+
+fn main() {
+    let path = std::env::args().nth(1).expect("usage: startup FILE");
+    let source = std::fs::read(&path).expect("cannot read file");
+
+    let start = Instant::now();
+    let mut parser = tree_sitter::Parser::new();
+    parser
+        .set_language(tree_sitter_talon::language())
+        .expect("Error loading talon grammar");
+    let constructed = Instant::now();
+
+    parser.parse(&source, None).unwrap();
+    let parsed = Instant::now();
+
+    println!(
+        "{{\"load_ms\":0,\"language_ms\":{:.6},\"parse_ms\":{:.6}}}",
+        (constructed - start).as_secs_f64() * 1e3,
+        (parsed - constructed).as_secs_f64() * 1e3
+    );
+}
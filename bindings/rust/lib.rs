@@ -10,6 +10,24 @@
 //! let tree = parser.parse(code, None).unwrap();
 //! ```
 //!
+//! The [ast][] module wraps the named node types of the grammar in typed structs, generated
+//! from `node-types.json`, with a `Node` suffix where a name would shadow a prelude type, as in
+//! `StringNode`. They compare kind and field ids against constants, and borrow their text from
+//! the source buffer:
+//!
+//! ```
+//! use tree_sitter_talon::ast;
+//!
+//! let code = "hello world: key(enter)\n";
+//! let mut parser = tree_sitter::Parser::new();
+//! parser.set_language(tree_sitter_talon::language()).unwrap();
+//! let tree = parser.parse(code, None).unwrap();
+//! let declarations = tree.root_node().named_child(0).unwrap();
+//! let command = ast::CommandDeclaration::cast(declarations.named_child(0).unwrap()).unwrap();
+//! assert_eq!(command.left().unwrap().text(code), "hello world");
+//! ```
+//!
+//! [ast]: ast/index.html
 //! [Language]: https://docs.rs/tree-sitter/*/tree_sitter/struct.Language.html
 //! [language func]: fn.language.html
 //! [Parser]: https://docs.rs/tree-sitter/*/tree_sitter/struct.Parser.html
@@ -33,6 +51,14 @@ pub fn language() -> Language {
 /// [`node-types.json`]: https://tree-sitter.github.io/tree-sitter/using-parsers#static-node-types
 pub const NODE_TYPES: &'static str = include_str!("../../src/node-types.json");
 
+/// Typed wrappers for the named node types of this grammar.
+pub mod ast {
+    include!(concat!(env!("OUT_DIR"), "/ast.rs"));
+}
+
+#[cfg(feature = "workspace")]
+pub mod workspace;
+
 // Uncomment these to include any queries that this grammar contains
 
 // pub const HIGHLIGHTS_QUERY: &'static str = include_str!("../../queries/highlights.scm");
@@ -49,4 +75,55 @@ mod tests {
             .set_language(super::language())
             .expect("Error loading talon language");
     }
+
+    #[test]
+    fn test_ast_ids_match_language() {
+        let language = super::language();
+        for &(name, id) in super::ast::KINDS {
+            assert_eq!(language.id_for_node_kind(name, true), id, "kind {}", name);
+        }
+        for &(name, id) in super::ast::FIELDS {
+            assert_eq!(language.field_id_for_name(name), Some(id), "field {}", name);
+        }
+    }
+
+    #[test]
+    fn test_ast_does_not_shadow_prelude() {
+        // A glob import takes precedence over the prelude, so this only compiles if no wrapper
+        // is named like a prelude type, as `string` nodes would be.
+        #[allow(unused_imports)]
+        use super::ast::*;
+
+        let name: Option<String> = Some(String::from("string"));
+        let language = super::language();
+        assert_eq!(
+            language.id_for_node_kind(name.as_deref().unwrap(), true),
+            StringNode::KIND_ID
+        );
+    }
+
+    #[test]
+    fn test_ast_borrows_source() {
+        use super::ast;
+
+        let code = "tag: user.terminal\n-\ngo <user.letter>: key(enter)\n";
+        let mut parser = tree_sitter::Parser::new();
+        parser.set_language(super::language()).unwrap();
+        let tree = parser.parse(code, None).unwrap();
+        let root = ast::SourceFile::cast(tree.root_node()).unwrap();
+
+        let matches = ast::Matches::cast(root.node().named_child(0).unwrap()).unwrap();
+        let context = ast::Match::cast(matches.node().named_child(0).unwrap()).unwrap();
+        assert_eq!(context.left().unwrap().text(code), "tag");
+        assert_eq!(context.right().unwrap().text(code), "user.terminal");
+
+        let declarations = ast::Declarations::cast(root.node().named_child(1).unwrap()).unwrap();
+        let declaration = ast::Declaration::cast(declarations.node().named_child(0).unwrap());
+        let command = match declaration {
+            Some(ast::Declaration::CommandDeclaration(command)) => command,
+            other => panic!("expected a command declaration, got {:?}", other),
+        };
+        assert_eq!(command.left().unwrap().text(code), "go <user.letter>");
+        assert_eq!(command.right().unwrap().text(code).trim(), "key(enter)");
+    }
 }
@@ -0,0 +1,257 @@
+//! Parallel parsing of a directory tree of `.talon` files.
+//!
+//! [parse_workspace][] finds every `.talon` file under a root directory, memory-maps it, and
+//! parses the files in parallel, with one reused [Parser][] per worker thread. Calling
+//! [Workspace::refresh][] later only re-parses the files whose contents have changed.
+//!
+//! Since the files are mapped, they should be replaced, such as by renaming a new file over
+//! them, rather than truncated and rewritten in place while the workspace holds them.
+//!
+//! [Parser]: https://docs.rs/tree-sitter/*/tree_sitter/struct.Parser.html
+
+use std::collections::hash_map::DefaultHasher;
+use std::collections::BTreeMap;
+use std::hash::Hasher;
+use std::io;
+use std::ops::Deref;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::Mutex;
+
+use memmap2::Mmap;
+use tree_sitter::{Parser, Tree};
+
+/// The parsed `.talon` files under a root directory.
+pub struct Workspace {
+    root: PathBuf,
+    files: BTreeMap<PathBuf, File>,
+    parsers: Mutex<Vec<Parser>>,
+}
+
+/// A parsed `.talon` file, together with the memory map its tree refers to.
+pub struct File {
+    source: Source,
+    hash: u64,
+    tree: Tree,
+}
+
+/// The contents of a memory-mapped file. Empty files cannot be mapped.
+struct Source(Option<Mmap>);
+
+impl Deref for Source {
+    type Target = [u8];
+
+    fn deref(&self) -> &[u8] {
+        self.0.as_deref().unwrap_or(&[])
+    }
+}
+
+impl File {
+    /// The contents of the file, which the byte offsets of the tree index into.
+    ///
+    /// These are mapped from the file rather than copied, so the file should be replaced rather
+    /// than truncated in place while the workspace is alive.
+    pub fn source(&self) -> &[u8] {
+        &self.source
+    }
+
+    /// The hash of the contents of the file when it was last parsed.
+    pub fn hash(&self) -> u64 {
+        self.hash
+    }
+
+    /// The syntax tree of the file.
+    pub fn tree(&self) -> &Tree {
+        &self.tree
+    }
+}
+
+/// Find and parse every `.talon` file under `root`.
+pub fn parse_workspace(root: impl AsRef<Path>) -> io::Result<Workspace> {
+    let mut workspace = Workspace {
+        root: root.as_ref().to_path_buf(),
+        files: BTreeMap::new(),
+        parsers: Mutex::new(Vec::new()),
+    };
+    workspace.refresh()?;
+    Ok(workspace)
+}
+
+enum Outcome {
+    Unchanged,
+    Parsed(File),
+}
+
+impl Workspace {
+    /// The directory this workspace was parsed from.
+    pub fn root(&self) -> &Path {
+        &self.root
+    }
+
+    /// The parsed files, ordered by path.
+    pub fn files(&self) -> impl Iterator<Item = (&Path, &File)> {
+        self.files.iter().map(|(path, file)| (path.as_path(), file))
+    }
+
+    /// The parsed file at `path`, if any.
+    pub fn get(&self, path: impl AsRef<Path>) -> Option<&File> {
+        self.files.get(path.as_ref())
+    }
+
+    /// The number of parsed files.
+    pub fn len(&self) -> usize {
+        self.files.len()
+    }
+
+    /// Whether the workspace contains no `.talon` files.
+    pub fn is_empty(&self) -> bool {
+        self.files.is_empty()
+    }
+
+    /// Rescan the root directory, parsing new files and files whose content hash has changed,
+    /// and dropping files that no longer exist. Returns the number of files that were parsed.
+    pub fn refresh(&mut self) -> io::Result<usize> {
+        let mut paths = Vec::new();
+        find_talon_files(&self.root, &mut paths)?;
+
+        let threads = std::thread::available_parallelism()
+            .map(|threads| threads.get())
+            .unwrap_or(1)
+            .min(paths.len().max(1));
+        let next = AtomicUsize::new(0);
+        let files = &self.files;
+        let parsers = &self.parsers;
+
+        // Each worker takes a parser from the pool, and claims files one at a time until none
+        // are left, so that large files do not leave the other workers idle.
+        let results: Vec<io::Result<Vec<(usize, Outcome)>>> = std::thread::scope(|scope| {
+            let workers: Vec<_> = (0..threads)
+                .map(|_| {
+                    scope.spawn(|| {
+                        let mut parser = parsers.lock().unwrap().pop().unwrap_or_else(new_parser);
+                        let mut outcomes = Vec::new();
+                        let result = loop {
+                            let index = next.fetch_add(1, Ordering::Relaxed);
+                            let path = match paths.get(index) {
+                                Some(path) => path,
+                                None => break Ok(outcomes),
+                            };
+                            match parse_file(&mut parser, path, files.get(path)) {
+                                Ok(outcome) => outcomes.push((index, outcome)),
+                                Err(error) => break Err(error),
+                            }
+                        };
+                        parsers.lock().unwrap().push(parser);
+                        result
+                    })
+                })
+                .collect();
+            workers
+                .into_iter()
+                .map(|worker| worker.join().unwrap())
+                .collect()
+        });
+
+        let mut parsed = 0;
+        let mut files = BTreeMap::new();
+        let mut outcomes = Vec::with_capacity(paths.len());
+        for result in results {
+            outcomes.extend(result?);
+        }
+        for (index, outcome) in outcomes {
+            let path = &paths[index];
+            let file = match outcome {
+                Outcome::Unchanged => self.files.remove(path).unwrap(),
+                Outcome::Parsed(file) => {
+                    parsed += 1;
+                    file
+                }
+            };
+            files.insert(path.clone(), file);
+        }
+        self.files = files;
+        Ok(parsed)
+    }
+}
+
+fn new_parser() -> Parser {
+    let mut parser = Parser::new();
+    parser
+        .set_language(crate::language())
+        .expect("Error loading talon language");
+    parser
+}
+
+fn parse_file(parser: &mut Parser, path: &Path, previous: Option<&File>) -> io::Result<Outcome> {
+    let file = std::fs::File::open(path)?;
+    let source = if file.metadata()?.len() == 0 {
+        Source(None)
+    } else {
+        // The map is read-only, and the tree is re-parsed if the contents change.
+        Source(Some(unsafe { Mmap::map(&file)? }))
+    };
+
+    let mut hasher = DefaultHasher::new();
+    hasher.write(&source);
+    let hash = hasher.finish();
+    if previous.map_or(false, |previous| previous.hash == hash) {
+        return Ok(Outcome::Unchanged);
+    }
+
+    let tree = parser.parse(&*source, None).ok_or_else(|| {
+        io::Error::new(
+            io::ErrorKind::Other,
+            format!("failed to parse {}", path.display()),
+        )
+    })?;
+    Ok(Outcome::Parsed(File { source, hash, tree }))
+}
+
+/// Collect the paths of the `.talon` files under `dir`. Symbolic links to directories are not
+/// followed, so that cycles cannot occur.
+fn find_talon_files(dir: &Path, paths: &mut Vec<PathBuf>) -> io::Result<()> {
+    for entry in std::fs::read_dir(dir)? {
+        let entry = entry?;
+        let path = entry.path();
+        if entry.file_type()?.is_dir() {
+            find_talon_files(&path, paths)?;
+        } else if path
+            .extension()
+            .map_or(false, |extension| extension == "talon")
+        {
+            paths.push(path);
+        }
+    }
+    Ok(())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::parse_workspace;
+
+    #[test]
+    fn test_refresh_only_parses_changed_files() {
+        let root = std::env::temp_dir().join(format!("tree-sitter-talon-{}", std::process::id()));
+        std::fs::create_dir_all(root.join("apps")).unwrap();
+        std::fs::write(root.join("a.talon"), "hello: key(a)\n").unwrap();
+        std::fs::write(root.join("apps/b.talon"), "app: firefox\n-\nbye: key(b)\n").unwrap();
+        std::fs::write(root.join("apps/empty.talon"), "").unwrap();
+        std::fs::write(root.join("notes.txt"), "not talon").unwrap();
+
+        let mut workspace = parse_workspace(&root).unwrap();
+        assert_eq!(workspace.len(), 3);
+        let file = workspace.get(root.join("a.talon")).unwrap();
+        assert_eq!(file.source(), b"hello: key(a)\n");
+        assert!(!file.tree().root_node().has_error());
+
+        assert_eq!(workspace.refresh().unwrap(), 0);
+        // a.talon is still mapped, so replace it rather than truncating it in place.
+        std::fs::write(root.join("a.talon.tmp"), "hello there: key(a)\n").unwrap();
+        std::fs::rename(root.join("a.talon.tmp"), root.join("a.talon")).unwrap();
+        std::fs::remove_file(root.join("apps/empty.talon")).unwrap();
+        assert_eq!(workspace.refresh().unwrap(), 1);
+        assert_eq!(workspace.len(), 2);
+
+        std::fs::remove_dir_all(&root).unwrap();
+    }
+}
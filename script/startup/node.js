@@ -0,0 +1,30 @@
+// Measure the time to the first parsed tree with the Node binding.
+//
+// Usage: node script/startup/node.js FILE
+//
+// Prints the time each step took as JSON, like tools/talon-startup.
+
+const { readFileSync } = require("fs");
+const { join } = require("path");
+
+const source = readFileSync(process.argv[2], "utf8");
+
+const start = performance.now();
+const Parser = require("tree-sitter");
+const Talon = require(join(__dirname, "..", ".."));
+const loaded = performance.now();
+
+const parser = new Parser();
+parser.setLanguage(Talon);
+const constructed = performance.now();
+
+parser.parse(source);
+const parsed = performance.now();
+
+console.log(
+  JSON.stringify({
+    load_ms: loaded - start,
+    language_ms: constructed - loaded,
+    parse_ms: parsed - constructed,
+  }),
+);
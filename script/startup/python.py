@@ -0,0 +1,36 @@
+"""Measure the time to the first parsed tree with the Python binding.
+
+Usage: python script/startup/python.py FILE
+
+Prints the time each step took as JSON, like tools/talon-startup.
+"""
+
+import json
+import sys
+from time import perf_counter
+
+with open(sys.argv[1], "rb") as file:
+    source = file.read()
+
+start = perf_counter()
+from tree_sitter import Language, Parser  # noqa: E402
+
+import tree_sitter_talon  # noqa: E402
+
+loaded = perf_counter()
+
+parser = Parser(Language(tree_sitter_talon.language()))
+constructed = perf_counter()
+
+parser.parse(source)
+parsed = perf_counter()
+
+print(
+    json.dumps(
+        {
+            "load_ms": (loaded - start) * 1e3,
+            "language_ms": (constructed - loaded) * 1e3,
+            "parse_ms": (parsed - constructed) * 1e3,
+        }
+    )
+)
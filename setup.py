@@ -1,11 +1,33 @@
 from os.path import isdir, join
 from platform import system
+from subprocess import check_call
+from sys import version_info
+from sysconfig import get_config_var
 
 from setuptools import Extension, find_packages, setup
 from setuptools.command.build import build
 from wheel.bdist_wheel import bdist_wheel
 
 
+# Py_buffer is only part of the limited API from Python 3.11 onwards, and
+# free-threaded builds do not support the limited API at all.
+limited_api = version_info >= (3, 11) and not get_config_var("Py_GIL_DISABLED")
+
+# The extension bundles the tree-sitter runtime that extract() and to_json()
+# parse with, so it needs no system library. Source distributions include
+# it, and a git checkout fetches it on the first build.
+RUNTIME_VERSION = "v0.22.6"
+RUNTIME_DIR = join("vendor", "tree-sitter", "lib")
+
+
+def vendor_runtime():
+    if not isdir(RUNTIME_DIR):
+        check_call([
+            "git", "clone", "--quiet", "--depth", "1", "--branch", RUNTIME_VERSION,
+            "https://github.com/tree-sitter/tree-sitter", join("vendor", "tree-sitter")
+        ])
+
+
 class Build(build):
     def run(self):
         if isdir("queries"):
@@ -17,11 +39,13 @@ class Build(build):
 class BdistWheel(bdist_wheel):
     def get_tag(self):
         python, abi, platform = super().get_tag()
-        if python.startswith("cp"):
-            python, abi = "cp38", "abi3"
+        if python.startswith("cp") and limited_api:
+            python, abi = "cp311", "abi3"
         return python, abi, platform
 
 
+vendor_runtime()
+
 setup(
     packages=find_packages("bindings/python"),
     package_dir={"": "bindings/python"},
@@ -35,8 +59,12 @@ setup(
             name="_binding",
             sources=[
                 "bindings/python/tree_sitter_talon/binding.c",
+                "bindings/c/talon.c",
+                "bindings/c/json.c",
+                "bindings/c/buffer.c",
                 "src/parser.c",
-                # NOTE: if your language uses an external scanner, add it here.
+                "src/scanner.c",
+                join(RUNTIME_DIR, "src", "lib.c"),
             ],
             extra_compile_args=[
                 "-std=c11",
@@ -44,12 +72,25 @@ setup(
                 "/std:c11",
                 "/utf-8",
             ],
+            # The runtime needs POSIX functions, such as fdopen, which
+            # -std=c11 hides.
             define_macros=[
-                ("Py_LIMITED_API", "0x03080000"),
-                ("PY_SSIZE_T_CLEAN", None)
+                ("Py_LIMITED_API", "0x030B0000"),
+                ("PY_SSIZE_T_CLEAN", None),
+                ("_POSIX_C_SOURCE", "200112L"),
+                ("_DEFAULT_SOURCE", None)
+            ] if limited_api else [
+                ("PY_SSIZE_T_CLEAN", None),
+                ("_POSIX_C_SOURCE", "200112L"),
+                ("_DEFAULT_SOURCE", None)
+            ],
+            include_dirs=[
+                "src",
+                "bindings/c",
+                join(RUNTIME_DIR, "include"),
+                join(RUNTIME_DIR, "src"),
             ],
-            include_dirs=["src"],
-            py_limited_api=True,
+            py_limited_api=limited_api,
         )
     ],
     cmdclass={
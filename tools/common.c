@@ -0,0 +1,261 @@
+#define _XOPEN_SOURCE 700
+
+#include "common.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+extern const char *program_name;
+
+static bool has_extension(const char *path, const char *extension) {
+    size_t length = strlen(path), extension_length = strlen(extension);
+    return length > extension_length && strcmp(path + length - extension_length, extension) == 0;
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static char *join(const char *directory, const char *name) {
+    size_t length = strlen(directory), name_length = strlen(name);
+    char *path = ts_malloc(length + name_length + 2);
+    memcpy(path, directory, length);
+    path[length] = '/';
+    memcpy(path + length + 1, name, name_length + 1);
+    return path;
+}
+
+static bool collect(const char *path, const char *extension, bool top_level, Paths *paths) {
+    struct stat st;
+    if ((top_level ? stat(path, &st) : lstat(path, &st)) < 0) {
+        fprintf(stderr, "%s: %s: %s\n", program_name, path, strerror(errno));
+        return false;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        if (S_ISREG(st.st_mode) && (top_level || has_extension(path, extension))) {
+            size_t length = strlen(path) + 1;
+            array_push(paths, memcpy(ts_malloc(length), path, length));
+        }
+        return true;
+    }
+
+    DIR *directory = opendir(path);
+    if (directory == NULL) {
+        fprintf(stderr, "%s: %s: %s\n", program_name, path, strerror(errno));
+        return false;
+    }
+    uint32_t start = paths->size;
+    bool ok = true;
+    struct dirent *entry;
+    while (ok && (entry = readdir(directory)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        char *child = join(path, entry->d_name);
+        ok = collect(child, extension, false, paths);
+        ts_free(child);
+    }
+    closedir(directory);
+    qsort(paths->contents + start, paths->size - start, sizeof(char *), compare_paths);
+    return ok;
+}
+
+bool collect_files(const char *path, const char *extension, Paths *paths) {
+    return collect(path, extension, true, paths);
+}
+
+void paths_delete(Paths *paths) {
+    for (uint32_t i = 0; i < paths->size; i++) {
+        ts_free(paths->contents[i]);
+    }
+    array_delete(paths);
+}
+
+char *read_file(const char *path, size_t *length) {
+    FILE *stream = fopen(path, "rb");
+    if (stream == NULL) {
+        return NULL;
+    }
+    Array(char) contents = array_new();
+    size_t count;
+    do {
+        if (contents.size == contents.capacity) {
+            array_reserve(&contents, contents.capacity * 2 + 65536);
+        }
+        count = fread(contents.contents + contents.size, 1, contents.capacity - contents.size, stream);
+        contents.size += (uint32_t)count;
+    } while (count > 0);
+    bool failed = ferror(stream);
+    fclose(stream);
+    if (failed) {
+        array_delete(&contents);
+        return NULL;
+    }
+    array_push(&contents, '\0');
+    *length = contents.size - 1;
+    return contents.contents;
+}
+
+bool read_lines(const char *path, Paths *lines) {
+    size_t length;
+    char *text = read_file(path, &length);
+    if (text == NULL) {
+        return false;
+    }
+    char *line = text, *end = text + length;
+    while (line < end) {
+        char *newline = memchr(line, '\n', (size_t)(end - line));
+        size_t line_length = newline ? (size_t)(newline - line) : (size_t)(end - line);
+        if (line_length > 0 && line[line_length - 1] == '\r') {
+            line_length--;
+        }
+        if (line_length > 0) {
+            char *copy = ts_malloc(line_length + 1);
+            memcpy(copy, line, line_length);
+            copy[line_length] = '\0';
+            array_push(lines, copy);
+        }
+        line = newline ? newline + 1 : end;
+    }
+    ts_free(text);
+    return true;
+}
+
+void paths_sort(Paths *paths) {
+    qsort(paths->contents, paths->size, sizeof(char *), compare_paths);
+}
+
+bool paths_contain(const Paths *paths, const char *path) {
+    return bsearch(&path, paths->contents, paths->size, sizeof(char *), compare_paths) != NULL;
+}
+
+// Blocks from the counting allocator start with their size, padded to keep
+// the rest aligned.
+#define HEADER_SIZE 16
+
+static size_t live_bytes, peak_bytes;
+
+static void *counting_malloc(size_t size) {
+    char *block = malloc(size + HEADER_SIZE);
+    if (block == NULL) {
+        return NULL;
+    }
+    *(size_t *)block = size;
+    live_bytes += size;
+    if (live_bytes > peak_bytes) {
+        peak_bytes = live_bytes;
+    }
+    return block + HEADER_SIZE;
+}
+
+static void *counting_calloc(size_t count, size_t size) {
+    void *data = counting_malloc(count * size);
+    if (data != NULL) {
+        memset(data, 0, count * size);
+    }
+    return data;
+}
+
+static void *counting_realloc(void *data, size_t size) {
+    if (data == NULL) {
+        return counting_malloc(size);
+    }
+    char *block = (char *)data - HEADER_SIZE;
+    size_t old_size = *(size_t *)block;
+    block = realloc(block, size + HEADER_SIZE);
+    if (block == NULL) {
+        return NULL;
+    }
+    *(size_t *)block = size;
+    live_bytes = live_bytes - old_size + size;
+    if (live_bytes > peak_bytes) {
+        peak_bytes = live_bytes;
+    }
+    return block + HEADER_SIZE;
+}
+
+static void counting_free(void *data) {
+    if (data != NULL) {
+        char *block = (char *)data - HEADER_SIZE;
+        live_bytes -= *(size_t *)block;
+        free(block);
+    }
+}
+
+void count_allocations(void) {
+    ts_set_allocator(counting_malloc, counting_calloc, counting_realloc, counting_free);
+}
+
+size_t allocated_bytes(void) {
+    return live_bytes;
+}
+
+size_t peak_allocated_bytes(void) {
+    return peak_bytes;
+}
+
+void reset_peak_allocated_bytes(void) {
+    peak_bytes = live_bytes;
+}
+
+double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+}
+
+unsigned cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (unsigned)count : 1;
+}
+
+double percentile(const double *sorted, uint32_t count, double fraction) {
+    if (count == 0) {
+        return 0;
+    }
+    double position = fraction * count;
+    uint32_t rank = (uint32_t)position;
+    if (rank < position) {
+        rank++;
+    }
+    return sorted[rank < 1 ? 0 : rank > count ? count - 1 : rank - 1];
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void sort_doubles(double *values, uint32_t count) {
+    qsort(values, count, sizeof(double), compare_doubles);
+}
+
+void print_json_string(FILE *stream, const char *string) {
+    fputc('"', stream);
+    for (const unsigned char *c = (const unsigned char *)string; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(stream, "\\%c", *c);
+        } else if (*c < 0x20) {
+            fprintf(stream, "\\u%04x", *c);
+        } else {
+            fputc(*c, stream);
+        }
+    }
+    fputc('"', stream);
+}
+
+void die(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%s: ", program_name);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+    exit(1);
+}
@@ -0,0 +1,68 @@
+#ifndef TREE_SITTER_TALON_TOOLS_COMMON_H_
+#define TREE_SITTER_TALON_TOOLS_COMMON_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "talon.h"
+#include "tree_sitter/array.h"
+
+typedef Array(char *) Paths;
+
+// Append the paths of the files with the given extension, such as
+// ".talon", under path, or path itself if it is a file, in sorted order.
+// Symbolic links to directories are not followed. Returns false and prints
+// an error if path cannot be read.
+bool collect_files(const char *path, const char *extension, Paths *paths);
+
+void paths_delete(Paths *paths);
+
+// Read a whole file into memory, followed by a NUL byte. Returns NULL and
+// sets errno on error.
+char *read_file(const char *path, size_t *length);
+
+// Append the non-empty lines of a file to lines. Returns false and sets
+// errno on error.
+bool read_lines(const char *path, Paths *lines);
+
+void paths_sort(Paths *paths);
+
+// Whether a sorted list of paths contains path.
+bool paths_contain(const Paths *paths, const char *path);
+
+// Install an allocator with ts_set_allocator that counts the bytes the
+// tree-sitter runtime allocates. Call it before creating any parser, so
+// that every block freed was counted, and only from single-threaded tools.
+void count_allocations(void);
+
+// The bytes allocated by the runtime and not yet freed.
+size_t allocated_bytes(void);
+
+// The most bytes allocated at once since the last call to
+// reset_peak_allocated_bytes.
+size_t peak_allocated_bytes(void);
+
+void reset_peak_allocated_bytes(void);
+
+// Seconds since an arbitrary point, from a monotonic clock.
+double now(void);
+
+// The number of online processors.
+unsigned cpu_count(void);
+
+// The value at the given fraction, from 0 to 1, of sorted values, by the
+// nearest-rank method. Zero if there are no values.
+double percentile(const double *sorted, uint32_t count, double fraction);
+
+// Sort values in ascending order.
+void sort_doubles(double *values, uint32_t count);
+
+// Print a string as a quoted JSON string.
+void print_json_string(FILE *stream, const char *string);
+
+// Print a message to stderr, prefixed with the program name, and exit.
+void die(const char *format, ...);
+
+#endif // TREE_SITTER_TALON_TOOLS_COMMON_H_
@@ -0,0 +1,113 @@
+#include "corpus.h"
+
+#include <string.h>
+
+typedef struct {
+    const char *text;
+    size_t length;
+    size_t position;
+    uint32_t line;
+} Lines;
+
+typedef struct {
+    const char *start;
+    // Excluding the line terminator.
+    size_t length;
+    // The offset of the next line.
+    size_t next;
+} Line;
+
+static bool next_line(Lines *lines, Line *line) {
+    if (lines->position >= lines->length) {
+        return false;
+    }
+    const char *start = lines->text + lines->position;
+    const char *newline = memchr(start, '\n', lines->length - lines->position);
+    size_t length = newline ? (size_t)(newline - start) : lines->length - lines->position;
+    line->start = start;
+    line->next = lines->position + length + (newline != NULL);
+    if (length > 0 && start[length - 1] == '\r') {
+        length--;
+    }
+    line->length = length;
+    lines->position = line->next;
+    lines->line++;
+    return true;
+}
+
+// Whether a line is a divider of at least three copies of c. Dividers may
+// carry a suffix, as in "===|||", which is ignored.
+static bool is_divider(const Line *line, char c) {
+    size_t count = 0;
+    while (count < line->length && line->start[count] == c) {
+        count++;
+    }
+    return count >= 3 && (count == line->length || line->start[count] != c);
+}
+
+bool corpus_parse(const char *text, size_t length, CorpusTests *tests) {
+    Lines lines = {text, length, 0, 0};
+    Line line;
+    bool found_header = false;
+    while (!found_header && next_line(&lines, &line)) {
+        found_header = is_divider(&line, '=');
+    }
+    while (found_header) {
+        CorpusTest test = {.line = lines.line};
+
+        // The name is the first line of the header, and later lines that
+        // start with a colon are attributes.
+        bool closed = false;
+        while (next_line(&lines, &line)) {
+            if (is_divider(&line, '=')) {
+                closed = true;
+                break;
+            }
+            if (line.start[0] == ':') {
+                test.skip |= line.length == 5 && memcmp(line.start, ":skip", 5) == 0;
+                test.error |= line.length == 6 && memcmp(line.start, ":error", 6) == 0;
+            } else if (test.name == NULL) {
+                test.name = line.start;
+                test.name_length = (uint32_t)line.length;
+            }
+        }
+        if (!closed || test.name == NULL) {
+            return false;
+        }
+
+        size_t input_start = lines.position;
+        bool divided = false;
+        while (next_line(&lines, &line)) {
+            if (is_divider(&line, '-')) {
+                divided = true;
+                break;
+            }
+        }
+        if (!divided) {
+            return false;
+        }
+        size_t input_end = (size_t)(line.start - text);
+        if (input_end > input_start && text[input_end - 1] == '\n') {
+            input_end--;
+            if (input_end > input_start && text[input_end - 1] == '\r') {
+                input_end--;
+            }
+        }
+        test.input = text + input_start;
+        test.input_length = (uint32_t)(input_end - input_start);
+
+        size_t expected_start = lines.position, expected_end = length;
+        found_header = false;
+        while (next_line(&lines, &line)) {
+            if (is_divider(&line, '=')) {
+                expected_end = (size_t)(line.start - text);
+                found_header = true;
+                break;
+            }
+        }
+        test.expected = text + expected_start;
+        test.expected_length = (uint32_t)(expected_end - expected_start);
+        array_push(tests, test);
+    }
+    return true;
+}
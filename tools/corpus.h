@@ -0,0 +1,45 @@
+#ifndef TREE_SITTER_TALON_TOOLS_CORPUS_H_
+#define TREE_SITTER_TALON_TOOLS_CORPUS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tree_sitter/array.h"
+
+// A test in the corpus format used by `tree-sitter test`:
+//
+//   ===============
+//   Name
+//   :attribute
+//   ===============
+//   input
+//   ---------------
+//   expected tree
+//
+// All strings point into the text of the corpus file.
+typedef struct {
+    const char *name;
+    uint32_t name_length;
+    const char *input;
+    uint32_t input_length;
+    const char *expected;
+    uint32_t expected_length;
+    // The line of the header, counting from 1.
+    uint32_t line;
+    // Set by the :skip attribute.
+    bool skip;
+    // Set by the :error attribute, which expects the tree to have errors
+    // rather than to match a given tree.
+    bool error;
+} CorpusTest;
+
+typedef Array(CorpusTest) CorpusTests;
+
+// Split the text of a corpus file into tests. As in `tree-sitter test`,
+// the line break before the dashed divider is not part of the input, and
+// dividers may be followed by \r\n. Returns false if a header has no
+// matching divider.
+bool corpus_parse(const char *text, size_t length, CorpusTests *tests);
+
+#endif // TREE_SITTER_TALON_TOOLS_CORPUS_H_
@@ -0,0 +1,121 @@
+#define _GNU_SOURCE
+
+#include "counters.h"
+
+#include <string.h>
+
+const char *const COUNTER_NAMES[COUNTER_COUNT] = {"cycles", "instructions", "branch_misses", "l1d_misses"};
+
+#ifdef __linux__
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int open_event(uint32_t type, uint64_t config, int group) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+bool counters_open(Counters *counters) {
+    static const struct {
+        uint32_t type;
+        uint64_t config;
+    } EVENTS[COUNTER_COUNT] = {
+        [COUNTER_CYCLES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        [COUNTER_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        [COUNTER_BRANCH_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        [COUNTER_L1D_MISSES] = {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    };
+
+    // The first counter that opens leads a group, so that all are enabled,
+    // disabled and read together.
+    memset(counters, 0, sizeof(*counters));
+    int group = -1;
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        counters->fds[i] = open_event(EVENTS[i].type, EVENTS[i].config, group);
+        if (group < 0) {
+            group = counters->fds[i];
+        }
+    }
+    return group >= 0;
+}
+
+static int leader(const Counters *counters) {
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (counters->fds[i] >= 0) {
+            return counters->fds[i];
+        }
+    }
+    return -1;
+}
+
+void counters_start(Counters *counters) {
+    int fd = leader(counters);
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+void counters_stop(Counters *counters) {
+    int fd = leader(counters);
+    if (fd < 0) {
+        return;
+    }
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // A group reads as its number of counters, then their values in the
+    // order they were opened.
+    uint64_t group[1 + COUNTER_COUNT];
+    if (read(fd, group, sizeof(group)) < (ssize_t)sizeof(uint64_t)) {
+        return;
+    }
+    uint64_t index = 1;
+    for (int i = 0; i < COUNTER_COUNT && index <= group[0]; i++) {
+        if (counters->fds[i] >= 0) {
+            counters->values[i] += group[index++];
+        }
+    }
+}
+
+void counters_close(Counters *counters) {
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (counters->fds[i] >= 0) {
+            close(counters->fds[i]);
+            counters->fds[i] = -1;
+        }
+    }
+}
+
+#else
+
+bool counters_open(Counters *counters) {
+    memset(counters, 0, sizeof(*counters));
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        counters->fds[i] = -1;
+    }
+    return false;
+}
+
+void counters_start(Counters *counters) {}
+
+void counters_stop(Counters *counters) {}
+
+void counters_close(Counters *counters) {}
+
+#endif
+
+bool counters_has(const Counters *counters, Counter counter) {
+    return counters->fds[counter] >= 0;
+}
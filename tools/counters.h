@@ -0,0 +1,39 @@
+#ifndef TREE_SITTER_TALON_TOOLS_COUNTERS_H_
+#define TREE_SITTER_TALON_TOOLS_COUNTERS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Hardware performance counters, read with perf_event_open on Linux.
+typedef enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_L1D_MISSES,
+    COUNTER_COUNT,
+} Counter;
+
+extern const char *const COUNTER_NAMES[COUNTER_COUNT];
+
+typedef struct {
+    int fds[COUNTER_COUNT];
+    // The counts accumulated between each counters_start and counters_stop.
+    uint64_t values[COUNTER_COUNT];
+} Counters;
+
+// Open the counters that this machine supports, counting user space only,
+// so that they work without privileges under the default
+// perf_event_paranoid setting. Returns false if none could be opened, such
+// as on other systems than Linux or in containers that forbid them.
+bool counters_open(Counters *counters);
+
+// Whether a counter could be opened.
+bool counters_has(const Counters *counters, Counter counter);
+
+// Count from now until counters_stop, which adds the counts to values.
+void counters_start(Counters *counters);
+void counters_stop(Counters *counters);
+
+void counters_close(Counters *counters);
+
+#endif // TREE_SITTER_TALON_TOOLS_COUNTERS_H_
@@ -0,0 +1,251 @@
+// Benchmark parsing a set of .talon files.
+//
+// Usage: talon-bench [-n RUNS] [-k KNOWN_FAILURES] [-s SLOWEST] [-o JSON] [-m] [-p] PATH...
+//
+// Each PATH is a .talon file or a directory to search for them. Files
+// listed in KNOWN_FAILURES, one path per line, are skipped. All files are
+// read into memory and parsed once to warm up the parser, then each file is
+// parsed RUNS times, by default 10, and its mean parse time recorded. This
+// leaves process startup and file reading out of the timings.
+//
+// Prints the throughput, percentiles of the per-file parse time and the
+// SLOWEST slowest files, by default 10, and with -o, writes the same as
+// JSON to the file JSON, or to stdout if JSON is "-". Files other than
+// known failures that parse with errors are listed, and make the exit
+// status 1.
+//
+// With -m, also reports the peak bytes the runtime allocated while parsing
+// any one file, measured with a counting allocator.
+//
+// With -p, also counts cycles, instructions, branch misses and L1 data
+// cache misses in user space during the timed parses, with perf_event_open,
+// and reports them per parse and per KB of source. Counters that the
+// machine does not support are left out.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "counters.h"
+
+const char *program_name = "talon-bench";
+
+typedef struct {
+    const char *path;
+    char *source;
+    size_t length;
+    double seconds;
+    size_t peak_bytes;
+    bool has_error;
+} Sample;
+
+static int compare_slowest(const void *a, const void *b) {
+    const Sample *x = a, *y = b;
+    return (x->seconds < y->seconds) - (x->seconds > y->seconds);
+}
+
+// Parse a sample, counting events with counters if not NULL.
+static double parse(TSParser *parser, Sample *sample, Counters *counters) {
+    if (counters != NULL) {
+        counters_start(counters);
+    }
+    reset_peak_allocated_bytes();
+    size_t baseline = allocated_bytes();
+    double start = now();
+    TSTree *tree = ts_parser_parse_string(parser, NULL, sample->source, (uint32_t)sample->length);
+    double seconds = now() - start;
+    if (counters != NULL) {
+        counters_stop(counters);
+    }
+    sample->peak_bytes = peak_allocated_bytes() - baseline;
+    sample->has_error = ts_node_has_error(ts_tree_root_node(tree));
+    ts_tree_delete(tree);
+    return seconds;
+}
+
+int main(int argc, char **argv) {
+    unsigned runs = 10, slowest = 10;
+    const char *json = NULL;
+    bool count_events = false, count_bytes = false;
+    Paths known_failures = array_new();
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc) {
+            runs = (unsigned)atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-k") == 0 && arg + 1 < argc) {
+            if (!read_lines(argv[++arg], &known_failures)) {
+                die("%s: %s", argv[arg], strerror(errno));
+            }
+        } else if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc) {
+            slowest = (unsigned)atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) {
+            json = argv[++arg];
+        } else if (strcmp(argv[arg], "-m") == 0) {
+            count_bytes = true;
+        } else if (strcmp(argv[arg], "-p") == 0) {
+            count_events = true;
+        } else {
+            break;
+        }
+    }
+    if (arg == argc || argv[arg][0] == '-') {
+        fprintf(stderr, "usage: %s [-n RUNS] [-k KNOWN_FAILURES] [-s SLOWEST] [-o JSON] [-m] [-p] PATH...\n",
+                program_name);
+        return 2;
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+    paths_sort(&known_failures);
+
+    Paths paths = array_new();
+    for (; arg < argc; arg++) {
+        if (!collect_files(argv[arg], ".talon", &paths)) {
+            return 1;
+        }
+    }
+
+    Array(Sample) samples = array_new();
+    uint32_t skipped = 0;
+    size_t total_bytes = 0;
+    for (uint32_t i = 0; i < paths.size; i++) {
+        const char *path = paths.contents[i];
+        if (paths_contain(&known_failures, strncmp(path, "./", 2) == 0 ? path + 2 : path)) {
+            skipped++;
+            continue;
+        }
+        Sample sample = {path, NULL, 0, 0, 0, false};
+        if ((sample.source = read_file(path, &sample.length)) == NULL) {
+            die("%s: %s", path, strerror(errno));
+        }
+        total_bytes += sample.length;
+        array_push(&samples, sample);
+    }
+
+    if (count_bytes) {
+        count_allocations();
+    }
+    Counters counters;
+    if (count_events && !counters_open(&counters)) {
+        fprintf(stderr, "%s: performance counters are not available\n", program_name);
+        count_events = false;
+    }
+    TSParser *parser = talon_parser_new();
+    for (uint32_t i = 0; i < samples.size; i++) {
+        parse(parser, &samples.contents[i], NULL);
+    }
+    double total_seconds = 0;
+    for (uint32_t i = 0; i < samples.size; i++) {
+        Sample *sample = &samples.contents[i];
+        double seconds = 0;
+        for (unsigned run = 0; run < runs; run++) {
+            seconds += parse(parser, sample, count_events ? &counters : NULL);
+        }
+        total_seconds += seconds;
+        sample->seconds = seconds / runs;
+    }
+    ts_parser_delete(parser);
+
+    uint32_t errors = 0;
+    size_t peak_bytes = 0;
+    for (uint32_t i = 0; i < samples.size; i++) {
+        if (samples.contents[i].peak_bytes > peak_bytes) {
+            peak_bytes = samples.contents[i].peak_bytes;
+        }
+        if (samples.contents[i].has_error) {
+            fprintf(stderr, "ERROR %s\n", samples.contents[i].path);
+            errors++;
+        }
+    }
+
+    double *latencies = ts_malloc((samples.size + 1) * sizeof(double));
+    for (uint32_t i = 0; i < samples.size; i++) {
+        latencies[i] = samples.contents[i].seconds;
+    }
+    sort_doubles(latencies, samples.size);
+    double p50 = percentile(latencies, samples.size, 0.50);
+    double p95 = percentile(latencies, samples.size, 0.95);
+    double p99 = percentile(latencies, samples.size, 0.99);
+    double bytes_per_second = total_seconds > 0 ? (double)total_bytes * runs / total_seconds : 0;
+    qsort(samples.contents, samples.size, sizeof(Sample), compare_slowest);
+    if (slowest > samples.size) {
+        slowest = samples.size;
+    }
+
+    uint32_t total = samples.size + skipped;
+    printf("Parsed %u of %u files (%.2f%%), %zu bytes, %u runs each\n", samples.size - errors, total,
+           total > 0 ? 100.0 * (samples.size - errors) / total : 100.0, total_bytes, runs);
+    printf("%.2f MB/s; per file p50 %.3f ms, p95 %.3f ms, p99 %.3f ms\n", bytes_per_second / 1e6, p50 * 1e3,
+           p95 * 1e3, p99 * 1e3);
+    if (count_bytes) {
+        printf("peak %zu bytes allocated while parsing a file\n", peak_bytes);
+    }
+    if (slowest > 0) {
+        printf("\n%-64s %10s %10s\n", "slowest files", "bytes", "time (ms)");
+        for (uint32_t i = 0; i < slowest; i++) {
+            const Sample *sample = &samples.contents[i];
+            printf("%-64s %10zu %10.3f\n", sample->path, sample->length, sample->seconds * 1e3);
+        }
+    }
+
+    double parses = (double)samples.size * runs, kilobytes = (double)total_bytes * runs / 1024;
+    if (count_events) {
+        printf("\n%-16s %14s %14s\n", "counter", "per parse", "per KB");
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            if (counters_has(&counters, i)) {
+                printf("%-16s %14.0f %14.0f\n", COUNTER_NAMES[i], counters.values[i] / parses,
+                       counters.values[i] / kilobytes);
+            }
+        }
+    }
+
+    if (json != NULL) {
+        FILE *stream = strcmp(json, "-") == 0 ? stdout : fopen(json, "w");
+        if (stream == NULL) {
+            die("%s: %s", json, strerror(errno));
+        }
+        fprintf(stream, "{\"files\":%u,\"skipped\":%u,\"errors\":%u,\"bytes\":%zu,\"runs\":%u,", samples.size,
+                skipped, errors, total_bytes, runs);
+        fprintf(stream, "\"seconds\":%.9g,\"bytes_per_second\":%.9g,", total_seconds, bytes_per_second);
+        fprintf(stream, "\"p50_ms\":%.6f,\"p95_ms\":%.6f,\"p99_ms\":%.6f,\"slowest\":[", p50 * 1e3, p95 * 1e3,
+                p99 * 1e3);
+        for (uint32_t i = 0; i < slowest; i++) {
+            const Sample *sample = &samples.contents[i];
+            fprintf(stream, "%s{\"path\":", i > 0 ? "," : "");
+            print_json_string(stream, sample->path);
+            fprintf(stream, ",\"bytes\":%zu,\"ms\":%.6f}", sample->length, sample->seconds * 1e3);
+        }
+        fprintf(stream, "]");
+        if (count_bytes) {
+            fprintf(stream, ",\"peak_bytes\":%zu", peak_bytes);
+        }
+        if (count_events) {
+            fprintf(stream, ",\"counters\":{");
+            for (int i = 0, written = 0; i < COUNTER_COUNT; i++) {
+                if (counters_has(&counters, i)) {
+                    fprintf(stream, "%s\"%s\":{\"per_parse\":%.3f,\"per_kb\":%.3f}", written++ > 0 ? "," : "",
+                            COUNTER_NAMES[i], counters.values[i] / parses, counters.values[i] / kilobytes);
+                }
+            }
+            fputc('}', stream);
+        }
+        fprintf(stream, "}\n");
+        if (stream != stdout && fclose(stream) != 0) {
+            die("%s: %s", json, strerror(errno));
+        }
+    }
+
+    for (uint32_t i = 0; i < samples.size; i++) {
+        ts_free(samples.contents[i].source);
+    }
+    if (count_events) {
+        counters_close(&counters);
+    }
+    ts_free(latencies);
+    array_delete(&samples);
+    paths_delete(&known_failures);
+    paths_delete(&paths);
+    return errors > 0;
+}
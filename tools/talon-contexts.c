@@ -0,0 +1,312 @@
+// Find the .talon files active in a scope, as the scope changes.
+//
+// Usage: talon-contexts [-c CHANGES] [-n RUNS] [-l] PATH...
+//
+// Each PATH is a .talon file or a directory to search for them. The context
+// headers of all files are compiled into one TalonContexts, and each line
+// of CHANGES changes the scope, one after another:
+//
+//   app.name: Firefox
+//   title: Inbox - Mail
+//   tag: user.tabs
+//   not tag: user.tabs
+//   title:
+//
+// sets a key, enables a tag or mode, disables one with "not", or clears a
+// key left empty. Patterns such as /firefox/i are tested as POSIX extended
+// regular expressions. After each change, and for the empty scope first,
+// the tool prints the number of active files and the median time of RUNS
+// evaluations, by default 100, next to that of testing every header line
+// by line with string comparisons. It fails if the two disagree. With -l,
+// it also lists the active files.
+
+#include <errno.h>
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+const char *program_name = "talon-contexts";
+
+static bool is_set_key(const char *key) {
+    return strcmp(key, "tag") == 0 || strcmp(key, "mode") == 0;
+}
+
+static bool match_pattern(void *payload, const char *pattern, uint32_t pattern_length, const char *value,
+                          uint32_t value_length) {
+    (void)payload;
+    const char *end = pattern + pattern_length;
+    while (end > pattern + 1 && end[-1] != '/') {
+        end--;
+    }
+    // A pattern without its closing slash, such as "/x", never matches.
+    if (end == pattern + 1) {
+        return false;
+    }
+    int flags = REG_EXTENDED | REG_NOSUB;
+    if (memchr(end, 'i', (size_t)(pattern + pattern_length - end)) != NULL) {
+        flags |= REG_ICASE;
+    }
+    char expression[1024];
+    snprintf(expression, sizeof(expression), "%.*s", (int)(end - pattern - 2), pattern + 1);
+    regex_t regex;
+    if (regcomp(&regex, expression, flags) != 0) {
+        return false;
+    }
+    // The value need not end at value_length, so match a terminated copy.
+    char *subject = ts_malloc((size_t)value_length + 1);
+    memcpy(subject, value, value_length);
+    subject[value_length] = '\0';
+    bool matches = regexec(&regex, subject, 0, NULL, 0) == 0;
+    ts_free(subject);
+    regfree(&regex);
+    return matches;
+}
+
+// The scope as strings, for the line by line evaluation.
+typedef struct {
+    Paths keys;
+    Paths values;
+} Strings;
+
+static const char *string_value(const Strings *scope, const char *key, uint32_t key_length, const char *value,
+                                uint32_t value_length) {
+    for (uint32_t i = 0; i < scope->keys.size; i++) {
+        const char *other = scope->keys.contents[i];
+        if (strlen(other) != key_length || memcmp(other, key, key_length) != 0) {
+            continue;
+        }
+        if (!is_set_key(other)) {
+            return scope->values.contents[i];
+        }
+        if (strlen(scope->values.contents[i]) == value_length &&
+            memcmp(scope->values.contents[i], value, value_length) == 0) {
+            return scope->values.contents[i];
+        }
+    }
+    return NULL;
+}
+
+static bool string_holds(const Strings *scope, const char *source, const TalonMatch *match) {
+    const char *key = source + match->left_start, *value = source + match->right_start;
+    uint32_t key_length = match->left_end - match->left_start, value_length = match->right_end - match->right_start;
+    while (value_length > 0 && strchr(" \t\r\n", *value) != NULL) {
+        value++;
+        value_length--;
+    }
+    while (value_length > 0 && strchr(" \t\r\n", value[value_length - 1]) != NULL) {
+        value_length--;
+    }
+    const char *current = string_value(scope, key, key_length, value, value_length);
+    if (current == NULL) {
+        return false;
+    }
+    if (value_length > 1 && value[0] == '/') {
+        return match_pattern(NULL, value, value_length, current, (uint32_t)strlen(current));
+    }
+    return strlen(current) == value_length && memcmp(current, value, value_length) == 0;
+}
+
+static bool starts_clause(const TalonFile *file, uint32_t i) {
+    return i == 0 || (file->matches[i].modifiers & TALON_MATCH_AND) == 0;
+}
+
+static bool same_key(const TalonFile *file, uint32_t i, uint32_t j) {
+    const TalonMatch *a = &file->matches[i], *b = &file->matches[j];
+    return a->left_end - a->left_start == b->left_end - b->left_start &&
+           memcmp(file->source + a->left_start, file->source + b->left_start, a->left_end - a->left_start) == 0;
+}
+
+static bool clause_holds(const Strings *scope, const TalonFile *file, uint32_t i) {
+    for (uint32_t j = i; j < file->match_count && (j == i || !starts_clause(file, j)); j++) {
+        bool negated = (file->matches[j].modifiers & TALON_MATCH_NOT) != 0;
+        if (string_holds(scope, file->source, &file->matches[j]) == negated) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether a header matches, combining lines as TalonContexts does, but
+// testing every line of every clause with string comparisons.
+static bool string_active(const Strings *scope, const TalonFile *file) {
+    for (uint32_t i = 0; i < file->match_count; i++) {
+        if (!starts_clause(file, i)) {
+            continue;
+        }
+        if (file->matches[i].modifiers & TALON_MATCH_NOT) {
+            if (!clause_holds(scope, file, i)) {
+                return false;
+            }
+            continue;
+        }
+        // Test the group of a key at its first clause.
+        bool first = true, holds = false;
+        for (uint32_t j = 0; j < file->match_count; j++) {
+            if (!starts_clause(file, j) || (file->matches[j].modifiers & TALON_MATCH_NOT) || !same_key(file, i, j)) {
+                continue;
+            }
+            first &= j >= i;
+            holds = holds || clause_holds(scope, file, j);
+        }
+        if (first && !holds) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void remove_string(Strings *scope, const char *key, const char *value) {
+    for (uint32_t i = scope->keys.size; i-- > 0;) {
+        if (strcmp(scope->keys.contents[i], key) == 0 &&
+            (!is_set_key(key) || strcmp(scope->values.contents[i], value) == 0)) {
+            ts_free(scope->keys.contents[i]);
+            ts_free(scope->values.contents[i]);
+            array_erase(&scope->keys, i);
+            array_erase(&scope->values, i);
+        }
+    }
+}
+
+static char *copy_string(const char *string) {
+    size_t length = strlen(string);
+    char *copy = ts_malloc(length + 1);
+    memcpy(copy, string, length + 1);
+    return copy;
+}
+
+// Apply a line of CHANGES to both scopes.
+static void apply_change(TalonScope *scope, Strings *strings, const char *path, uint32_t line_number,
+                         const char *line) {
+    char *copy = copy_string(line);
+    bool disable = strncmp(copy, "not ", 4) == 0;
+    char *key = copy + (disable ? 4 : 0), *colon = strchr(key, ':');
+    if (colon == NULL) {
+        die("%s:%u: expected key: value", path, line_number);
+    }
+    *colon = '\0';
+    char *value = colon + 1 + strspn(colon + 1, " \t");
+    value[strcspn(value, "\r\n")] = '\0';
+    remove_string(strings, key, value);
+    bool add = !disable && value[0] != '\0';
+    if (is_set_key(key)) {
+        talon_scope_enable(scope, key, value, add);
+    } else {
+        talon_scope_set(scope, key, add ? value : NULL);
+    }
+    if (add) {
+        array_push(&strings->keys, copy_string(key));
+        array_push(&strings->values, copy_string(value));
+    }
+    ts_free(copy);
+}
+
+int main(int argc, char **argv) {
+    const char *changes_path = NULL;
+    unsigned runs = 100;
+    bool list = false;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-c") == 0 && arg + 1 < argc) {
+            changes_path = argv[++arg];
+        } else if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc) {
+            runs = (unsigned)atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-l") == 0) {
+            list = true;
+        } else {
+            break;
+        }
+    }
+    if (arg == argc || argv[arg][0] == '-' || runs == 0) {
+        fprintf(stderr, "usage: %s [-c CHANGES] [-n RUNS] [-l] PATH...\n", program_name);
+        return 2;
+    }
+
+    Paths paths = array_new();
+    for (; arg < argc; arg++) {
+        if (!collect_files(argv[arg], ".talon", &paths)) {
+            return 1;
+        }
+    }
+    Paths changes = array_new();
+    if (changes_path != NULL && !read_lines(changes_path, &changes)) {
+        die("%s: %s", changes_path, strerror(errno));
+    }
+
+    TSParser *parser = talon_parser_new();
+    TalonFile **files = ts_malloc((paths.size + 1) * sizeof(TalonFile *));
+    TalonContexts *contexts = talon_contexts_new();
+    double build_seconds = 0;
+    for (uint32_t i = 0; i < paths.size; i++) {
+        files[i] = talon_parse_file(parser, paths.contents[i]);
+        if (files[i] == NULL) {
+            die("%s: %s", paths.contents[i], strerror(errno));
+        }
+        double start = now();
+        talon_contexts_add_file(contexts, files[i]);
+        build_seconds += now() - start;
+    }
+    ts_parser_delete(parser);
+    double start = now();
+    talon_contexts_build(contexts);
+    build_seconds += now() - start;
+    printf("%u files, %u conditions, %u clauses, built in %.2f ms\n\n", paths.size,
+           talon_contexts_condition_count(contexts), talon_contexts_clause_count(contexts), build_seconds * 1e3);
+    printf("%8s %12s %12s  %s\n", "active", "compiled us", "strings us", "change");
+
+    TalonScope *scope = talon_scope_new(contexts, match_pattern, NULL);
+    Strings strings = {array_new(), array_new()};
+    Array(uint32_t) expected = array_new();
+    double *compiled_times = ts_malloc(runs * sizeof(double)), *string_times = ts_malloc(runs * sizeof(double));
+    bool agree = true;
+    for (uint32_t change = 0; change <= changes.size; change++) {
+        if (change > 0) {
+            apply_change(scope, &strings, changes_path, change, changes.contents[change - 1]);
+        }
+        const uint32_t *active = NULL;
+        uint32_t active_count = 0;
+        for (unsigned run = 0; run < runs; run++) {
+            start = now();
+            active_count = talon_scope_active_files(scope, &active);
+            compiled_times[run] = now() - start;
+            start = now();
+            array_clear(&expected);
+            for (uint32_t i = 0; i < paths.size; i++) {
+                if (string_active(&strings, files[i])) {
+                    array_push(&expected, i);
+                }
+            }
+            string_times[run] = now() - start;
+        }
+        sort_doubles(compiled_times, runs);
+        sort_doubles(string_times, runs);
+        printf("%8u %12.2f %12.2f  %s\n", active_count, percentile(compiled_times, runs, 0.5) * 1e6,
+               percentile(string_times, runs, 0.5) * 1e6, change > 0 ? changes.contents[change - 1] : "(empty scope)");
+        if (active_count != expected.size ||
+            (active_count > 0 && memcmp(active, expected.contents, active_count * sizeof(uint32_t)) != 0)) {
+            fprintf(stderr, "%s: the compiled and string evaluations disagree, with %u and %u files active\n",
+                    program_name, active_count, expected.size);
+            agree = false;
+        }
+        for (uint32_t i = 0; list && i < active_count; i++) {
+            printf("  %s\n", paths.contents[active[i]]);
+        }
+    }
+
+    ts_free(compiled_times);
+    ts_free(string_times);
+    array_delete(&expected);
+    paths_delete(&strings.keys);
+    paths_delete(&strings.values);
+    talon_scope_delete(scope);
+    talon_contexts_delete(contexts);
+    for (uint32_t i = 0; i < paths.size; i++) {
+        talon_file_delete(files[i]);
+    }
+    ts_free(files);
+    paths_delete(&changes);
+    paths_delete(&paths);
+    return agree ? 0 : 1;
+}
@@ -0,0 +1,295 @@
+// Generate test corpus files from a directory of Talon files.
+//
+// Usage: talon-corpus [-j THREADS] [-o DIR] ROOT
+//
+// Writes commands.txt, contexts.txt, settings.txt and files.txt to DIR, by
+// default the current directory, with a test for each command declaration,
+// context header, settings block and whole file of the .talon files under
+// ROOT. Tests are named after their file's path relative to the parent of
+// ROOT, so that `talon-corpus -o test/corpus/knausj_talon
+// examples/knausj_talon` names them "knausj_talon/...". Headers and the
+// blank lines around inputs follow the hand-written corpus.
+//
+// Each file is parsed once, on one of THREADS threads, and the tests are
+// cut from the nodes of its tree rather than by matching lines. Expected
+// trees are filled in by parsing each test's input, so the output reflects
+// the grammar as built. Files are emitted in sorted order, and numbered
+// per output file, so the output does not depend on the thread count.
+// Since tests are cut by node, they can be grouped differently from the
+// existing corpus, so write them elsewhere and copy over those wanted.
+
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "common.h"
+
+const char *program_name = "talon-corpus";
+
+enum { COMMANDS, CONTEXTS, SETTINGS, FILES, SECTION_COUNT };
+
+static const char *const SECTION_FILES[SECTION_COUNT] = {"commands.txt", "contexts.txt", "settings.txt", "files.txt"};
+static const char *const SECTION_KINDS[SECTION_COUNT] = {"Command", "Context", "Settings", "File"};
+
+#define BAR_LENGTH 80
+
+// The tests of one kind cut from one file, without their headers, which
+// are numbered once all files are done.
+typedef struct {
+    TalonBuffer text;
+    // The end of each test in text.
+    Array(uint32_t) ends;
+} Section;
+
+typedef struct {
+    const char *path;
+    int error;
+    Section sections[SECTION_COUNT];
+} Job;
+
+typedef struct {
+    Job *jobs;
+    uint32_t job_count;
+    atomic_uint next;
+} Run;
+
+static void write_bar(TalonBuffer *buffer, char c) {
+    char bar[BAR_LENGTH + 1];
+    memset(bar, c, BAR_LENGTH);
+    bar[BAR_LENGTH] = '\n';
+    buffer_write(buffer, bar, sizeof(bar));
+}
+
+// A worker's parser and the buffers it reuses for each test.
+typedef struct {
+    TSParser *parser;
+    TalonBuffer input;
+    TalonBuffer tree;
+} Worker;
+
+// The blank lines around the input of each kind of test, as in the
+// hand-written corpus.
+static const uint32_t SECTION_PADDING[SECTION_COUNT] = {2, 1, 1, 1};
+
+// Append a test with the given input and the tree it parses to. As in the
+// corpus, the input is framed by blank lines, and the tree is that of the
+// input up to the line break before the divider.
+static void add_test(Section *section, Worker *worker, int kind, const char *input, uint32_t length) {
+    TalonBuffer *text = &section->text;
+    worker->input.size = 0;
+    for (uint32_t i = 0; i < SECTION_PADDING[kind]; i++) {
+        buffer_putc(&worker->input, '\n');
+    }
+    buffer_write(&worker->input, input, length);
+    if (length > 0 && input[length - 1] != '\n') {
+        buffer_putc(&worker->input, '\n');
+    }
+    for (uint32_t i = 0; i < SECTION_PADDING[kind]; i++) {
+        buffer_putc(&worker->input, '\n');
+    }
+    buffer_write(text, worker->input.data, worker->input.size);
+    write_bar(text, '-');
+    buffer_putc(text, '\n');
+
+    TSTree *tree =
+        ts_parser_parse_string(worker->parser, NULL, worker->input.data, (uint32_t)worker->input.size - 1);
+    worker->tree.size = 0;
+    talon_write_sexp(&worker->tree, ts_tree_root_node(tree), worker->input.data, 0);
+    talon_sexp_format(text, worker->tree.data, worker->tree.size);
+    ts_tree_delete(tree);
+    array_push(&section->ends, (uint32_t)text->size);
+}
+
+static bool is_type(TSNode node, const char *type) {
+    return strcmp(ts_node_type(node), type) == 0;
+}
+
+static void add_node(Job *job, Worker *worker, int kind, const char *source, TSNode node) {
+    uint32_t start = ts_node_start_byte(node);
+    add_test(&job->sections[kind], worker, kind, source + start, ts_node_end_byte(node) - start);
+}
+
+static void cut_tests(Job *job, Worker *worker, const TalonFile *file) {
+    const char *source = file->source;
+    add_test(&job->sections[FILES], worker, FILES, source, file->length);
+
+    TSNode root = ts_tree_root_node(file->tree);
+    uint32_t count = ts_node_named_child_count(root);
+    for (uint32_t i = 0; i < count; i++) {
+        TSNode child = ts_node_named_child(root, i);
+        if (is_type(child, "matches")) {
+            // The header up to and including its "-" line.
+            add_test(&job->sections[CONTEXTS], worker, CONTEXTS, source, ts_node_end_byte(child));
+        } else if (is_type(child, "declarations")) {
+            uint32_t declaration_count = ts_node_named_child_count(child);
+            for (uint32_t j = 0; j < declaration_count; j++) {
+                TSNode declaration = ts_node_named_child(child, j);
+                if (is_type(declaration, "command_declaration")) {
+                    add_node(job, worker, COMMANDS, source, declaration);
+                } else if (is_type(declaration, "settings_declaration")) {
+                    add_node(job, worker, SETTINGS, source, declaration);
+                }
+            }
+        }
+    }
+}
+
+static void *worker(void *payload) {
+    Run *run = payload;
+    Worker state;
+    state.parser = talon_parser_new();
+    talon_buffer_init(&state.input, -1);
+    talon_buffer_init(&state.tree, -1);
+    for (;;) {
+        uint32_t index = atomic_fetch_add_explicit(&run->next, 1, memory_order_relaxed);
+        if (index >= run->job_count) {
+            break;
+        }
+        Job *job = &run->jobs[index];
+        TalonFile *file = talon_parse_file(state.parser, job->path);
+        if (file == NULL) {
+            job->error = errno;
+            continue;
+        }
+        cut_tests(job, &state, file);
+        talon_file_delete(file);
+    }
+    talon_buffer_delete(&state.input);
+    talon_buffer_delete(&state.tree);
+    ts_parser_delete(state.parser);
+    return NULL;
+}
+
+// The length of the prefix of root's paths to leave out of test names.
+static size_t name_offset(const char *root) {
+    size_t length = strlen(root);
+    while (length > 1 && root[length - 1] == '/') {
+        length--;
+    }
+    while (length > 0 && root[length - 1] != '/') {
+        length--;
+    }
+    return length;
+}
+
+int main(int argc, char **argv) {
+    unsigned threads = cpu_count();
+    const char *output = ".";
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-j") == 0 && arg + 1 < argc) {
+            threads = (unsigned)atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) {
+            output = argv[++arg];
+        } else {
+            break;
+        }
+    }
+    if (arg + 1 != argc) {
+        fprintf(stderr, "usage: %s [-j THREADS] [-o DIR] ROOT\n", program_name);
+        return 2;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    const char *root = argv[arg];
+    Paths paths = array_new();
+    if (!collect_files(root, ".talon", &paths)) {
+        return 1;
+    }
+    size_t offset = name_offset(root);
+
+    Job *jobs = ts_calloc(paths.size, sizeof(Job));
+    for (uint32_t i = 0; i < paths.size; i++) {
+        jobs[i].path = paths.contents[i];
+        for (int kind = 0; kind < SECTION_COUNT; kind++) {
+            talon_buffer_init(&jobs[i].sections[kind].text, -1);
+            array_init(&jobs[i].sections[kind].ends);
+        }
+    }
+    Run run = {jobs, paths.size, 0};
+    if (threads > paths.size) {
+        threads = paths.size > 0 ? paths.size : 1;
+    }
+    pthread_t *workers = ts_calloc(threads, sizeof(pthread_t));
+    for (unsigned i = 0; i < threads; i++) {
+        if (pthread_create(&workers[i], NULL, worker, &run) != 0) {
+            die("failed to start threads");
+        }
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    for (uint32_t i = 0; i < paths.size; i++) {
+        if (jobs[i].error != 0) {
+            die("%s: %s", jobs[i].path, strerror(jobs[i].error));
+        }
+    }
+
+    // Number the tests of each kind in file order. Kinds with no tests get
+    // no file.
+    for (int kind = 0; kind < SECTION_COUNT; kind++) {
+        uint32_t number = 0;
+        for (uint32_t i = 0; i < paths.size; i++) {
+            number += jobs[i].sections[kind].ends.size;
+        }
+        if (number == 0) {
+            continue;
+        }
+
+        size_t path_length = strlen(output) + strlen(SECTION_FILES[kind]) + 2;
+        char *path = ts_malloc(path_length);
+        snprintf(path, path_length, "%s/%s", output, SECTION_FILES[kind]);
+        FILE *stream = fopen(path, "wb");
+        if (stream == NULL) {
+            die("%s: %s", path, strerror(errno));
+        }
+        TalonBuffer out;
+        talon_buffer_init(&out, fileno(stream));
+        number = 0;
+        for (uint32_t i = 0; i < paths.size; i++) {
+            const Section *section = &jobs[i].sections[kind];
+            const char *name = paths.contents[i] + offset;
+            uint32_t start = 0;
+            for (uint32_t j = 0; j < section->ends.size; j++) {
+                if (number > 0) {
+                    buffer_putc(&out, '\n');
+                }
+                char title[64];
+                int title_length = snprintf(title, sizeof(title), "%u. %s ", ++number, SECTION_KINDS[kind]);
+                write_bar(&out, '=');
+                buffer_write(&out, title, (size_t)title_length);
+                buffer_write(&out, name, strlen(name));
+                buffer_putc(&out, '\n');
+                write_bar(&out, '=');
+                uint32_t end = section->ends.contents[j];
+                buffer_write(&out, section->text.data + start, end - start);
+                start = end;
+            }
+        }
+        if (!talon_buffer_flush(&out) || fclose(stream) != 0) {
+            die("%s: %s", path, strerror(errno));
+        }
+        fprintf(stderr, "%s: %u tests\n", path, number);
+        talon_buffer_delete(&out);
+        ts_free(path);
+    }
+
+    for (uint32_t i = 0; i < paths.size; i++) {
+        for (int kind = 0; kind < SECTION_COUNT; kind++) {
+            talon_buffer_delete(&jobs[i].sections[kind].text);
+            array_delete(&jobs[i].sections[kind].ends);
+        }
+    }
+    ts_free(jobs);
+    ts_free(workers);
+    paths_delete(&paths);
+    return 0;
+}
@@ -0,0 +1,264 @@
+// Generate a synthetic workspace of .talon files.
+//
+// Usage: talon-generate [-f FILES] [-c COMMANDS] [-d DEPTH] [-s STRINGS]
+//                       [-i INTERPOLATIONS] [-m COMMENTS] [-x MATCHES]
+//                       [-r SEED] DIR
+//
+// Writes FILES files, by default 10, into subdirectories of DIR holding up
+// to 1000 files each. Each file has a context header of MATCHES match
+// lines, by default 2, and none if MATCHES is 0, followed by COMMANDS
+// commands, by default 100. The shape of the commands is set by:
+//
+// - DEPTH: how deeply optional, choice and parenthesised rules nest in
+//   command rules, by default 2.
+// - STRINGS: the fraction of statements that insert a string, by default
+//   0.5.
+// - INTERPOLATIONS: the mean number of interpolations in a string, by
+//   default 1.
+// - COMMENTS: the mean number of comment lines per command, by default 0.1.
+//
+// The output depends only on the options and SEED, so that benchmarks over
+// generated workspaces are repeatable without network access.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "common.h"
+
+const char *program_name = "talon-generate";
+
+#define FILES_PER_DIRECTORY 1000
+
+typedef struct {
+    uint32_t files;
+    uint32_t commands;
+    uint32_t depth;
+    double strings;
+    double interpolations;
+    double comments;
+    uint32_t matches;
+} Shape;
+
+static const char *const WORDS[] = {
+    "go",    "select", "copy",  "paste", "tab",   "word",   "line",  "next",  "last",  "file",  "open",
+    "close", "save",   "find",  "undo",  "redo",  "window", "split", "focus", "clear", "move",  "up",
+    "down",  "left",   "right", "page",  "start", "end",    "head",  "tail",  "scroll", "snap",
+};
+
+#define WORD_COUNT (sizeof(WORDS) / sizeof(WORDS[0]))
+
+static const char *const KEYS[] = {"ctrl-a", "cmd-shift-p", "enter", "escape", "alt-left", "tab", "super-up"};
+
+#define KEY_COUNT (sizeof(KEYS) / sizeof(KEYS[0]))
+
+// A splitmix64 generator, seeded once, so output does not depend on the C
+// library's rand.
+static uint64_t state;
+
+static uint64_t next_random(void) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+static uint32_t below(uint32_t bound) {
+    return (uint32_t)(next_random() % bound);
+}
+
+static bool chance(double probability) {
+    return (double)(next_random() >> 11) / (double)(1ull << 53) < probability;
+}
+
+// Round a mean count up or down at random, keeping the mean.
+static uint32_t count_of(double mean) {
+    uint32_t count = (uint32_t)mean;
+    return count + chance(mean - count);
+}
+
+static void write_rule(FILE *stream, uint32_t depth, bool top_level);
+
+static void write_primary(FILE *stream, uint32_t depth) {
+    if (depth > 0 && chance(0.4)) {
+        bool optional = chance(0.5);
+        fputc(optional ? '[' : '(', stream);
+        uint32_t alternatives = 1 + below(3);
+        for (uint32_t i = 0; i < alternatives; i++) {
+            if (i > 0) {
+                fputs(" | ", stream);
+            }
+            write_rule(stream, depth - 1, false);
+        }
+        fputc(optional ? ']' : ')', stream);
+        return;
+    }
+    switch (below(8)) {
+        case 0:
+            fprintf(stream, "{user.list_%u}", below(20));
+            break;
+        case 1:
+            fprintf(stream, "<user.capture_%u>", below(20));
+            break;
+        default:
+            fputs(WORDS[below(WORD_COUNT)], stream);
+    }
+}
+
+static void write_rule(FILE *stream, uint32_t depth, bool top_level) {
+    uint32_t count = 1 + below(3);
+    for (uint32_t i = 0; i < count; i++) {
+        if (i > 0) {
+            fputc(' ', stream);
+        }
+        // Start commands with a word, as most real commands do.
+        if (top_level && i == 0) {
+            fputs(WORDS[below(WORD_COUNT)], stream);
+        } else {
+            write_primary(stream, depth);
+        }
+    }
+}
+
+static void write_string(FILE *stream, const Shape *shape) {
+    fputs("insert(\"", stream);
+    fputs(WORDS[below(WORD_COUNT)], stream);
+    uint32_t interpolations = count_of(shape->interpolations);
+    for (uint32_t i = 0; i < interpolations; i++) {
+        if (chance(0.5)) {
+            fprintf(stream, " {%s}", WORDS[below(WORD_COUNT)]);
+        } else {
+            fprintf(stream, " {user.format_%u(text)}", below(10));
+        }
+        fputc(' ', stream);
+        fputs(WORDS[below(WORD_COUNT)], stream);
+    }
+    fputs("\")", stream);
+}
+
+static void write_statement(FILE *stream, const Shape *shape) {
+    if (chance(shape->strings)) {
+        write_string(stream, shape);
+        return;
+    }
+    switch (below(4)) {
+        case 0:
+            fprintf(stream, "key(%s)", KEYS[below(KEY_COUNT)]);
+            break;
+        case 1:
+            fprintf(stream, "user.action_%u(%u, text)", below(50), below(100));
+            break;
+        case 2:
+            fprintf(stream, "sleep(%ums)", 10 * (1 + below(20)));
+            break;
+        default:
+            fprintf(stream, "edit.%s()", WORDS[below(WORD_COUNT)]);
+    }
+}
+
+static void write_comments(FILE *stream, const Shape *shape, const char *indent) {
+    uint32_t comments = count_of(shape->comments);
+    for (uint32_t i = 0; i < comments; i++) {
+        fprintf(stream, "%s# %s the %s\n", indent, WORDS[below(WORD_COUNT)], WORDS[below(WORD_COUNT)]);
+    }
+}
+
+static void write_matches(FILE *stream, const Shape *shape) {
+    static const char *const MATCHES[] = {
+        "app: app_%u", "tag: user.tag_%u", "mode: command", "os: mac", "title: /window %u/", "code.language: lang_%u",
+    };
+    for (uint32_t i = 0; i < shape->matches; i++) {
+        if (i > 0) {
+            fputs(below(3) == 0 ? "not " : "and ", stream);
+        }
+        fprintf(stream, MATCHES[below(sizeof(MATCHES) / sizeof(MATCHES[0]))], below(100));
+        fputc('\n', stream);
+    }
+    if (shape->matches > 0) {
+        fputs("-\n", stream);
+    }
+}
+
+static void write_file(FILE *stream, const Shape *shape) {
+    write_matches(stream, shape);
+    for (uint32_t i = 0; i < shape->commands; i++) {
+        write_comments(stream, shape, "");
+        write_rule(stream, shape->depth, true);
+        uint32_t statements = 1 + below(3);
+        if (statements == 1) {
+            fputs(": ", stream);
+            write_statement(stream, shape);
+            fputc('\n', stream);
+            continue;
+        }
+        fputs(":\n", stream);
+        for (uint32_t j = 0; j < statements; j++) {
+            if (j > 0) {
+                write_comments(stream, shape, "    ");
+            }
+            fputs("    ", stream);
+            write_statement(stream, shape);
+            fputc('\n', stream);
+        }
+    }
+}
+
+static void make_directory(const char *path) {
+    if (mkdir(path, 0777) < 0 && errno != EEXIST) {
+        die("%s: %s", path, strerror(errno));
+    }
+}
+
+int main(int argc, char **argv) {
+    Shape shape = {10, 100, 2, 0.5, 1, 0.1, 2};
+    uint64_t seed = 1;
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-' && argv[arg][1] != '\0' && argv[arg][2] == '\0'; arg += 2) {
+        const char *value = argv[arg + 1];
+        switch (argv[arg][1]) {
+            case 'f': shape.files = (uint32_t)strtoul(value, NULL, 10); break;
+            case 'c': shape.commands = (uint32_t)strtoul(value, NULL, 10); break;
+            case 'd': shape.depth = (uint32_t)strtoul(value, NULL, 10); break;
+            case 's': shape.strings = atof(value); break;
+            case 'i': shape.interpolations = atof(value); break;
+            case 'm': shape.comments = atof(value); break;
+            case 'x': shape.matches = (uint32_t)strtoul(value, NULL, 10); break;
+            case 'r': seed = strtoull(value, NULL, 10); break;
+            default: goto usage;
+        }
+    }
+    if (arg + 1 != argc) {
+    usage:
+        fprintf(stderr,
+                "usage: %s [-f FILES] [-c COMMANDS] [-d DEPTH] [-s STRINGS] [-i INTERPOLATIONS] [-m COMMENTS] "
+                "[-x MATCHES] [-r SEED] DIR\n",
+                program_name);
+        return 2;
+    }
+    state = seed;
+
+    const char *root = argv[arg];
+    make_directory(root);
+    size_t path_length = strlen(root) + 32;
+    char *path = ts_malloc(path_length);
+    for (uint32_t i = 0; i < shape.files; i++) {
+        if (i % FILES_PER_DIRECTORY == 0) {
+            snprintf(path, path_length, "%s/%04u", root, i / FILES_PER_DIRECTORY);
+            make_directory(path);
+        }
+        snprintf(path, path_length, "%s/%04u/file%07u.talon", root, i / FILES_PER_DIRECTORY, i);
+        FILE *stream = fopen(path, "w");
+        if (stream == NULL) {
+            die("%s: %s", path, strerror(errno));
+        }
+        write_file(stream, &shape);
+        if (fclose(stream) != 0) {
+            die("%s: %s", path, strerror(errno));
+        }
+    }
+    fprintf(stderr, "%u files, %llu commands\n", shape.files, (unsigned long long)shape.files * shape.commands);
+    ts_free(path);
+    return 0;
+}
@@ -0,0 +1,326 @@
+// Benchmark incremental parsing by replaying typing sessions.
+//
+// Usage: talon-keystrokes [-o JSON] PATH...
+//
+// Each PATH is a .talon file or a directory to search for them. On each
+// file, replays these sessions one keystroke at a time:
+//
+// - command: type a new command with a two-line body at the end of the file.
+// - rule: type a word at the end of the first command's rule, then delete
+//   it with backspace.
+// - indent: indent each line of the first multi-line command body by one
+//   space, from the last line up.
+// - string: type text before the closing quote of the first string.
+//
+// Each keystroke is applied to the previous tree with ts_tree_edit and
+// parsed incrementally, and the same text is also parsed from scratch for
+// comparison. Prints the p50 and p99 latency of both per session, and the
+// ratio of their total time, and with -o, writes the same as JSON to the
+// file JSON, or to stdout if JSON is "-". Keystrokes whose incremental tree
+// differs from the full parse are counted as mismatches, and make the exit
+// status 1.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+const char *program_name = "talon-keystrokes";
+
+enum { COMMAND, RULE, INDENT, STRING, SESSION_COUNT };
+
+static const char *const SESSION_NAMES[SESSION_COUNT] = {"command", "rule", "indent", "string"};
+
+#define BACKSPACE '\b'
+
+typedef Array(double) Latencies;
+
+typedef struct {
+    Latencies incremental;
+    Latencies full;
+    uint32_t mismatches;
+} Stats;
+
+typedef struct {
+    TSParser *parser;
+    Array(char) text;
+    TSTree *tree;
+    Stats *stats;
+} Document;
+
+static TSPoint point_at(const char *text, uint32_t offset) {
+    TSPoint point = {0, 0};
+    for (uint32_t i = 0; i < offset; i++) {
+        if (text[i] == '\n') {
+            point.row++;
+            point.column = 0;
+        } else {
+            point.column++;
+        }
+    }
+    return point;
+}
+
+// Type c at offset, or with BACKSPACE, delete the byte before offset.
+static void keystroke(Document *document, uint32_t offset, char c) {
+    TSInputEdit edit;
+    if (c == BACKSPACE) {
+        offset--;
+        edit.start_point = point_at(document->text.contents, offset);
+        edit.old_end_point = point_at(document->text.contents, offset + 1);
+        edit.new_end_point = edit.start_point;
+        edit.start_byte = edit.new_end_byte = offset;
+        edit.old_end_byte = offset + 1;
+        array_erase(&document->text, offset);
+    } else {
+        edit.start_point = edit.old_end_point = point_at(document->text.contents, offset);
+        edit.new_end_point = edit.start_point;
+        if (c == '\n') {
+            edit.new_end_point.row++;
+            edit.new_end_point.column = 0;
+        } else {
+            edit.new_end_point.column++;
+        }
+        edit.start_byte = edit.old_end_byte = offset;
+        edit.new_end_byte = offset + 1;
+        array_insert(&document->text, offset, c);
+    }
+    const char *text = document->text.contents;
+    uint32_t length = document->text.size;
+
+    double start = now();
+    ts_tree_edit(document->tree, &edit);
+    TSTree *tree = ts_parser_parse_string(document->parser, document->tree, text, length);
+    double incremental = now() - start;
+
+    start = now();
+    TSTree *full_tree = ts_parser_parse_string(document->parser, NULL, text, length);
+    double full = now() - start;
+
+    uint32_t flags = TALON_SEXP_FIELDS;
+    if (talon_sexp_hash(ts_tree_root_node(tree), text, flags) !=
+        talon_sexp_hash(ts_tree_root_node(full_tree), text, flags)) {
+        document->stats->mismatches++;
+    }
+    ts_tree_delete(full_tree);
+    ts_tree_delete(document->tree);
+    document->tree = tree;
+    array_push(&document->stats->incremental, incremental);
+    array_push(&document->stats->full, full);
+}
+
+static void type(Document *document, uint32_t offset, const char *text) {
+    for (; *text; text++) {
+        keystroke(document, offset++, *text);
+    }
+}
+
+static TSNode find_first(TSNode node, TSSymbol symbol) {
+    TSTreeCursor cursor = ts_tree_cursor_new(node);
+    TSNode result = {0};
+    for (;;) {
+        TSNode current = ts_tree_cursor_current_node(&cursor);
+        if (ts_node_symbol(current) == symbol) {
+            result = current;
+            break;
+        }
+        if (ts_tree_cursor_goto_first_child(&cursor)) {
+            continue;
+        }
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                goto done;
+            }
+        }
+    }
+done:
+    ts_tree_cursor_delete(&cursor);
+    return result;
+}
+
+typedef struct {
+    TSSymbol command;
+    TSSymbol string;
+} Symbols;
+
+static void replay(Document *document, Stats *stats, const Symbols *symbols, int session) {
+    document->stats = &stats[session];
+    TSNode root = ts_tree_root_node(document->tree);
+    switch (session) {
+        case COMMAND: {
+            uint32_t end = document->text.size;
+            if (end > 0 && document->text.contents[end - 1] != '\n') {
+                keystroke(document, end++, '\n');
+            }
+            type(document, end, "replay keystrokes:\n    key(ctrl-a)\n    insert(\"typed text\")\n");
+            break;
+        }
+        case RULE: {
+            TSNode command = find_first(root, symbols->command);
+            if (ts_node_is_null(command)) {
+                break;
+            }
+            uint32_t end = ts_node_end_byte(ts_node_child_by_field_name(command, "left", 4));
+            const char *word = " again";
+            type(document, end, word);
+            for (size_t i = strlen(word); i > 0; i--) {
+                keystroke(document, end + (uint32_t)i, BACKSPACE);
+            }
+            break;
+        }
+        case INDENT: {
+            // Find the first command whose body starts on its own line.
+            TSTreeCursor cursor = ts_tree_cursor_new(root);
+            TSNode block = {0};
+            for (bool more = true; more;) {
+                TSNode node = ts_tree_cursor_current_node(&cursor);
+                if (ts_node_symbol(node) == symbols->command) {
+                    TSNode body = ts_node_child_by_field_name(node, "right", 5);
+                    if (!ts_node_is_null(body) && ts_node_start_point(body).row > ts_node_start_point(node).row) {
+                        block = body;
+                        break;
+                    }
+                }
+                more = ts_tree_cursor_goto_first_child(&cursor);
+                while (!more && !(more = ts_tree_cursor_goto_next_sibling(&cursor))) {
+                    if (!ts_tree_cursor_goto_parent(&cursor)) {
+                        break;
+                    }
+                }
+            }
+            ts_tree_cursor_delete(&cursor);
+            if (ts_node_is_null(block)) {
+                break;
+            }
+            uint32_t first_row = ts_node_start_point(block).row, last_row = ts_node_end_point(block).row;
+            if (ts_node_end_point(block).column == 0 && last_row > first_row) {
+                last_row--;
+            }
+            for (uint32_t row = last_row + 1; row-- > first_row;) {
+                uint32_t offset = 0;
+                for (uint32_t line = 0; line < row; offset++) {
+                    line += document->text.contents[offset] == '\n';
+                }
+                keystroke(document, offset, ' ');
+            }
+            break;
+        }
+        case STRING: {
+            TSNode string = find_first(root, symbols->string);
+            if (!ts_node_is_null(string) && ts_node_end_byte(string) > ts_node_start_byte(string) + 1) {
+                type(document, ts_node_end_byte(string) - 1, " typed inside");
+            }
+            break;
+        }
+    }
+}
+
+static void print_json_latencies(FILE *stream, const char *key, Latencies *latencies) {
+    fprintf(stream, "\"%s_p50_ms\":%.6f,\"%s_p99_ms\":%.6f,", key,
+            percentile(latencies->contents, latencies->size, 0.50) * 1e3, key,
+            percentile(latencies->contents, latencies->size, 0.99) * 1e3);
+}
+
+static double sum(const Latencies *latencies) {
+    double total = 0;
+    for (uint32_t i = 0; i < latencies->size; i++) {
+        total += latencies->contents[i];
+    }
+    return total;
+}
+
+int main(int argc, char **argv) {
+    const char *json = NULL;
+    int arg = 1;
+    if (arg + 1 < argc && strcmp(argv[arg], "-o") == 0) {
+        json = argv[arg + 1];
+        arg += 2;
+    }
+    if (arg == argc || argv[arg][0] == '-') {
+        fprintf(stderr, "usage: %s [-o JSON] PATH...\n", program_name);
+        return 2;
+    }
+
+    Paths paths = array_new();
+    for (; arg < argc; arg++) {
+        if (!collect_files(argv[arg], ".talon", &paths)) {
+            return 1;
+        }
+    }
+
+    TSParser *parser = talon_parser_new();
+    const TSLanguage *language = ts_parser_language(parser);
+    Symbols symbols = {
+        ts_language_symbol_for_name(language, "command_declaration", 19, true),
+        ts_language_symbol_for_name(language, "string", 6, true),
+    };
+    Stats stats[SESSION_COUNT] = {0};
+    for (uint32_t i = 0; i < paths.size; i++) {
+        size_t length;
+        char *source = read_file(paths.contents[i], &length);
+        if (source == NULL) {
+            die("%s: %s", paths.contents[i], strerror(errno));
+        }
+        for (int session = 0; session < SESSION_COUNT; session++) {
+            Document document = {parser, array_new(), NULL, NULL};
+            array_extend(&document.text, (uint32_t)length, source);
+            document.tree = ts_parser_parse_string(parser, NULL, document.text.contents, document.text.size);
+            replay(&document, stats, &symbols, session);
+            ts_tree_delete(document.tree);
+            array_delete(&document.text);
+        }
+        ts_free(source);
+    }
+    ts_parser_delete(parser);
+
+    uint32_t mismatches = 0;
+    printf("%-8s %10s %12s %12s %12s %12s %7s\n", "session", "keystrokes", "incr p50 ms", "incr p99 ms",
+           "full p50 ms", "full p99 ms", "ratio");
+    for (int session = 0; session < SESSION_COUNT; session++) {
+        Stats *session_stats = &stats[session];
+        sort_doubles(session_stats->incremental.contents, session_stats->incremental.size);
+        sort_doubles(session_stats->full.contents, session_stats->full.size);
+        Latencies *incremental = &session_stats->incremental, *full = &session_stats->full;
+        double full_total = sum(full);
+        printf("%-8s %10u %12.4f %12.4f %12.4f %12.4f %7.3f\n", SESSION_NAMES[session], incremental->size,
+               percentile(incremental->contents, incremental->size, 0.50) * 1e3,
+               percentile(incremental->contents, incremental->size, 0.99) * 1e3,
+               percentile(full->contents, full->size, 0.50) * 1e3, percentile(full->contents, full->size, 0.99) * 1e3,
+               full_total > 0 ? sum(incremental) / full_total : 0);
+        mismatches += session_stats->mismatches;
+    }
+    if (mismatches > 0) {
+        printf("\n%u keystrokes gave a different tree than a full parse\n", mismatches);
+    }
+
+    if (json != NULL) {
+        FILE *stream = strcmp(json, "-") == 0 ? stdout : fopen(json, "w");
+        if (stream == NULL) {
+            die("%s: %s", json, strerror(errno));
+        }
+        fprintf(stream, "{\"files\":%u,\"sessions\":{", paths.size);
+        for (int session = 0; session < SESSION_COUNT; session++) {
+            Stats *session_stats = &stats[session];
+            double full_total = sum(&session_stats->full);
+            fprintf(stream, "%s\"%s\":{\"keystrokes\":%u,", session > 0 ? "," : "", SESSION_NAMES[session],
+                    session_stats->incremental.size);
+            print_json_latencies(stream, "incremental", &session_stats->incremental);
+            print_json_latencies(stream, "full", &session_stats->full);
+            fprintf(stream, "\"ratio\":%.6f,\"mismatches\":%u}",
+                    full_total > 0 ? sum(&session_stats->incremental) / full_total : 0, session_stats->mismatches);
+        }
+        fprintf(stream, "}}\n");
+        if (stream != stdout && fclose(stream) != 0) {
+            die("%s: %s", json, strerror(errno));
+        }
+    }
+
+    for (int session = 0; session < SESSION_COUNT; session++) {
+        array_delete(&stats[session].incremental);
+        array_delete(&stats[session].full);
+    }
+    paths_delete(&paths);
+    return mismatches > 0;
+}
@@ -0,0 +1,232 @@
+// Match spoken phrases against the command rules of .talon files.
+//
+// Usage: talon-match [-d DEFINITIONS] -p PHRASES [-n RUNS] [-s] PATH...
+//
+// Each PATH is a .talon file or a directory to search for them. The rule of
+// every command is compiled with talon_automaton_compile and added to one
+// TalonMatcher. DEFINITIONS defines lists and captures, one item or rule
+// per line:
+//
+//   {user.letter}: air
+//   {user.letter}: bat
+//   <user.number>: (one | two | three)+
+//
+// Lists and captures without a definition match one or more of any word.
+// Each line of PHRASES is a phrase of words separated by spaces, and the
+// tool prints the commands it matches with their bindings, such as
+//
+//   go air bat
+//     path/to/file.talon:3: go <user.letter>+  {user.letter}=air {user.letter}=bat
+//
+// With -s, it prints only the number of commands, states and matches, the
+// time to build the matcher and the phrases matched per second, the best
+// of RUNS passes over all phrases, by default 5.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+const char *program_name = "talon-match";
+
+typedef struct {
+    const char *path;
+    uint32_t line;
+    char *rule;
+} Command;
+
+// Compile the rule of a capture definition, by parsing it as the rule of
+// a command.
+static TalonAutomaton *compile_capture(TSParser *parser, TalonWords *words, const char *rule) {
+    size_t length = strlen(rule) + sizeof(": skip()\n");
+    char *source = ts_malloc(length);
+    snprintf(source, length, "%s: skip()\n", rule);
+    TalonAutomaton *automaton = NULL;
+    TalonFile *file = talon_parse_string(parser, source, (uint32_t)strlen(source));
+    if (file != NULL && file->command_count == 1) {
+        const TalonCommand *command = &file->commands[0];
+        TSNode node = ts_node_named_descendant_for_byte_range(ts_tree_root_node(file->tree), command->rule_start,
+                                                              command->rule_end);
+        automaton = talon_automaton_compile(words, node, source);
+    }
+    if (file != NULL) {
+        talon_file_delete(file);
+    }
+    ts_free(source);
+    return automaton;
+}
+
+static void read_definitions(const char *path, TSParser *parser, TalonWords *words, TalonMatcher *matcher) {
+    Paths lines = array_new();
+    if (!read_lines(path, &lines)) {
+        die("%s: %s", path, strerror(errno));
+    }
+    for (uint32_t i = 0; i < lines.size; i++) {
+        char *line = lines.contents[i];
+        char close = line[0] == '{' ? '}' : line[0] == '<' ? '>' : '\0';
+        char *end = close ? strchr(line, close) : NULL;
+        if (end == NULL || end[1] != ':') {
+            die("%s:%u: expected {list}: item or <capture>: rule", path, i + 1);
+        }
+        *end = '\0';
+        const char *name = line + 1, *value = end + 2 + strspn(end + 2, " ");
+        if (close == '}') {
+            talon_matcher_add_list_item(matcher, name, value);
+            continue;
+        }
+        TalonAutomaton *automaton = compile_capture(parser, words, value);
+        if (automaton == NULL) {
+            die("%s:%u: invalid rule: %s", path, i + 1, value);
+        }
+        talon_matcher_add_capture(matcher, name, automaton);
+        talon_automaton_delete(automaton);
+    }
+    paths_delete(&lines);
+}
+
+int main(int argc, char **argv) {
+    const char *definitions = NULL, *phrases_path = NULL;
+    unsigned runs = 5;
+    bool summary = false;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-d") == 0 && arg + 1 < argc) {
+            definitions = argv[++arg];
+        } else if (strcmp(argv[arg], "-p") == 0 && arg + 1 < argc) {
+            phrases_path = argv[++arg];
+        } else if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc) {
+            runs = (unsigned)atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-s") == 0) {
+            summary = true;
+        } else {
+            break;
+        }
+    }
+    if (arg == argc || argv[arg][0] == '-' || phrases_path == NULL || runs == 0) {
+        fprintf(stderr, "usage: %s [-d DEFINITIONS] -p PHRASES [-n RUNS] [-s] PATH...\n", program_name);
+        return 2;
+    }
+
+    Paths paths = array_new();
+    for (; arg < argc; arg++) {
+        if (!collect_files(argv[arg], ".talon", &paths)) {
+            return 1;
+        }
+    }
+
+    TSParser *parser = talon_parser_new();
+    TalonWords *words = talon_words_new();
+    TalonMatcher *matcher = talon_matcher_new(words);
+    if (definitions != NULL) {
+        read_definitions(definitions, parser, words, matcher);
+    }
+    Array(Command) commands = array_new();
+    for (uint32_t i = 0; i < paths.size; i++) {
+        const char *path = paths.contents[i];
+        TalonFile *file = talon_parse_file(parser, path);
+        if (file == NULL) {
+            die("%s: %s", path, strerror(errno));
+        }
+        TSNode root = ts_tree_root_node(file->tree);
+        for (uint32_t j = 0; j < file->command_count; j++) {
+            const TalonCommand *rule = &file->commands[j];
+            TSNode node = ts_node_named_descendant_for_byte_range(root, rule->rule_start, rule->rule_end);
+            TalonAutomaton *automaton = talon_automaton_compile(words, node, file->source);
+            if (automaton == NULL) {
+                continue;
+            }
+            int length = (int)(rule->rule_end - rule->rule_start);
+            Command command = {path, ts_node_start_point(node).row + 1, ts_malloc((size_t)length + 1)};
+            snprintf(command.rule, (size_t)length + 1, "%.*s", length, file->source + rule->rule_start);
+            talon_matcher_add_command(matcher, automaton);
+            array_push(&commands, command);
+            talon_automaton_delete(automaton);
+        }
+        talon_file_delete(file);
+    }
+    ts_parser_delete(parser);
+    double start = now();
+    talon_matcher_build(matcher);
+    double build_seconds = now() - start;
+
+    // Split every phrase into words up front, so that the timed passes only
+    // match. The phrases are read twice, to keep one copy whole for printing.
+    Paths phrases = array_new(), tokens = array_new();
+    if (!read_lines(phrases_path, &phrases) || !read_lines(phrases_path, &tokens)) {
+        die("%s: %s", phrases_path, strerror(errno));
+    }
+    Array(uint32_t) ids = array_new();
+    Array(const char *) strings = array_new();
+    Array(uint32_t) offsets = array_new();
+    for (uint32_t i = 0; i < tokens.size; i++) {
+        array_push(&offsets, ids.size);
+        for (char *word = strtok(tokens.contents[i], " \t\r"); word != NULL; word = strtok(NULL, " \t\r")) {
+            array_push(&ids, talon_words_find(words, word, (uint32_t)strlen(word)));
+            array_push(&strings, word);
+        }
+    }
+    array_push(&offsets, ids.size);
+
+    TalonPhraseMatches matches;
+    talon_phrase_matches_init(&matches);
+    if (summary) {
+        double best = 0;
+        uint64_t match_count = 0;
+        for (unsigned run = 0; run < runs; run++) {
+            match_count = 0;
+            start = now();
+            for (uint32_t i = 0; i < phrases.size; i++) {
+                uint32_t offset = offsets.contents[i];
+                match_count +=
+                    talon_matcher_match(matcher, ids.contents + offset, offsets.contents[i + 1] - offset, &matches);
+            }
+            double seconds = now() - start;
+            if (run == 0 || seconds < best) {
+                best = seconds;
+            }
+        }
+        printf("%u commands from %u files, %u states, built in %.2f ms\n", commands.size, paths.size,
+               talon_matcher_state_count(matcher), build_seconds * 1e3);
+        printf("%u phrases, %llu matches, %.0f phrases/s\n", phrases.size, (unsigned long long)match_count,
+               best > 0 ? phrases.size / best : 0.0);
+    } else {
+        for (uint32_t i = 0; i < phrases.size; i++) {
+            uint32_t offset = offsets.contents[i];
+            talon_matcher_match(matcher, ids.contents + offset, offsets.contents[i + 1] - offset, &matches);
+            printf("%s\n", phrases.contents[i]);
+            for (uint32_t j = 0; j < matches.match_count; j++) {
+                const TalonPhraseMatch *match = &matches.matches[j];
+                const Command *command = &commands.contents[match->command];
+                printf("  %s:%u: %s ", command->path, command->line, command->rule);
+                for (uint32_t k = match->binding_offset; k < match->binding_offset + match->binding_count; k++) {
+                    const TalonBinding *binding = &matches.bindings[k];
+                    uint32_t name_length;
+                    const char *name = talon_words_string(words, binding->name, &name_length);
+                    printf(" %c%.*s%c=", binding->kind == TALON_EDGE_LIST ? '{' : '<', (int)name_length, name,
+                           binding->kind == TALON_EDGE_LIST ? '}' : '>');
+                    for (uint32_t w = binding->start; w < binding->end; w++) {
+                        printf("%s%s", w > binding->start ? " " : "", strings.contents[offset + w]);
+                    }
+                }
+                putchar('\n');
+            }
+        }
+    }
+
+    talon_phrase_matches_delete(&matches);
+    array_delete(&ids);
+    array_delete(&strings);
+    array_delete(&offsets);
+    paths_delete(&phrases);
+    paths_delete(&tokens);
+    for (uint32_t i = 0; i < commands.size; i++) {
+        ts_free(commands.contents[i].rule);
+    }
+    array_delete(&commands);
+    talon_matcher_delete(matcher);
+    talon_words_delete(words);
+    paths_delete(&paths);
+    return 0;
+}
@@ -0,0 +1,217 @@
+// Report the memory taken by the trees of .talon files.
+//
+// Usage: talon-memory [-s TOP] [-o JSON] PATH...
+//
+// Each PATH is a .talon file or a directory to search for them. For each
+// file, counts the nodes of its tree in total and by symbol, and measures:
+//
+// - tree bytes: the bytes the runtime frees when the tree is deleted, which
+//   are its subtrees and their child arrays, measured by installing a
+//   counting allocator with ts_set_allocator.
+// - scanner bytes: the bytes of external scanner state serialised while
+//   parsing, which the runtime keeps with each external token, measured by
+//   wrapping the language's serialize function.
+//
+// Prints totals, the TOP files by tree bytes per KB of source, by default
+// 20, and the node counts of each symbol across all files. With -o, writes
+// every file and symbol as JSON to the file JSON, or to stdout if JSON is
+// "-". Node counts are of the nodes a tree cursor visits, so they leave out
+// hidden nodes, such as repetitions and the scanner's newline, indent and
+// dedent tokens, which still take tree bytes.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "tree_sitter/parser.h"
+
+const char *program_name = "talon-memory";
+
+const TSLanguage *tree_sitter_talon(void);
+
+static size_t scanner_bytes;
+static unsigned (*serialize)(void *, char *);
+
+static unsigned counting_serialize(void *payload, char *buffer) {
+    unsigned length = serialize(payload, buffer);
+    scanner_bytes += length;
+    return length;
+}
+
+typedef struct {
+    const char *path;
+    size_t source_bytes;
+    uint32_t nodes;
+    size_t tree_bytes;
+    size_t scanner_bytes;
+} Usage;
+
+static double per_kb(const Usage *usage) {
+    return usage->source_bytes > 0 ? usage->tree_bytes * 1024.0 / usage->source_bytes : 0;
+}
+
+static int compare_density(const void *a, const void *b) {
+    double x = per_kb(a), y = per_kb(b);
+    return (x < y) - (x > y);
+}
+
+typedef struct {
+    TSSymbol symbol;
+    uint64_t count;
+} SymbolCount;
+
+static int compare_count(const void *a, const void *b) {
+    const SymbolCount *x = a, *y = b;
+    return (x->count < y->count) - (x->count > y->count);
+}
+
+// Count the nodes of a tree by symbol. ERROR nodes have the symbol 65535,
+// past the symbols of the language, so they are counted in the extra slot
+// at symbol_count.
+static uint32_t count_nodes(TSTree *tree, SymbolCount *symbols, uint32_t symbol_count) {
+    uint32_t nodes = 0;
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+    for (;;) {
+        TSSymbol symbol = ts_node_symbol(ts_tree_cursor_current_node(&cursor));
+        symbols[symbol == ts_builtin_sym_error ? symbol_count : symbol].count++;
+        nodes++;
+        if (ts_tree_cursor_goto_first_child(&cursor)) {
+            continue;
+        }
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                ts_tree_cursor_delete(&cursor);
+                return nodes;
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned top = 20;
+    const char *json = NULL;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc) {
+            top = (unsigned)atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) {
+            json = argv[++arg];
+        } else {
+            break;
+        }
+    }
+    if (arg == argc || argv[arg][0] == '-') {
+        fprintf(stderr, "usage: %s [-s TOP] [-o JSON] PATH...\n", program_name);
+        return 2;
+    }
+
+    // Count the runtime's allocations from the start, so that every block
+    // it frees was counted when it was allocated.
+    count_allocations();
+    TSLanguage language = *tree_sitter_talon();
+    serialize = language.external_scanner.serialize;
+    language.external_scanner.serialize = counting_serialize;
+    TSParser *parser = ts_parser_new();
+    if (!ts_parser_set_language(parser, &language)) {
+        die("incompatible language version");
+    }
+
+    Paths paths = array_new();
+    for (; arg < argc; arg++) {
+        if (!collect_files(argv[arg], ".talon", &paths)) {
+            return 1;
+        }
+    }
+
+    // ts_language_symbol_name gives "ERROR" for the symbol of the last slot.
+    uint32_t symbol_count = ts_language_symbol_count(&language);
+    SymbolCount *symbols = ts_calloc(symbol_count + 1, sizeof(SymbolCount));
+    for (uint32_t i = 0; i < symbol_count; i++) {
+        symbols[i].symbol = (TSSymbol)i;
+    }
+    symbols[symbol_count].symbol = ts_builtin_sym_error;
+    Usage *usages = ts_calloc(paths.size + 1, sizeof(Usage));
+    Usage total = {"total", 0, 0, 0, 0};
+    for (uint32_t i = 0; i < paths.size; i++) {
+        Usage *usage = &usages[i];
+        usage->path = paths.contents[i];
+        char *source = read_file(usage->path, &usage->source_bytes);
+        if (source == NULL) {
+            die("%s: %s", usage->path, strerror(errno));
+        }
+        scanner_bytes = 0;
+        TSTree *tree = ts_parser_parse_string(parser, NULL, source, (uint32_t)usage->source_bytes);
+        usage->scanner_bytes = scanner_bytes;
+        usage->nodes = count_nodes(tree, symbols, symbol_count);
+        size_t before = allocated_bytes();
+        ts_tree_delete(tree);
+        usage->tree_bytes = before - allocated_bytes();
+        ts_free(source);
+
+        total.source_bytes += usage->source_bytes;
+        total.nodes += usage->nodes;
+        total.tree_bytes += usage->tree_bytes;
+        total.scanner_bytes += usage->scanner_bytes;
+    }
+    ts_parser_delete(parser);
+
+    qsort(usages, paths.size, sizeof(Usage), compare_density);
+    qsort(symbols, symbol_count + 1, sizeof(SymbolCount), compare_count);
+    if (top > paths.size) {
+        top = paths.size;
+    }
+
+    const char *format = "%-56s %10zu %8u %11zu %9zu %9.0f\n";
+    printf("%-56s %10s %8s %11s %9s %9s\n", "file", "source", "nodes", "tree bytes", "scanner", "bytes/KB");
+    for (uint32_t i = 0; i < top; i++) {
+        const Usage *usage = &usages[i];
+        printf(format, usage->path, usage->source_bytes, usage->nodes, usage->tree_bytes, usage->scanner_bytes,
+               per_kb(usage));
+    }
+    printf(format, total.path, total.source_bytes, total.nodes, total.tree_bytes, total.scanner_bytes, per_kb(&total));
+    printf("\n%-32s %10s %7s\n", "symbol", "nodes", "share");
+    for (uint32_t i = 0; i <= symbol_count && symbols[i].count > 0; i++) {
+        printf("%-32s %10llu %6.2f%%\n", ts_language_symbol_name(&language, symbols[i].symbol),
+               (unsigned long long)symbols[i].count, 100.0 * symbols[i].count / total.nodes);
+    }
+
+    if (json != NULL) {
+        FILE *stream = strcmp(json, "-") == 0 ? stdout : fopen(json, "w");
+        if (stream == NULL) {
+            die("%s: %s", json, strerror(errno));
+        }
+        fprintf(stream, "{\"files\":[");
+        for (uint32_t i = 0; i <= paths.size; i++) {
+            const Usage *usage = i < paths.size ? &usages[i] : &total;
+            if (i == paths.size) {
+                fprintf(stream, "],\"total\":");
+            } else if (i > 0) {
+                fputc(',', stream);
+            }
+            fprintf(stream, "{\"path\":");
+            print_json_string(stream, usage->path);
+            fprintf(stream, ",\"source_bytes\":%zu,\"nodes\":%u,\"tree_bytes\":%zu,\"scanner_bytes\":%zu}",
+                    usage->source_bytes, usage->nodes, usage->tree_bytes, usage->scanner_bytes);
+        }
+        fprintf(stream, ",\"symbols\":[");
+        for (uint32_t i = 0; i <= symbol_count && symbols[i].count > 0; i++) {
+            TSSymbol symbol = symbols[i].symbol;
+            fprintf(stream, "%s{\"type\":", i > 0 ? "," : "");
+            print_json_string(stream, ts_language_symbol_name(&language, symbol));
+            fprintf(stream, ",\"named\":%s,\"nodes\":%llu}",
+                    ts_language_symbol_type(&language, symbol) == TSSymbolTypeRegular ? "true" : "false",
+                    (unsigned long long)symbols[i].count);
+        }
+        fprintf(stream, "]}\n");
+        if (stream != stdout && fclose(stream) != 0) {
+            die("%s: %s", json, strerror(errno));
+        }
+    }
+
+    ts_free(symbols);
+    ts_free(usages);
+    paths_delete(&paths);
+    return 0;
+}
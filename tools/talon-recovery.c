@@ -0,0 +1,323 @@
+// Report what error recovery costs, by file and by construct.
+//
+// Usage: talon-recovery [-n RUNS] [-s TOP] [-k LIST] [-o JSON] [PATH...]
+//
+// Each PATH is a .talon file, a corpus .txt file, whose test inputs are
+// each taken as a file, or a directory to search for both, by default
+// test/corpus. With -k, .talon files are also read from LIST, one path per
+// line, such as script/known-failures-*.txt. Each input is parsed RUNS times, by default 5, after a warm
+// up, and its mean parse time and ERROR and MISSING nodes recorded.
+//
+// The inputs that parse without errors set a baseline time per byte, their
+// median. Each input with errors is compared with the time the baseline
+// predicts for its size, and the TOP inputs, by default 20, with the
+// highest ratio are listed. The time above the baseline is then shared
+// among the input's errors in proportion to the bytes they span, and added
+// up by construct: the type of the node an ERROR is in, or the type of a
+// MISSING node. Constructs are ranked by that excess time, which
+// approximates where recovery spends its work. With -o, writes every input
+// with errors and every construct as JSON to the file JSON, or to stdout if
+// JSON is "-".
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "corpus.h"
+
+const char *program_name = "talon-recovery";
+
+typedef struct {
+    char *name;
+    const char *source;
+    uint32_t length;
+    double seconds;
+    uint32_t errors;
+    uint32_t missing;
+    double ratio;
+} Input;
+
+typedef struct {
+    const char *construct;
+    bool missing;
+    uint32_t count;
+    uint64_t bytes;
+    double excess_seconds;
+} Construct;
+
+typedef Array(Construct) Constructs;
+
+// An error site in one input, before the input's excess time is known.
+typedef struct {
+    const char *construct;
+    bool missing;
+    uint32_t bytes;
+} Site;
+
+typedef Array(Site) Sites;
+
+static char *copy_string(const char *string) {
+    size_t size = strlen(string) + 1;
+    return memcpy(ts_malloc(size), string, size);
+}
+
+static Construct *find_construct(Constructs *constructs, const char *name, bool missing) {
+    for (uint32_t i = 0; i < constructs->size; i++) {
+        Construct *construct = &constructs->contents[i];
+        if (construct->missing == missing && strcmp(construct->construct, name) == 0) {
+            return construct;
+        }
+    }
+    Construct construct = {name, missing, 0, 0, 0};
+    array_push(constructs, construct);
+    return array_back(constructs);
+}
+
+// Collect the ERROR and MISSING nodes of a tree. ERROR nodes inside ERROR
+// nodes are left out, since their parent already spans them.
+static void collect_sites(TSTree *tree, Input *input, Sites *sites) {
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+    TSNode root = ts_tree_root_node(tree);
+    for (;;) {
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+        bool descend = true;
+        if (ts_node_is_error(node)) {
+            TSNode parent = ts_node_parent(node);
+            Site site = {ts_node_is_null(parent) ? ts_node_type(root) : ts_node_type(parent), false,
+                         ts_node_end_byte(node) - ts_node_start_byte(node)};
+            array_push(sites, site);
+            input->errors++;
+            descend = false;
+        } else if (ts_node_is_missing(node)) {
+            Site site = {ts_node_type(node), true, 0};
+            array_push(sites, site);
+            input->missing++;
+        }
+        if (descend && ts_tree_cursor_goto_first_child(&cursor)) {
+            continue;
+        }
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                ts_tree_cursor_delete(&cursor);
+                return;
+            }
+        }
+    }
+}
+
+// Sort inputs with errors first, by ratio.
+static int compare_ratio(const void *a, const void *b) {
+    const Input *x = a, *y = b;
+    bool x_failing = x->errors + x->missing > 0, y_failing = y->errors + y->missing > 0;
+    if (x_failing != y_failing) {
+        return y_failing - x_failing;
+    }
+    return (x->ratio < y->ratio) - (x->ratio > y->ratio);
+}
+
+static int compare_excess(const void *a, const void *b) {
+    const Construct *x = a, *y = b;
+    return (x->excess_seconds < y->excess_seconds) - (x->excess_seconds > y->excess_seconds);
+}
+
+static bool has_suffix(const char *path, const char *suffix) {
+    size_t length = strlen(path), suffix_length = strlen(suffix);
+    return length >= suffix_length && strcmp(path + length - suffix_length, suffix) == 0;
+}
+
+int main(int argc, char **argv) {
+    unsigned runs = 5, top = 20;
+    const char *json = NULL;
+    Paths paths = array_new();
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc) {
+            runs = (unsigned)atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc) {
+            top = (unsigned)atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-k") == 0 && arg + 1 < argc) {
+            if (!read_lines(argv[++arg], &paths)) {
+                die("%s: %s", argv[arg], strerror(errno));
+            }
+        } else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) {
+            json = argv[++arg];
+        } else {
+            fprintf(stderr, "usage: %s [-n RUNS] [-s TOP] [-k LIST] [-o JSON] [PATH...]\n", program_name);
+            return 2;
+        }
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+
+    if (arg == argc && paths.size == 0 &&
+        (!collect_files("test/corpus", ".talon", &paths) || !collect_files("test/corpus", ".txt", &paths))) {
+        return 1;
+    }
+    for (; arg < argc; arg++) {
+        if (!collect_files(argv[arg], ".talon", &paths) || !collect_files(argv[arg], ".txt", &paths)) {
+            return 1;
+        }
+    }
+
+    // Read the inputs, keeping each file's text for as long as its inputs
+    // point into it.
+    Array(Input) inputs = array_new();
+    Array(char *) texts = array_new();
+    for (uint32_t i = 0; i < paths.size; i++) {
+        const char *path = paths.contents[i];
+        size_t length;
+        char *text = read_file(path, &length);
+        if (text == NULL) {
+            die("%s: %s", path, strerror(errno));
+        }
+        array_push(&texts, text);
+        if (!has_suffix(path, ".txt")) {
+            Input input = {copy_string(path), text, (uint32_t)length, 0, 0, 0, 0};
+            array_push(&inputs, input);
+            continue;
+        }
+        CorpusTests tests = array_new();
+        if (!corpus_parse(text, length, &tests)) {
+            die("%s: malformed corpus file", path);
+        }
+        for (uint32_t j = 0; j < tests.size; j++) {
+            const CorpusTest *test = &tests.contents[j];
+            size_t size = strlen(path) + test->name_length + 16;
+            Input input = {ts_malloc(size), test->input, test->input_length, 0, 0, 0, 0};
+            snprintf(input.name, size, "%s:%u: %.*s", path, test->line, (int)test->name_length, test->name);
+            array_push(&inputs, input);
+        }
+        array_delete(&tests);
+    }
+
+    TSParser *parser = talon_parser_new();
+    Sites sites = array_new();
+    Array(uint32_t) site_ends = array_new();
+    for (uint32_t i = 0; i < inputs.size; i++) {
+        Input *input = &inputs.contents[i];
+        ts_tree_delete(ts_parser_parse_string(parser, NULL, input->source, input->length));
+        double start = now();
+        for (unsigned run = 0; run < runs; run++) {
+            ts_tree_delete(ts_parser_parse_string(parser, NULL, input->source, input->length));
+        }
+        input->seconds = (now() - start) / runs;
+        TSTree *tree = ts_parser_parse_string(parser, NULL, input->source, input->length);
+        collect_sites(tree, input, &sites);
+        array_push(&site_ends, sites.size);
+        ts_tree_delete(tree);
+    }
+    ts_parser_delete(parser);
+
+    // The baseline is the median time per byte of the clean inputs.
+    Array(double) clean = array_new();
+    for (uint32_t i = 0; i < inputs.size; i++) {
+        const Input *input = &inputs.contents[i];
+        if (input->errors == 0 && input->missing == 0 && input->length > 0) {
+            array_push(&clean, input->seconds / input->length);
+        }
+    }
+    sort_doubles(clean.contents, clean.size);
+    double seconds_per_byte = percentile(clean.contents, clean.size, 0.5);
+
+    Constructs constructs = array_new();
+    uint32_t failing = 0;
+    for (uint32_t i = 0, site = 0; i < inputs.size; i++) {
+        Input *input = &inputs.contents[i];
+        uint32_t end = site_ends.contents[i];
+        if (input->errors == 0 && input->missing == 0) {
+            continue;
+        }
+        failing++;
+        double expected = seconds_per_byte * (input->length > 0 ? input->length : 1);
+        input->ratio = expected > 0 ? input->seconds / expected : 0;
+        double excess = input->seconds > expected ? input->seconds - expected : 0;
+
+        // Share the excess time by the bytes each error spans, counting a
+        // missing node as one byte.
+        uint64_t bytes = 0;
+        for (uint32_t j = site; j < end; j++) {
+            bytes += sites.contents[j].bytes > 0 ? sites.contents[j].bytes : 1;
+        }
+        for (; site < end; site++) {
+            const Site *error = &sites.contents[site];
+            Construct *construct = find_construct(&constructs, error->construct, error->missing);
+            construct->count++;
+            construct->bytes += error->bytes;
+            construct->excess_seconds += excess * (error->bytes > 0 ? error->bytes : 1) / bytes;
+        }
+    }
+
+    qsort(inputs.contents, inputs.size, sizeof(Input), compare_ratio);
+    qsort(constructs.contents, constructs.size, sizeof(Construct), compare_excess);
+    if (top > failing) {
+        top = failing;
+    }
+
+    printf("%u inputs, %u with errors; clean baseline %.2f ns/byte from %u inputs\n", inputs.size, failing,
+           seconds_per_byte * 1e9, clean.size);
+    if (top > 0) {
+        printf("\n%-72s %7s %7s %8s %10s %7s\n", "input", "errors", "missing", "bytes", "time (ms)", "ratio");
+        for (uint32_t i = 0; i < top; i++) {
+            const Input *input = &inputs.contents[i];
+            printf("%-72s %7u %7u %8u %10.3f %7.2f\n", input->name, input->errors, input->missing, input->length,
+                   input->seconds * 1e3, input->ratio);
+        }
+    }
+    if (constructs.size > 0) {
+        printf("\n%-40s %7s %10s %12s\n", "construct", "count", "bytes", "excess (ms)");
+        for (uint32_t i = 0; i < constructs.size; i++) {
+            const Construct *construct = &constructs.contents[i];
+            char name[64];
+            snprintf(name, sizeof(name), "%s%s", construct->missing ? "MISSING " : "ERROR in ", construct->construct);
+            printf("%-40s %7u %10llu %12.3f\n", name, construct->count, (unsigned long long)construct->bytes,
+                   construct->excess_seconds * 1e3);
+        }
+    }
+
+    if (json != NULL) {
+        FILE *stream = strcmp(json, "-") == 0 ? stdout : fopen(json, "w");
+        if (stream == NULL) {
+            die("%s: %s", json, strerror(errno));
+        }
+        fprintf(stream, "{\"inputs\":%u,\"baseline_ns_per_byte\":%.6f,\"failing\":[", inputs.size,
+                seconds_per_byte * 1e9);
+        for (uint32_t i = 0; i < failing; i++) {
+            const Input *input = &inputs.contents[i];
+            fprintf(stream, "%s{\"name\":", i > 0 ? "," : "");
+            print_json_string(stream, input->name);
+            fprintf(stream, ",\"errors\":%u,\"missing\":%u,\"bytes\":%u,\"ms\":%.6f,\"ratio\":%.6f}", input->errors,
+                    input->missing, input->length, input->seconds * 1e3, input->ratio);
+        }
+        fprintf(stream, "],\"constructs\":[");
+        for (uint32_t i = 0; i < constructs.size; i++) {
+            const Construct *construct = &constructs.contents[i];
+            fprintf(stream, "%s{\"construct\":", i > 0 ? "," : "");
+            print_json_string(stream, construct->construct);
+            fprintf(stream, ",\"missing\":%s,\"count\":%u,\"bytes\":%llu,\"excess_ms\":%.6f}",
+                    construct->missing ? "true" : "false", construct->count, (unsigned long long)construct->bytes,
+                    construct->excess_seconds * 1e3);
+        }
+        fprintf(stream, "]}\n");
+        if (stream != stdout && fclose(stream) != 0) {
+            die("%s: %s", json, strerror(errno));
+        }
+    }
+
+    for (uint32_t i = 0; i < inputs.size; i++) {
+        ts_free(inputs.contents[i].name);
+    }
+    for (uint32_t i = 0; i < texts.size; i++) {
+        ts_free(texts.contents[i]);
+    }
+    array_delete(&inputs);
+    array_delete(&texts);
+    array_delete(&sites);
+    array_delete(&site_ends);
+    array_delete(&clean);
+    array_delete(&constructs);
+    paths_delete(&paths);
+    return 0;
+}
@@ -0,0 +1,153 @@
+// Compile the command rules of .talon files to automata.
+//
+// Usage: talon-rules [-p] [-s TOP] PATH...
+//
+// Each PATH is a .talon file or a directory to search for them. The rule of
+// every command is compiled with talon_automaton_compile, with one word
+// table for all files, and the tool prints the number of rules compiled and
+// skipped for errors, the states and edges before and after determinizing
+// and minimizing, the rules left nondeterministic, the time per rule, and
+// the TOP rules with the most states, by default 10. With -p, also prints
+// every automaton, one state per line, such as
+//
+//   path/to/file.talon:3: go <user.letter> [now]
+//     0 -> 1 go
+//     1 -> 2 <user.letter>
+//     2 accept -> 3 now
+//     3 accept
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+const char *program_name = "talon-rules";
+
+typedef struct {
+    const char *path;
+    uint32_t line;
+    char *rule;
+    uint32_t state_count;
+    uint32_t edge_count;
+} Rule;
+
+static int compare_largest(const void *a, const void *b) {
+    const Rule *x = a, *y = b;
+    return (x->state_count < y->state_count) - (x->state_count > y->state_count);
+}
+
+static void print_automaton(const TalonAutomaton *automaton, const TalonWords *words) {
+    static const char *const OPEN[] = {"", "{", "<"}, *const CLOSE[] = {"", "}", ">"};
+    for (uint32_t state = 0; state < automaton->state_count; state++) {
+        printf("  %u%s", state, automaton->accepting[state] ? " accept" : "");
+        for (uint32_t i = automaton->edge_offsets[state]; i < automaton->edge_offsets[state + 1]; i++) {
+            const TalonEdge *edge = &automaton->edges[i];
+            uint32_t length;
+            const char *label = talon_words_string(words, edge->id, &length);
+            printf("%s -> %u %s%.*s%s", i > automaton->edge_offsets[state] ? "," : "", edge->target,
+                   OPEN[edge->kind], (int)length, label, CLOSE[edge->kind]);
+        }
+        putchar('\n');
+    }
+}
+
+int main(int argc, char **argv) {
+    bool print = false;
+    unsigned top = 10;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-p") == 0) {
+            print = true;
+        } else if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc) {
+            top = (unsigned)atoi(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+    if (arg == argc || argv[arg][0] == '-') {
+        fprintf(stderr, "usage: %s [-p] [-s TOP] PATH...\n", program_name);
+        return 2;
+    }
+
+    Paths paths = array_new();
+    for (; arg < argc; arg++) {
+        if (!collect_files(argv[arg], ".talon", &paths)) {
+            return 1;
+        }
+    }
+
+    TSParser *parser = talon_parser_new();
+    TalonWords *words = talon_words_new();
+    Array(Rule) rules = array_new();
+    uint32_t skipped = 0, nondeterministic = 0;
+    uint64_t nfa_states = 0, states = 0, edges = 0;
+    double seconds = 0;
+    for (uint32_t i = 0; i < paths.size; i++) {
+        const char *path = paths.contents[i];
+        TalonFile *file = talon_parse_file(parser, path);
+        if (file == NULL) {
+            die("%s: %s", path, strerror(errno));
+        }
+        TSNode root = ts_tree_root_node(file->tree);
+        for (uint32_t j = 0; j < file->command_count; j++) {
+            const TalonCommand *command = &file->commands[j];
+            TSNode node = ts_node_named_descendant_for_byte_range(root, command->rule_start, command->rule_end);
+            double start = now();
+            TalonAutomaton *automaton = talon_automaton_compile(words, node, file->source);
+            seconds += now() - start;
+            if (automaton == NULL) {
+                skipped++;
+                continue;
+            }
+            uint32_t line = ts_node_start_point(node).row + 1;
+            int length = (int)(command->rule_end - command->rule_start);
+            const char *text = file->source + command->rule_start;
+            if (print) {
+                printf("%s:%u: %.*s\n", path, line, length, text);
+                print_automaton(automaton, words);
+            }
+            Rule rule = {path, line, ts_malloc((size_t)length + 1), automaton->state_count,
+                         automaton->edge_offsets[automaton->state_count]};
+            snprintf(rule.rule, (size_t)length + 1, "%.*s", length, text);
+            array_push(&rules, rule);
+            nfa_states += automaton->nfa_state_count;
+            states += rule.state_count;
+            edges += rule.edge_count;
+            nondeterministic += !automaton->deterministic;
+            talon_automaton_delete(automaton);
+        }
+        talon_file_delete(file);
+    }
+    ts_parser_delete(parser);
+
+    if (print) {
+        putchar('\n');
+    }
+    printf("Compiled %u rules from %u files, skipped %u with errors, %u words\n", rules.size, paths.size, skipped,
+           talon_words_count(words));
+    printf("%llu NFA states, %llu states and %llu edges after minimizing, %u rules nondeterministic\n",
+           (unsigned long long)nfa_states, (unsigned long long)states, (unsigned long long)edges, nondeterministic);
+    printf("%.2f us per rule\n", rules.size > 0 ? seconds * 1e6 / (rules.size + skipped) : 0.0);
+
+    qsort(rules.contents, rules.size, sizeof(Rule), compare_largest);
+    if (top > rules.size) {
+        top = rules.size;
+    }
+    if (top > 0) {
+        printf("\n%8s %8s  %s\n", "states", "edges", "largest rules");
+        for (uint32_t i = 0; i < top; i++) {
+            const Rule *rule = &rules.contents[i];
+            printf("%8u %8u  %s:%u: %s\n", rule->state_count, rule->edge_count, rule->path, rule->line, rule->rule);
+        }
+    }
+
+    for (uint32_t i = 0; i < rules.size; i++) {
+        ts_free(rules.contents[i].rule);
+    }
+    array_delete(&rules);
+    talon_words_delete(words);
+    paths_delete(&paths);
+    return 0;
+}
@@ -0,0 +1,56 @@
+// Measure the time to the first parsed tree with the C library.
+//
+// Usage: talon-startup LIBRARY FILE
+//
+// Loads the shared LIBRARY, such as libtree-sitter-talon.so, constructs the
+// language and a parser, and parses FILE, then prints the time each step
+// took as JSON. Run it in a fresh process each time, as script/bench-startup
+// does, so that loading is cold.
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+
+const char *program_name = "talon-startup";
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s LIBRARY FILE\n", program_name);
+        return 2;
+    }
+    size_t length;
+    char *source = read_file(argv[2], &length);
+    if (source == NULL) {
+        die("%s: %s", argv[2], strerror(errno));
+    }
+
+    double start = now();
+    void *library = dlopen(argv[1], RTLD_NOW | RTLD_LOCAL);
+    if (library == NULL) {
+        die("%s", dlerror());
+    }
+    const TSLanguage *(*language_function)(void) = (const TSLanguage *(*)(void))dlsym(library, "tree_sitter_talon");
+    if (language_function == NULL) {
+        die("%s", dlerror());
+    }
+    double loaded = now();
+
+    TSParser *parser = ts_parser_new();
+    if (!ts_parser_set_language(parser, language_function())) {
+        die("incompatible language version");
+    }
+    double constructed = now();
+
+    TSTree *tree = ts_parser_parse_string(parser, NULL, source, (uint32_t)length);
+    double parsed = now();
+
+    printf("{\"load_ms\":%.6f,\"language_ms\":%.6f,\"parse_ms\":%.6f}\n", (loaded - start) * 1e3,
+           (constructed - loaded) * 1e3, (parsed - constructed) * 1e3);
+    ts_tree_delete(tree);
+    ts_parser_delete(parser);
+    ts_free(source);
+    return 0;
+}
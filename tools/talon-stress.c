@@ -0,0 +1,197 @@
+// Parse pathological inputs against time budgets.
+//
+// Usage: talon-stress [-b FACTOR] [-f FILTER] [-o JSON]
+//
+// Builds each input in memory and parses it once, reporting the parse
+// time, the peak bytes the runtime allocated while parsing, and whether
+// the tree has errors. Inputs that take longer than their budget, scaled
+// by FACTOR, by default 1, fail and make the exit status 1. The budgets
+// allow for linear time on a slow machine, so a failure points to
+// super-linear behaviour in the scanner or grammar. With -f, only inputs
+// whose names contain FILTER are run, and with -o, the results are written
+// as JSON to the file JSON, or to stdout if JSON is "-".
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+const char *program_name = "talon-stress";
+
+typedef Array(char) Text;
+
+static void append(Text *text, const char *string) {
+    array_extend(text, (uint32_t)strlen(string), string);
+}
+
+static void append_repeated(Text *text, const char *string, uint32_t count) {
+    uint32_t length = (uint32_t)strlen(string);
+    array_reserve(text, text->size + length * count);
+    for (uint32_t i = 0; i < count; i++) {
+        array_extend(text, length, string);
+    }
+}
+
+// A command rule of words on a single 1 MB line.
+static void long_line(Text *text) {
+    append(text, "start");
+    while (text->size < 1 << 20) {
+        append(text, " word");
+    }
+    append(text, ": key(enter)\n");
+}
+
+static void deep_rule(Text *text) {
+    append(text, "start ");
+    append_repeated(text, "(", 10000);
+    append(text, "word");
+    append_repeated(text, ")", 10000);
+    append(text, ": key(enter)\n");
+}
+
+static void deep_expression(Text *text) {
+    append(text, "start: ");
+    append_repeated(text, "(", 10000);
+    append(text, "1");
+    append_repeated(text, ")", 10000);
+    append(text, "\n");
+}
+
+static void interpolations(Text *text) {
+    append(text, "start: insert(\"");
+    append_repeated(text, "{user.text} ", 100000);
+    append(text, "\")\n");
+}
+
+// Comments between the last statement of a block and the dedent after it,
+// which the scanner reads ahead over to place the dedent.
+static void comments_before_dedent(Text *text) {
+    append(text, "start:\n    key(enter)\n");
+    append_repeated(text, "# comment\n", 50000);
+    append(text, "stop: key(escape)\n");
+}
+
+static void indented_comments_before_dedent(Text *text) {
+    append(text, "start:\n    key(enter)\n");
+    append_repeated(text, "    # comment\n", 50000);
+    append(text, "stop: key(escape)\n");
+}
+
+static void unterminated_string(Text *text) {
+    append(text, "start: insert(\"unterminated\n");
+    while (text->size < 1 << 20) {
+        append(text, "go left: key(left)\ninsert text:\n    insert(\"text {user.text}\")\n    key(enter)\n");
+    }
+}
+
+static void crlf_form_feed(Text *text) {
+    static const char *const LINE_ENDS[] = {"\r\n", "\n", "\r\n\f", "\f\n"};
+    for (uint32_t i = 0; text->size < 1 << 20; i++) {
+        append(text, "go left:");
+        append(text, LINE_ENDS[i % 4]);
+        append(text, "    key(left)");
+        append(text, LINE_ENDS[(i + 1) % 4]);
+        append(text, "    insert(\"text\")");
+        append(text, LINE_ENDS[(i + 2) % 4]);
+    }
+}
+
+typedef struct {
+    const char *name;
+    void (*build)(Text *text);
+    double budget;
+} Case;
+
+static const Case CASES[] = {
+    {"long_line", long_line, 2.0},
+    {"deep_rule", deep_rule, 1.0},
+    {"deep_expression", deep_expression, 1.0},
+    {"interpolations", interpolations, 2.0},
+    {"comments_before_dedent", comments_before_dedent, 2.0},
+    {"indented_comments_before_dedent", indented_comments_before_dedent, 2.0},
+    {"unterminated_string", unterminated_string, 4.0},
+    {"crlf_form_feed", crlf_form_feed, 2.0},
+};
+
+#define CASE_COUNT (sizeof(CASES) / sizeof(CASES[0]))
+
+typedef struct {
+    const Case *test;
+    uint32_t bytes;
+    double seconds;
+    size_t peak_bytes;
+    bool has_error;
+    bool passed;
+} Result;
+
+int main(int argc, char **argv) {
+    double factor = 1;
+    const char *filter = NULL, *json = NULL;
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-b") == 0 && arg + 1 < argc) {
+            factor = atof(argv[++arg]);
+        } else if (strcmp(argv[arg], "-f") == 0 && arg + 1 < argc) {
+            filter = argv[++arg];
+        } else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) {
+            json = argv[++arg];
+        } else {
+            fprintf(stderr, "usage: %s [-b FACTOR] [-f FILTER] [-o JSON]\n", program_name);
+            return 2;
+        }
+    }
+
+    count_allocations();
+    TSParser *parser = talon_parser_new();
+    Result results[CASE_COUNT];
+    uint32_t result_count = 0, failures = 0;
+    printf("%-32s %10s %10s %10s %12s %6s\n", "input", "bytes", "time (ms)", "budget", "peak bytes", "errors");
+    for (uint32_t i = 0; i < CASE_COUNT; i++) {
+        const Case *test = &CASES[i];
+        if (filter != NULL && strstr(test->name, filter) == NULL) {
+            continue;
+        }
+        Text text = array_new();
+        test->build(&text);
+
+        reset_peak_allocated_bytes();
+        size_t baseline = allocated_bytes();
+        double start = now();
+        TSTree *tree = ts_parser_parse_string(parser, NULL, text.contents, text.size);
+        double seconds = now() - start;
+        Result *result = &results[result_count++];
+        *result = (Result){test, text.size, seconds, peak_allocated_bytes() - baseline,
+                           ts_node_has_error(ts_tree_root_node(tree)), seconds <= test->budget * factor};
+        ts_tree_delete(tree);
+        array_delete(&text);
+
+        printf("%-32s %10u %10.2f %10.0f %12zu %6s%s\n", test->name, result->bytes, seconds * 1e3,
+               test->budget * factor * 1e3, result->peak_bytes, result->has_error ? "yes" : "no",
+               result->passed ? "" : "  OVER BUDGET");
+        failures += !result->passed;
+    }
+    ts_parser_delete(parser);
+
+    if (json != NULL) {
+        FILE *stream = strcmp(json, "-") == 0 ? stdout : fopen(json, "w");
+        if (stream == NULL) {
+            die("%s: %s", json, strerror(errno));
+        }
+        fputc('[', stream);
+        for (uint32_t i = 0; i < result_count; i++) {
+            const Result *result = &results[i];
+            fprintf(stream,
+                    "%s{\"name\":\"%s\",\"bytes\":%u,\"ms\":%.6f,\"budget_ms\":%.3f,\"peak_bytes\":%zu,"
+                    "\"has_error\":%s,\"passed\":%s}",
+                    i > 0 ? "," : "", result->test->name, result->bytes, result->seconds * 1e3,
+                    result->test->budget * factor * 1e3, result->peak_bytes, result->has_error ? "true" : "false",
+                    result->passed ? "true" : "false");
+        }
+        fprintf(stream, "]\n");
+        if (stream != stdout && fclose(stream) != 0) {
+            die("%s: %s", json, strerror(errno));
+        }
+    }
+    return failures > 0;
+}
@@ -0,0 +1,48 @@
+// Export the nodes of .talon files as a columnar table.
+//
+// Usage: talon-table OUTPUT PATH...
+//
+// Each PATH is a .talon file or a directory to search for them. The table
+// format is described by TalonTableHeader in bindings/c/talon.h.
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+
+const char *program_name = "talon-table";
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s OUTPUT PATH...\n", program_name);
+        return 2;
+    }
+
+    Paths paths = array_new();
+    for (int i = 2; i < argc; i++) {
+        if (!collect_files(argv[i], ".talon", &paths)) {
+            return 1;
+        }
+    }
+
+    TSParser *parser = talon_parser_new();
+    TalonTable *table = talon_table_new(ts_parser_language(parser));
+    for (uint32_t i = 0; i < paths.size; i++) {
+        TalonFile *file = talon_parse_file(parser, paths.contents[i]);
+        if (file == NULL) {
+            die("%s: %s", paths.contents[i], strerror(errno));
+        }
+        talon_table_add(table, paths.contents[i], file->tree);
+        talon_file_delete(file);
+    }
+    if (!talon_table_write(table, argv[1])) {
+        die("%s: %s", argv[1], strerror(errno));
+    }
+    fprintf(stderr, "%u nodes from %u files\n", talon_table_row_count(table), paths.size);
+
+    talon_table_delete(table);
+    ts_parser_delete(parser);
+    paths_delete(&paths);
+    return 0;
+}
@@ -0,0 +1,214 @@
+// Run the test corpus in parallel.
+//
+// Usage: talon-test [-j THREADS] [-f FILTER] [PATH...]
+//
+// Each PATH is a corpus file or a directory to search for .txt corpus
+// files, by default test/corpus. Tests are spread over THREADS threads, by
+// default one per processor, each with its own parser. Expected and actual
+// trees are compared by structural hash, and only printed and diffed when
+// they differ. With -f, only tests whose names contain FILTER are run.
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "corpus.h"
+
+const char *program_name = "talon-test";
+
+typedef struct {
+    const char *path;
+    char *text;
+    CorpusTests tests;
+} CorpusFile;
+
+typedef struct {
+    uint32_t file;
+    uint32_t test;
+    bool passed;
+    double seconds;
+    // The diff of a failed test, if any.
+    TalonBuffer diff;
+} Result;
+
+typedef struct {
+    CorpusFile *files;
+    Result *results;
+    uint32_t result_count;
+    atomic_uint next;
+} Run;
+
+static void run_test(const CorpusTest *test, TSParser *parser, TalonBuffer *actual, Result *result) {
+    double start = now();
+    TSTree *tree = ts_parser_parse_string(parser, NULL, test->input, test->input_length);
+    TSNode root = ts_tree_root_node(tree);
+    bool has_fields;
+    uint64_t expected_hash = talon_sexp_hash_text(test->expected, test->expected_length, &has_fields);
+    uint32_t flags = has_fields ? TALON_SEXP_FIELDS : 0;
+    if (test->error) {
+        result->passed = ts_node_has_error(root);
+    } else {
+        result->passed = talon_sexp_hash(root, test->input, flags) == expected_hash;
+    }
+    result->seconds = now() - start;
+
+    if (!result->passed && !test->error) {
+        actual->size = 0;
+        talon_write_sexp(actual, root, test->input, flags);
+        talon_sexp_diff(&result->diff, test->expected, test->expected_length, actual->data, actual->size);
+    }
+    ts_tree_delete(tree);
+}
+
+static void *worker(void *payload) {
+    Run *run = payload;
+    TSParser *parser = talon_parser_new();
+    TalonBuffer actual;
+    talon_buffer_init(&actual, -1);
+    for (;;) {
+        uint32_t index = atomic_fetch_add_explicit(&run->next, 1, memory_order_relaxed);
+        if (index >= run->result_count) {
+            break;
+        }
+        Result *result = &run->results[index];
+        run_test(&run->files[result->file].tests.contents[result->test], parser, &actual, result);
+    }
+    talon_buffer_delete(&actual);
+    ts_parser_delete(parser);
+    return NULL;
+}
+
+static bool contains(const char *text, size_t length, const char *pattern) {
+    size_t pattern_length = strlen(pattern);
+    for (size_t i = 0; i + pattern_length <= length; i++) {
+        if (memcmp(text + i, pattern, pattern_length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void print_indented(const char *text, size_t length) {
+    const char *end = text + length;
+    while (text < end) {
+        const char *newline = memchr(text, '\n', (size_t)(end - text));
+        size_t line_length = newline ? (size_t)(newline - text) : (size_t)(end - text);
+        printf("    %.*s\n", (int)line_length, text);
+        text += line_length + 1;
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned threads = cpu_count();
+    const char *filter = NULL;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-j") == 0 && arg + 1 < argc) {
+            threads = (unsigned)atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-f") == 0 && arg + 1 < argc) {
+            filter = argv[++arg];
+        } else {
+            fprintf(stderr, "usage: %s [-j THREADS] [-f FILTER] [PATH...]\n", program_name);
+            return 2;
+        }
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    Paths paths = array_new();
+    if (arg == argc && !collect_files("test/corpus", ".txt", &paths)) {
+        return 1;
+    }
+    for (; arg < argc; arg++) {
+        if (!collect_files(argv[arg], ".txt", &paths)) {
+            return 1;
+        }
+    }
+
+    double start = now();
+    CorpusFile *files = ts_calloc(paths.size, sizeof(CorpusFile));
+    Array(Result) results = array_new();
+    for (uint32_t i = 0; i < paths.size; i++) {
+        CorpusFile *file = &files[i];
+        size_t length;
+        file->path = paths.contents[i];
+        if ((file->text = read_file(file->path, &length)) == NULL) {
+            die("%s: %s", file->path, strerror(errno));
+        }
+        if (!corpus_parse(file->text, length, &file->tests)) {
+            die("%s: malformed corpus file", file->path);
+        }
+        for (uint32_t j = 0; j < file->tests.size; j++) {
+            const CorpusTest *test = &file->tests.contents[j];
+            if (test->skip || (filter != NULL && !contains(test->name, test->name_length, filter))) {
+                continue;
+            }
+            Result result = {i, j, false, 0, {0}};
+            talon_buffer_init(&result.diff, -1);
+            array_push(&results, result);
+        }
+    }
+
+    Run run = {files, results.contents, results.size, 0};
+    if (threads > results.size) {
+        threads = results.size > 0 ? results.size : 1;
+    }
+    pthread_t *workers = ts_calloc(threads, sizeof(pthread_t));
+    for (unsigned i = 0; i < threads; i++) {
+        if (pthread_create(&workers[i], NULL, worker, &run) != 0) {
+            die("failed to start threads");
+        }
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    double seconds = now() - start;
+
+    // Report failures, then the time spent in each file, in corpus order.
+    uint32_t failures = 0;
+    for (uint32_t i = 0; i < results.size; i++) {
+        const Result *result = &results.contents[i];
+        if (result->passed) {
+            continue;
+        }
+        const CorpusTest *test = &files[result->file].tests.contents[result->test];
+        printf("FAIL %s:%u: %.*s\n", files[result->file].path, test->line, (int)test->name_length, test->name);
+        if (result->diff.size > 0) {
+            print_indented(result->diff.data, result->diff.size);
+        } else {
+            printf("    expected errors, but the tree has none\n");
+        }
+        failures++;
+    }
+    printf("\n%-48s %7s %7s %10s\n", "file", "tests", "failed", "time (ms)");
+    uint32_t index = 0;
+    for (uint32_t i = 0; i < paths.size; i++) {
+        uint32_t count = 0, failed = 0;
+        double file_seconds = 0;
+        for (; index < results.size && results.contents[index].file == i; index++) {
+            count++;
+            failed += !results.contents[index].passed;
+            file_seconds += results.contents[index].seconds;
+        }
+        printf("%-48s %7u %7u %10.2f\n", files[i].path, count, failed, file_seconds * 1e3);
+    }
+    printf("\n%u tests, %u failed, in %.2f s on %u threads\n", results.size, failures, seconds, threads);
+
+    for (uint32_t i = 0; i < results.size; i++) {
+        talon_buffer_delete(&results.contents[i].diff);
+    }
+    for (uint32_t i = 0; i < paths.size; i++) {
+        ts_free(files[i].text);
+        array_delete(&files[i].tests);
+    }
+    ts_free(files);
+    ts_free(workers);
+    array_delete(&results);
+    paths_delete(&paths);
+    return failures > 0;
+}
@@ -0,0 +1,181 @@
+// Record a timeline of parsing as a Chrome trace.
+//
+// Usage: talon-trace [-o OUTPUT] [-k LIST] [-c] [PATH...]
+//
+// Each PATH is a .talon file or a directory to search for them, and with
+// -k, the paths are also read from LIST, one per line, such as
+// script/known-failures-*.txt. Each file is parsed with a TSLogger
+// installed, and every message the runtime logs becomes an event lasting
+// until the next one, in one of these categories:
+//
+// - scanner: calls to the external scanner.
+// - lex: the internal lexer, and the lookahead tokens it returns.
+// - reduce: reductions.
+// - recover: error detection and recovery.
+// - parse: everything else, such as shifts and version handling.
+//
+// The lexer logs each character it consumes, which makes large traces, so
+// those are folded into the event before them unless -c is given. The
+// trace is written in the Chrome trace event format to OUTPUT, by default
+// trace.json, which Perfetto and chrome://tracing can load, with a thread
+// per file. Logging slows parsing down a lot, so durations show where the
+// parser spends its time relative to the rest, not how long it takes
+// without logging.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+const char *program_name = "talon-trace";
+
+#define MESSAGE_SIZE 1024
+
+typedef struct {
+    FILE *stream;
+    double origin;
+    uint32_t thread;
+    bool include_consume;
+    bool has_events;
+    // The last event, which is written once the next one starts.
+    bool pending;
+    double pending_start;
+    const char *pending_category;
+    char pending_message[MESSAGE_SIZE];
+} Trace;
+
+static bool starts_with(const char *message, const char *prefix) {
+    return strncmp(message, prefix, strlen(prefix)) == 0;
+}
+
+static const char *category(TSLogType type, const char *message) {
+    static const char *const RECOVER_PREFIXES[] = {
+        "detect_error", "recover", "skip", "handle_error", "resume", "condense", "summarize", "no_lookahead",
+    };
+    if (type == TSLogTypeLex) {
+        return "lex";
+    }
+    if (starts_with(message, "lex_external")) {
+        return "scanner";
+    }
+    if (starts_with(message, "lex_") || starts_with(message, "lexed_lookahead")) {
+        return "lex";
+    }
+    if (starts_with(message, "reduce")) {
+        return "reduce";
+    }
+    for (size_t i = 0; i < sizeof(RECOVER_PREFIXES) / sizeof(RECOVER_PREFIXES[0]); i++) {
+        if (starts_with(message, RECOVER_PREFIXES[i])) {
+            return "recover";
+        }
+    }
+    return "parse";
+}
+
+static void write_event(Trace *trace, const char *name, const char *category, double start, double end,
+                        const char *message) {
+    fprintf(trace->stream, "%s\n{\"name\":", trace->has_events ? "," : "");
+    print_json_string(trace->stream, name);
+    fprintf(trace->stream, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,", category, trace->thread);
+    fprintf(trace->stream, "\"ts\":%.3f,\"dur\":%.3f", (start - trace->origin) * 1e6, (end - start) * 1e6);
+    if (message != NULL) {
+        fprintf(trace->stream, ",\"args\":{\"message\":");
+        print_json_string(trace->stream, message);
+        fputc('}', trace->stream);
+    }
+    fputc('}', trace->stream);
+    trace->has_events = true;
+}
+
+static void flush_pending(Trace *trace, double end) {
+    if (trace->pending) {
+        // Events are named after the first word of their message.
+        const char *message = trace->pending_message;
+        char name[64];
+        snprintf(name, sizeof(name), "%.*s", (int)strcspn(message, " "), message);
+        write_event(trace, name, trace->pending_category, trace->pending_start, end, message);
+        trace->pending = false;
+    }
+}
+
+static void log_message(void *payload, TSLogType type, const char *message) {
+    Trace *trace = payload;
+    if (type == TSLogTypeLex && !trace->include_consume && starts_with(message, "consume")) {
+        return;
+    }
+    flush_pending(trace, now());
+    // Writing the event takes time the parser does not spend, so the next
+    // event starts after it.
+    trace->pending = true;
+    trace->pending_start = now();
+    trace->pending_category = category(type, message);
+    snprintf(trace->pending_message, MESSAGE_SIZE, "%s", message);
+}
+
+int main(int argc, char **argv) {
+    const char *output = "trace.json";
+    Trace trace = {0};
+    Paths paths = array_new();
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) {
+            output = argv[++arg];
+        } else if (strcmp(argv[arg], "-k") == 0 && arg + 1 < argc) {
+            if (!read_lines(argv[++arg], &paths)) {
+                die("%s: %s", argv[arg], strerror(errno));
+            }
+        } else if (strcmp(argv[arg], "-c") == 0) {
+            trace.include_consume = true;
+        } else {
+            fprintf(stderr, "usage: %s [-o OUTPUT] [-k LIST] [-c] [PATH...]\n", program_name);
+            return 2;
+        }
+    }
+    for (; arg < argc; arg++) {
+        if (!collect_files(argv[arg], ".talon", &paths)) {
+            return 1;
+        }
+    }
+    if (paths.size == 0) {
+        die("no files to trace");
+    }
+
+    if ((trace.stream = fopen(output, "w")) == NULL) {
+        die("%s: %s", output, strerror(errno));
+    }
+    fprintf(trace.stream, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    TSParser *parser = talon_parser_new();
+    ts_parser_set_logger(parser, (TSLogger){&trace, log_message});
+    trace.origin = now();
+    for (uint32_t i = 0; i < paths.size; i++) {
+        size_t length;
+        char *source = read_file(paths.contents[i], &length);
+        if (source == NULL) {
+            die("%s: %s", paths.contents[i], strerror(errno));
+        }
+        trace.thread = i + 1;
+        fprintf(trace.stream, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                trace.has_events ? "," : "", trace.thread);
+        print_json_string(trace.stream, paths.contents[i]);
+        fprintf(trace.stream, "}}");
+        trace.has_events = true;
+
+        double start = now();
+        TSTree *tree = ts_parser_parse_string(parser, NULL, source, (uint32_t)length);
+        double end = now();
+        flush_pending(&trace, end);
+        write_event(&trace, "parse_file", "file", start, end, paths.contents[i]);
+        ts_tree_delete(tree);
+        ts_free(source);
+    }
+    ts_parser_delete(parser);
+    fprintf(trace.stream, "\n]}\n");
+    if (fclose(trace.stream) != 0) {
+        die("%s: %s", output, strerror(errno));
+    }
+    fprintf(stderr, "traced %u files to %s\n", paths.size, output);
+    paths_delete(&paths);
+    return 0;
+}
@@ -0,0 +1,81 @@
+// Check the rule compiler, the phrase matcher, the context index, the file
+// API and the table on small fixed cases.
+//
+// Usage: talon-unit
+//
+// The cases of each module are in tools/unit. Rules are compiled with
+// talon_automaton_compile and checked for their number of states, their
+// anchors and phrases they accept and reject. The matcher is checked on a
+// phrase whose states cross a block of 64, the bindings of a repeated
+// {list}+ with an item of two words, and captures nested deeper than it
+// expands. The contexts are checked on "and" and "not" lines, alternatives
+// and patterns, as a scope changes and its epoch wraps around. The file
+// API is checked on files written to a temporary directory: a mapped, an
+// empty and a broken file, parsed alone and with talon_parse_many, and the
+// table on a file with an error, whose symbol must be in the dictionary.
+// Each failed check is printed, and the tool fails if any did.
+// `make test-native` builds and runs it.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "unit/unit.h"
+
+const char *program_name = "talon-unit";
+
+static unsigned check_count, failure_count;
+
+void check(bool passed, const char *format, ...) {
+    check_count++;
+    if (passed) {
+        return;
+    }
+    failure_count++;
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%s: ", program_name);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+TalonAutomaton *compile_rule(TSParser *parser, TalonWords *words, const char *rule) {
+    size_t length = strlen(rule) + sizeof(": skip()\n");
+    char *source = ts_malloc(length);
+    snprintf(source, length, "%s: skip()\n", rule);
+    TalonAutomaton *automaton = NULL;
+    TalonFile *file = talon_parse_string(parser, source, (uint32_t)strlen(source));
+    if (file != NULL && file->command_count == 1) {
+        const TalonCommand *command = &file->commands[0];
+        TSNode node = ts_node_named_descendant_for_byte_range(ts_tree_root_node(file->tree), command->rule_start,
+                                                              command->rule_end);
+        automaton = talon_automaton_compile(words, node, source);
+    }
+    if (file != NULL) {
+        talon_file_delete(file);
+    }
+    ts_free(source);
+    if (automaton == NULL) {
+        die("invalid rule: %s", rule);
+    }
+    return automaton;
+}
+
+int main(int argc, char **argv) {
+    (void)argv;
+    if (argc > 1) {
+        fprintf(stderr, "usage: %s\n", program_name);
+        return 2;
+    }
+    TSParser *parser = talon_parser_new();
+    test_rules(parser);
+    test_matcher(parser);
+    test_contexts(parser);
+    test_api(parser);
+    test_table(parser);
+    ts_parser_delete(parser);
+    printf("%u checks, %u failed\n", check_count, failure_count);
+    return failure_count == 0 ? 0 : 1;
+}
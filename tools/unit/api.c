@@ -0,0 +1,131 @@
+// The file API: talon_parse_file on mapped and empty files, talon_parse_many
+// with a missing path, and the record accessors.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "unit.h"
+
+static const char SOURCE[] = "app: firefox\n"
+                             "not tag: user.tabs\n"
+                             "-\n"
+                             "tag(): user.navigation\n"
+                             "settings():\n"
+                             "    speech.timeout = 0.3\n"
+                             "go back: key(alt-left)\n"
+                             "new tab: key(ctrl-t)\n";
+
+static const char BROKEN_SOURCE[] = "go back key(alt-left\n";
+
+static void write_file(const char *path, const char *source) {
+    FILE *stream = fopen(path, "wb");
+    if (stream == NULL || fputs(source, stream) == EOF || fclose(stream) != 0) {
+        die("%s: %s", path, strerror(errno));
+    }
+}
+
+static bool has_text(const TalonFile *file, uint32_t start, uint32_t end, const char *expected) {
+    return end >= start && end <= file->length && strlen(expected) == end - start &&
+           memcmp(file->source + start, expected, end - start) == 0;
+}
+
+static void check_records(const TalonFile *file) {
+    uint32_t count;
+    const TalonMatch *matches = talon_file_matches(file, &count);
+    check(matches == file->matches && count == 2, "matches: expected 2, found %u", count);
+    if (count == 2) {
+        check(has_text(file, matches[0].left_start, matches[0].left_end, "app") &&
+                  has_text(file, matches[0].right_start, matches[0].right_end, "firefox") &&
+                  matches[0].modifiers == 0,
+              "matches: expected app: firefox first");
+        check(has_text(file, matches[1].left_start, matches[1].left_end, "tag") &&
+                  matches[1].modifiers == TALON_MATCH_NOT,
+              "matches: expected not tag second");
+    }
+
+    const TalonCommand *commands = talon_file_commands(file, &count);
+    check(commands == file->commands && count == 2, "commands: expected 2, found %u", count);
+    if (count == 2) {
+        check(has_text(file, commands[0].rule_start, commands[0].rule_end, "go back") &&
+                  has_text(file, commands[1].rule_start, commands[1].rule_end, "new tab"),
+              "commands: expected the rules go back and new tab");
+        check(commands[0].body_end <= commands[1].rule_start, "commands: expected the bodies in order");
+    }
+
+    const TalonSetting *settings = talon_file_settings(file, &count);
+    check(settings == file->settings && count == 1, "settings: expected 1, found %u", count);
+    if (count == 1) {
+        check(has_text(file, settings[0].name_start, settings[0].name_end, "speech.timeout") &&
+                  has_text(file, settings[0].value_start, settings[0].value_end, "0.3"),
+              "settings: expected speech.timeout = 0.3");
+    }
+
+    const TalonTagImport *tag_imports = talon_file_tag_imports(file, &count);
+    check(tag_imports == file->tag_imports && count == 1, "tag imports: expected 1, found %u", count);
+    if (count == 1) {
+        check(has_text(file, tag_imports[0].start, tag_imports[0].end, "user.navigation"),
+              "tag imports: expected user.navigation");
+    }
+}
+
+void test_api(TSParser *parser) {
+    char directory[] = "/tmp/talon-unit-XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        die("%s: %s", directory, strerror(errno));
+    }
+    char paths[4][sizeof(directory) + 16];
+    const char *names[] = {"commands.talon", "empty.talon", "broken.talon", "missing.talon"};
+    for (int i = 0; i < 4; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "%s/%s", directory, names[i]);
+    }
+    write_file(paths[0], SOURCE);
+    write_file(paths[1], "");
+    write_file(paths[2], BROKEN_SOURCE);
+
+    // A mapped file.
+    TalonFile *file = talon_parse_file(parser, paths[0]);
+    check(file != NULL, "%s: %s", paths[0], strerror(errno));
+    if (file != NULL) {
+        check(file->length == strlen(SOURCE) && memcmp(file->source, SOURCE, file->length) == 0,
+              "parse file: expected the source of %s", paths[0]);
+        check(!file->has_error, "parse file: expected no error in %s", paths[0]);
+        check_records(file);
+        talon_file_delete(file);
+    }
+
+    // Several files with one parser, stopping at the missing one.
+    const char *const path_list[] = {paths[0], paths[1], paths[2], paths[3]};
+    TalonFile *files[4] = {NULL};
+    errno = 0;
+    size_t parsed = talon_parse_many(parser, path_list, 4, files);
+    check(parsed == 3 && errno == ENOENT, "parse many: expected 3 files and ENOENT, found %zu and %s", parsed,
+          strerror(errno));
+    if (parsed == 3) {
+        check_records(files[0]);
+        uint32_t count;
+        talon_file_commands(files[1], &count);
+        check(files[1]->length == 0 && count == 0 && !files[1]->has_error,
+              "parse many: expected nothing in the empty file");
+        check(files[2]->has_error, "parse many: expected an error in %s", paths[2]);
+    }
+    for (size_t i = 0; i < parsed; i++) {
+        talon_file_delete(files[i]);
+    }
+
+    // Without a parser, talon_parse_many makes its own.
+    parsed = talon_parse_many(NULL, path_list, 3, files);
+    check(parsed == 3, "parse many: expected 3 files without a parser, found %zu", parsed);
+    for (size_t i = 0; i < parsed; i++) {
+        talon_file_delete(files[i]);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        unlink(paths[i]);
+    }
+    rmdir(directory);
+}
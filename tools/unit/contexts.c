@@ -0,0 +1,113 @@
+// The context index: "and" and "not" lines, alternatives and patterns,
+// as a scope changes and its epoch wraps around.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "unit.h"
+
+static const char *const HEADERS[] = {
+    "go: key(enter)\n",
+    "app: firefox\n-\n",
+    "app: firefox\napp: chrome\n-\n",
+    "app: firefox\nand tag: user.tabs\n-\n",
+    "not app: firefox\n-\n",
+    "app: firefox\nnot tag: user.tabs\n-\n",
+    "title: /inbox/i\n-\n",
+    "mode: command\ntag: user.tabs\n-\n",
+};
+
+// A change of the scope, as in talon-contexts, and the files active after
+// it, as their indices separated by spaces.
+typedef struct {
+    const char *change;
+    const char *active;
+} ContextStep;
+
+static const ContextStep CONTEXT_STEPS[] = {
+    {"", "0 4"},
+    {"app: firefox", "0 1 2 5"},
+    {"tag: user.tabs", "0 1 2 3"},
+    {"app: chrome", "0 2 4"},
+    {"title: Inbox - Mail", "0 2 4 6"},
+    {"mode: command", "0 2 4 6 7"},
+    {"not tag: user.tabs", "0 2 4 6"},
+    {"title: Drafts", "0 2 4"},
+    {"app:", "0 4"},
+    {"not mode: command", "0 4"},
+    {"title:", "0 4"},
+};
+
+// Test patterns as case-insensitive substrings, which is enough for the
+// headers above.
+static bool contains(void *payload, const char *pattern, uint32_t pattern_length, const char *value,
+                     uint32_t value_length) {
+    (void)payload;
+    const char *end = memchr(pattern + 1, '/', pattern_length - 1);
+    uint32_t length = end != NULL ? (uint32_t)(end - pattern - 1) : 0;
+    for (uint32_t i = 0; i + length <= value_length; i++) {
+        uint32_t j = 0;
+        while (j < length && tolower((unsigned char)value[i + j]) == tolower((unsigned char)pattern[1 + j])) {
+            j++;
+        }
+        if (j == length) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void apply_change(TalonScope *scope, const char *change) {
+    char key[32];
+    bool disable = strncmp(change, "not ", 4) == 0;
+    const char *start = change + (disable ? 4 : 0), *colon = strchr(start, ':');
+    snprintf(key, sizeof(key), "%.*s", (int)(colon - start), start);
+    const char *value = colon + 1 + strspn(colon + 1, " ");
+    if (strcmp(key, "tag") == 0 || strcmp(key, "mode") == 0) {
+        talon_scope_enable(scope, key, value, !disable);
+    } else {
+        talon_scope_set(scope, key, value[0] != '\0' ? value : NULL);
+    }
+}
+
+void test_contexts(TSParser *parser) {
+    const size_t file_count = sizeof(HEADERS) / sizeof(HEADERS[0]);
+    TalonContexts *contexts = talon_contexts_new();
+    for (size_t i = 0; i < file_count; i++) {
+        TalonFile *file = talon_parse_string(parser, HEADERS[i], (uint32_t)strlen(HEADERS[i]));
+        if (file == NULL) {
+            die("cannot parse header %zu", i);
+        }
+        talon_contexts_add_file(contexts, file);
+        talon_file_delete(file);
+    }
+    talon_contexts_build(contexts);
+
+    // The steps end in the empty scope they start from, so they can run a
+    // few times over. The epoch starts so that the fifth evaluation wraps it
+    // around, the first in which the title pattern holds, which would find a
+    // stale stamp if the stamps were not cleared.
+    TalonScope *scope = talon_scope_new(contexts, contains, NULL);
+    talon_scope_set_epoch(scope, UINT32_MAX - 4);
+    for (uint32_t pass = 0; pass < 3; pass++) {
+        for (size_t i = 0; i < sizeof(CONTEXT_STEPS) / sizeof(CONTEXT_STEPS[0]); i++) {
+            const ContextStep *step = &CONTEXT_STEPS[i];
+            if (step->change[0] != '\0') {
+                apply_change(scope, step->change);
+            }
+            const uint32_t *files;
+            uint32_t count = talon_scope_active_files(scope, &files);
+            char actual[64];
+            size_t end = 0;
+            actual[0] = '\0';
+            for (uint32_t j = 0; j < count && end < sizeof(actual); j++) {
+                end += (size_t)snprintf(actual + end, sizeof(actual) - end, "%s%u", j > 0 ? " " : "", files[j]);
+            }
+            check(strcmp(actual, step->active) == 0, "pass %u, \"%s\": active \"%s\", expected \"%s\"", pass + 1,
+                  step->change, actual, step->active);
+        }
+    }
+    talon_scope_delete(scope);
+    talon_contexts_delete(contexts);
+}
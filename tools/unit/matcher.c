@@ -0,0 +1,126 @@
+// The phrase matcher: phrases whose states cross a block of 64, the
+// bindings of a repeated list, and captures nested deeper than the matcher
+// expands.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "unit.h"
+
+// A rule or phrase of a word followed by count numbered words, such as
+// "chain w1 w2 w3".
+static char *numbered_words(const char *first, const char *prefix, uint32_t count) {
+    size_t length = strlen(first) + count * (strlen(prefix) + 12) + 1;
+    char *words = ts_malloc(length);
+    size_t end = (size_t)snprintf(words, length, "%s", first);
+    for (uint32_t i = 1; i <= count; i++) {
+        end += (size_t)snprintf(words + end, length - end, " %s%u", prefix, i);
+    }
+    return words;
+}
+
+// The commands of the matcher, by index. The padding puts the states of the
+// long chain across the end of the first block of 64.
+enum {
+    PADDING_COMMAND,
+    CHAIN_COMMAND,
+    SHORT_CHAIN_COMMAND,
+    LETTERS_COMMAND,
+    DEEP_COMMAND,
+};
+
+// Describe the matches of a phrase as the index of each command followed
+// by its bindings, such as "3 {user.letter}1-2; 4 <c0>1-3".
+static void describe_matches(const TalonWords *words, const TalonPhraseMatches *matches, char *text, size_t size) {
+    size_t end = 0;
+    text[0] = '\0';
+    for (uint32_t i = 0; i < matches->match_count && end < size; i++) {
+        const TalonPhraseMatch *match = &matches->matches[i];
+        end += (size_t)snprintf(text + end, size - end, "%s%u", i > 0 ? "; " : "", match->command);
+        for (uint32_t j = match->binding_offset; j < match->binding_offset + match->binding_count && end < size; j++) {
+            const TalonBinding *binding = &matches->bindings[j];
+            uint32_t name_length;
+            const char *name = talon_words_string(words, binding->name, &name_length);
+            bool list = binding->kind == TALON_EDGE_LIST;
+            end += (size_t)snprintf(text + end, size - end, " %c%.*s%c%u-%u", list ? '{' : '<', (int)name_length,
+                                    name, list ? '}' : '>', binding->start, binding->end);
+        }
+    }
+}
+
+static void check_phrase(const TalonMatcher *matcher, const TalonWords *words, TalonPhraseMatches *matches,
+                         const char *phrase, const char *expected) {
+    Array(uint32_t) ids = array_new();
+    for (const char *word = phrase; *word != '\0'; word += strspn(word, " ")) {
+        size_t length = strcspn(word, " ");
+        array_push(&ids, talon_words_find(words, word, (uint32_t)length));
+        word += length;
+    }
+    talon_matcher_match(matcher, ids.contents, ids.size, matches);
+    char actual[256];
+    describe_matches(words, matches, actual, sizeof(actual));
+    check(strcmp(actual, expected) == 0, "phrase \"%.60s\": matches \"%s\", expected \"%s\"", phrase, actual,
+          expected);
+    array_delete(&ids);
+}
+
+void test_matcher(TSParser *parser) {
+    TalonWords *words = talon_words_new();
+    TalonMatcher *matcher = talon_matcher_new(words);
+    talon_matcher_add_list_item(matcher, "user.letter", "air");
+    talon_matcher_add_list_item(matcher, "user.letter", "bat");
+    talon_matcher_add_list_item(matcher, "user.letter", "big cap");
+    // Each capture <cN> is "deep" followed by the next, down to <c9>, one
+    // level beyond those the matcher expands, which match any words.
+    for (uint32_t i = 0; i < 10; i++) {
+        char name[8], rule[32];
+        snprintf(name, sizeof(name), "c%u", i);
+        snprintf(rule, sizeof(rule), i < 9 ? "deep <c%u>" : "end", i + 1);
+        TalonAutomaton *automaton = compile_rule(parser, words, rule);
+        talon_matcher_add_capture(matcher, name, automaton);
+        talon_automaton_delete(automaton);
+    }
+
+    char *padding = numbered_words("pad", "p", 30), *chain = numbered_words("chain", "w", 50);
+    char *short_chain = numbered_words("chain", "w", 49);
+    const char *rules[] = {
+        [PADDING_COMMAND] = padding,
+        [CHAIN_COMMAND] = chain,
+        [SHORT_CHAIN_COMMAND] = "chain w1 w2",
+        [LETTERS_COMMAND] = "go {user.letter}+",
+        [DEEP_COMMAND] = "go <c0>",
+    };
+    for (size_t i = 0; i < sizeof(rules) / sizeof(rules[0]); i++) {
+        TalonAutomaton *automaton = compile_rule(parser, words, rules[i]);
+        check(talon_matcher_add_command(matcher, automaton) == i, "rule \"%.60s\": not command %zu", rules[i], i);
+        talon_automaton_delete(automaton);
+    }
+    talon_matcher_build(matcher);
+    check(talon_matcher_state_count(matcher) > 64, "matcher: %u states, expected more than one block",
+          talon_matcher_state_count(matcher));
+
+    TalonPhraseMatches matches;
+    talon_phrase_matches_init(&matches);
+    check_phrase(matcher, words, &matches, chain, "1");
+    check_phrase(matcher, words, &matches, short_chain, "");
+    check_phrase(matcher, words, &matches, "chain w1 w2", "2");
+    check_phrase(matcher, words, &matches, "pad p1 p2", "");
+    check_phrase(matcher, words, &matches, "go air", "3 {user.letter}1-2");
+    check_phrase(matcher, words, &matches, "go air big cap bat",
+                 "3 {user.letter}1-2 {user.letter}2-4 {user.letter}4-5");
+    check_phrase(matcher, words, &matches, "go big", "");
+    check_phrase(matcher, words, &matches, "go big cap big", "");
+    // <c8> is not expanded, so it takes any words after the eighth "deep".
+    check_phrase(matcher, words, &matches, "go deep deep deep deep deep deep deep deep any words at all",
+                 "4 <c0>1-13");
+    check_phrase(matcher, words, &matches, "go deep deep deep deep deep deep deep deep deep end", "4 <c0>1-11");
+    check_phrase(matcher, words, &matches, "go deep deep deep deep deep deep deep deep", "");
+    check_phrase(matcher, words, &matches, "go deep deep deep deep deep deep deep end", "");
+    talon_phrase_matches_delete(&matches);
+
+    ts_free(padding);
+    ts_free(chain);
+    ts_free(short_chain);
+    talon_matcher_delete(matcher);
+    talon_words_delete(words);
+}
@@ -0,0 +1,95 @@
+// The rule compiler: state counts, anchors and the phrases each rule
+// accepts and rejects.
+
+#include <string.h>
+
+#include "unit.h"
+
+typedef struct {
+    const char *rule;
+    uint32_t state_count;
+    bool start_anchor;
+    bool end_anchor;
+    // Phrases of words separated by spaces, ending with NULL.
+    const char *accepted[5];
+    const char *rejected[5];
+} RuleCase;
+
+static const RuleCase RULE_CASES[] = {
+    {"go", 2, false, false, {"go"}, {"", "go go", "stop"}},
+    {"go [fast]", 3, false, false, {"go", "go fast"}, {"fast", "go fast fast"}},
+    {"go (left | right)", 3, false, false, {"go left", "go right"}, {"go", "go left right"}},
+    {"go [left | right] [now]", 4, false, false, {"go", "go left", "go right now", "go now"}, {"go now left"}},
+    {"(go | move) [to] (left | right)", 4, false, false, {"go left", "move to right"}, {"go to", "to left"}},
+    {"go left | go right | stop", 3, false, false, {"go left", "go right", "stop"}, {"go", "stop left"}},
+    {"[go] left | right", 3, false, false, {"go left", "left", "right"}, {"go right", "go"}},
+    {"tap+", 2, false, false, {"tap", "tap tap tap"}, {""}},
+    {"say tap*", 2, false, false, {"say", "say tap", "say tap tap"}, {"tap", "say say"}},
+    {"go {user.letter}+", 3, false, false, {"go {user.letter}", "go {user.letter} {user.letter}"},
+     {"go", "{user.letter}", "go <user.letter>"}},
+    {"tap <user.number>+ [done]", 4, false, false, {"tap <user.number>", "tap <user.number> <user.number> done"},
+     {"tap done", "tap <user.number> done done"}},
+    {"^go$", 2, true, true, {"go"}, {"go go"}},
+    {"^go left", 3, true, false, {"go left"}, {"go"}},
+    {"go left$", 3, false, true, {"go left"}, {"left"}},
+};
+
+// Whether an automaton accepts a phrase, in which {list} and <capture>
+// stand for an edge of that kind.
+static bool accepts(const TalonAutomaton *automaton, const TalonWords *words, const char *phrase) {
+    bool *current = ts_calloc(automaton->state_count, sizeof(bool));
+    bool *next = ts_calloc(automaton->state_count, sizeof(bool));
+    current[0] = true;
+    for (const char *word = phrase + strspn(phrase, " "); *word != '\0'; word += strspn(word, " ")) {
+        size_t length = strcspn(word, " ");
+        uint32_t kind = TALON_EDGE_WORD, id;
+        if (length > 2 && (word[0] == '{' || word[0] == '<')) {
+            kind = word[0] == '{' ? TALON_EDGE_LIST : TALON_EDGE_CAPTURE;
+            id = talon_words_find(words, word + 1, (uint32_t)length - 2);
+        } else {
+            id = talon_words_find(words, word, (uint32_t)length);
+        }
+        memset(next, 0, automaton->state_count * sizeof(bool));
+        for (uint32_t state = 0; state < automaton->state_count; state++) {
+            for (uint32_t i = automaton->edge_offsets[state]; current[state] && i < automaton->edge_offsets[state + 1];
+                 i++) {
+                const TalonEdge *edge = &automaton->edges[i];
+                if (edge->kind == kind && edge->id == id) {
+                    next[edge->target] = true;
+                }
+            }
+        }
+        bool *swap = current;
+        current = next;
+        next = swap;
+        word += length;
+    }
+    bool accepted = false;
+    for (uint32_t state = 0; state < automaton->state_count; state++) {
+        accepted = accepted || (current[state] && automaton->accepting[state]);
+    }
+    ts_free(current);
+    ts_free(next);
+    return accepted;
+}
+
+void test_rules(TSParser *parser) {
+    TalonWords *words = talon_words_new();
+    for (size_t i = 0; i < sizeof(RULE_CASES) / sizeof(RULE_CASES[0]); i++) {
+        const RuleCase *test = &RULE_CASES[i];
+        TalonAutomaton *automaton = compile_rule(parser, words, test->rule);
+        check(automaton->state_count == test->state_count, "rule \"%s\": %u states, expected %u", test->rule,
+              automaton->state_count, test->state_count);
+        check(automaton->start_anchor == test->start_anchor && automaton->end_anchor == test->end_anchor,
+              "rule \"%s\": anchors %d %d, expected %d %d", test->rule, automaton->start_anchor,
+              automaton->end_anchor, test->start_anchor, test->end_anchor);
+        for (const char *const *phrase = test->accepted; *phrase != NULL; phrase++) {
+            check(accepts(automaton, words, *phrase), "rule \"%s\": rejects \"%s\"", test->rule, *phrase);
+        }
+        for (const char *const *phrase = test->rejected; *phrase != NULL; phrase++) {
+            check(!accepts(automaton, words, *phrase), "rule \"%s\": accepts \"%s\"", test->rule, *phrase);
+        }
+        talon_automaton_delete(automaton);
+    }
+    talon_words_delete(words);
+}
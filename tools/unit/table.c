@@ -0,0 +1,66 @@
+// The columnar table: written for input with a parse error, and read back
+// to check that every symbol id, including that of ERROR, is in the
+// dictionary of symbol names.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "unit.h"
+
+static const char SOURCE[] = "app: firefox\n-\ngo back: key(alt-left)\nnew tab key(ctrl-t\n";
+
+void test_table(TSParser *parser) {
+    char path[] = "/tmp/talon-unit-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        die("%s: %s", path, strerror(errno));
+    }
+    close(fd);
+
+    TalonFile *file = talon_parse_string(parser, SOURCE, (uint32_t)strlen(SOURCE));
+    check(file != NULL && file->has_error, "table: expected an error in the source");
+    if (file == NULL) {
+        unlink(path);
+        return;
+    }
+    const TSLanguage *language = ts_parser_language(parser);
+    TalonTable *table = talon_table_new(language);
+    talon_table_add(table, "broken.talon", file->tree);
+    bool written = talon_table_write(table, path);
+    check(written, "table: %s: %s", path, strerror(errno));
+    talon_table_delete(table);
+    talon_file_delete(file);
+
+    size_t length = 0;
+    char *data = written ? read_file(path, &length) : NULL;
+    unlink(path);
+    if (data == NULL) {
+        return;
+    }
+    TalonTableHeader header;
+    memcpy(&header, data, sizeof(header));
+    check(header.version == TALON_TABLE_VERSION && header.symbol_count == ts_language_symbol_count(language) + 1,
+          "table: expected version %u and %u symbols, found %u and %u", TALON_TABLE_VERSION,
+          ts_language_symbol_count(language) + 1, header.version, header.symbol_count);
+
+    const uint32_t *name_offsets = (const uint32_t *)(data + header.offsets[TALON_TABLE_SYMBOL_NAMES]);
+    const char *names = (const char *)(name_offsets + header.symbol_count + 1);
+    uint32_t last = header.symbol_count - 1;
+    check(name_offsets[last + 1] - name_offsets[last] == 5 && memcmp(names + name_offsets[last], "ERROR", 5) == 0,
+          "table: expected ERROR as the last symbol name");
+
+    const TSSymbol *symbols = (const TSSymbol *)(data + header.offsets[TALON_TABLE_SYMBOL]);
+    uint32_t outside = 0, errors = 0;
+    for (uint32_t row = 0; row < header.row_count; row++) {
+        outside += symbols[row] >= header.symbol_count;
+        errors += symbols[row] == last;
+    }
+    check(outside == 0, "table: expected every symbol in the dictionary, found %u outside", outside);
+    check(errors > 0, "table: expected a row for the ERROR node");
+    ts_free(data);
+}
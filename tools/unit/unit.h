@@ -0,0 +1,26 @@
+#ifndef TREE_SITTER_TALON_TOOLS_UNIT_H_
+#define TREE_SITTER_TALON_TOOLS_UNIT_H_
+
+#include <stdbool.h>
+
+#include "../common.h"
+
+// Count a check, and print the message if it failed.
+void check(bool passed, const char *format, ...);
+
+// Compile a rule, by parsing it as the rule of a command. Dies if the rule
+// is invalid.
+TalonAutomaton *compile_rule(TSParser *parser, TalonWords *words, const char *rule);
+
+// Set the epoch of a scope's last evaluation. Defined in context.c for
+// tests only.
+void talon_scope_set_epoch(TalonScope *scope, uint32_t epoch);
+
+// The cases of each module, which report through check.
+void test_rules(TSParser *parser);
+void test_matcher(TSParser *parser);
+void test_contexts(TSParser *parser);
+void test_api(TSParser *parser);
+void test_table(TSParser *parser);
+
+#endif // TREE_SITTER_TALON_TOOLS_UNIT_H_